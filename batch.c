@@ -0,0 +1,361 @@
+/*
+ * Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Batch mode: run every job in a manifest on a pool of threads, each
+ * with a machine of its own that it reuses from job to job.
+ *
+ * A manifest line is a program, a file to read console input from
+ * ("-" for none), the host directory for drive A: and any arguments
+ * for the program.  Blank lines and lines starting with # are skipped.
+ * Console, list and auxiliary output of the job on line N is written
+ * to N.out in the current directory.
+ *
+ * The jobs are dealt out in equal runs, one run per thread.  A thread
+ * takes its own jobs from the front of its run and, when that is empty,
+ * steals one from the back of another, so threads that draw short jobs
+ * help with the long ones.
+ *
+ * Jobs with the same program, directory and arguments form a group and
+ * are assumed to do the same until they first read the console.  The
+ * front end can have the first job of a group snapshot its machine at
+ * that point and start later ones from there, skipping the work that
+ * every job would repeat.
+ */
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "batch.h"
+
+#define MAXARGS		64
+
+struct queue {
+	pthread_mutex_t	 lock;
+	size_t		 head, tail;	/* Jobs left are head to tail - 1 */
+};
+
+struct worker {
+	pthread_t	 thread;
+	int		 id;
+	void		*machine;
+	size_t		 failed;
+};
+
+static struct job *jobs;
+static size_t njobs;
+
+static struct queue *queues;
+static int nqueues;
+
+static const struct batchops *ops;
+
+struct warm {
+	size_t		 jobs;		/* In the group */
+	int		 claimed;	/* A job is recording */
+	void		*snap;
+};
+
+static struct warm **groups;
+static size_t ngroups;
+static pthread_mutex_t warmlock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Read the manifest at path into jobs.
+ */
+static void
+manifest(const char *path)
+{
+	char *fields[3 + MAXARGS], *copy, *line = NULL, *p, *s;
+	size_t len = 0, size = 0;
+	struct job *j;
+	int i, n, nline = 0;
+	FILE *fp;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		err(1, "%s", path);
+	while (getline(&line, &len, fp) != -1) {
+		nline++;
+		if ((copy = s = strdup(line)) == NULL)
+			err(1, NULL);
+		for (n = 0; (p = strsep(&s, " \t\n")) != NULL;) {
+			if (*p == '\0')
+				continue;
+			if (n == 0 && *p == '#')
+				break;
+			if (n == sizeof(fields) / sizeof(fields[0]))
+				errx(1, "%s:%d: more than %d arguments", path,
+				    nline, MAXARGS);
+			fields[n++] = p;
+		}
+		if (n == 0) {
+			free(copy);
+			continue;
+		}
+		if (n < 3)
+			errx(1, "%s:%d: need a program, an input file and a "
+			    "directory", path, nline);
+
+		if (njobs == size) {
+			size = size ? size * 2 : 64;
+			if ((j = reallocarray(jobs, size, sizeof(*j))) == NULL)
+				err(1, NULL);
+			jobs = j;
+		}
+		j = &jobs[njobs++];
+		j->line = nline;
+		j->prog = fields[0];
+		j->input = fields[1];
+		j->dir = fields[2];
+		j->argc = n - 3;
+		if ((j->argv = calloc(n - 2, sizeof(*j->argv))) == NULL)
+			err(1, NULL);
+		for (i = 3; i < n; i++)
+			j->argv[i - 3] = fields[i];
+		j->in = -1;
+		j->out = -1;
+	}
+	if (ferror(fp))
+		err(1, "%s", path);
+	free(line);
+	fclose(fp);
+}
+
+static int
+samejob(const void *a, const void *b)
+{
+	const struct job *x = *(struct job *const *) a;
+	const struct job *y = *(struct job *const *) b;
+	int i, r;
+
+	if ((r = strcmp(x->prog, y->prog)) != 0 ||
+	    (r = strcmp(x->dir, y->dir)) != 0)
+		return r;
+	if (x->argc != y->argc)
+		return x->argc - y->argc;
+	for (i = 0; i < x->argc; i++) {
+		if ((r = strcmp(x->argv[i], y->argv[i])) != 0)
+			return r;
+	}
+
+	return 0;
+}
+
+/*
+ * Sort the jobs into groups that run the same program the same way and
+ * give each group a snapshot slot.
+ */
+static void
+group(void)
+{
+	struct job **sorted;
+	struct warm *w = NULL;
+	size_t i;
+
+	if ((sorted = reallocarray(NULL, njobs, sizeof(*sorted))) == NULL ||
+	    (groups = reallocarray(NULL, njobs, sizeof(*groups))) == NULL)
+		err(1, NULL);
+	for (i = 0; i < njobs; i++)
+		sorted[i] = &jobs[i];
+	qsort(sorted, njobs, sizeof(*sorted), samejob);
+
+	for (i = 0; i < njobs; i++) {
+		if (i == 0 || samejob(&sorted[i - 1], &sorted[i]) != 0) {
+			if ((w = calloc(1, sizeof(*w))) == NULL)
+				err(1, NULL);
+			groups[ngroups++] = w;
+		}
+		w->jobs++;
+		sorted[i]->warm = w;
+	}
+	free(sorted);
+}
+
+/*
+ * The next job for thread id: its own first, then one stolen from the
+ * back of another thread's run.  Returns NULL when none are left.
+ */
+static struct job *
+take(int id)
+{
+	struct queue *q;
+	struct job *j = NULL;
+	int i;
+
+	q = &queues[id];
+	pthread_mutex_lock(&q->lock);
+	if (q->head < q->tail)
+		j = &jobs[q->head++];
+	pthread_mutex_unlock(&q->lock);
+
+	for (i = 1; j == NULL && i < nqueues; i++) {
+		q = &queues[(id + i) % nqueues];
+		pthread_mutex_lock(&q->lock);
+		if (q->head < q->tail)
+			j = &jobs[--q->tail];
+		pthread_mutex_unlock(&q->lock);
+	}
+
+	return j;
+}
+
+/*
+ * Open the job's console files and run it.
+ */
+static int
+runjob(void *machine, struct job *j)
+{
+	char out[32];
+	int ret = -1;
+
+	snprintf(out, sizeof(out), "%d.out", j->line);
+	if (strcmp(j->input, "-") == 0)
+		j->in = open("/dev/null", O_RDONLY);
+	else
+		j->in = open(j->input, O_RDONLY);
+	if (j->in == -1) {
+		warn("%s", j->input);
+		return -1;
+	}
+	/* Readable too, for snapshots to pick up the output so far */
+	if ((j->out = open(out, O_RDWR | O_CREAT | O_TRUNC, 0666)) == -1)
+		warn("%s", out);
+	else
+		ret = ops->run(machine, j);
+
+	close(j->in);
+	if (j->out != -1)
+		close(j->out);
+	j->in = j->out = -1;
+
+	return ret;
+}
+
+static void *
+worker(void *arg)
+{
+	struct worker *w = arg;
+	struct job *j;
+
+	while ((j = take(w->id)) != NULL) {
+		if (runjob(w->machine, j) == -1) {
+			warnx("job on line %d failed", j->line);
+			w->failed++;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Run the jobs in the manifest at path on up to nthreads threads.  Each
+ * thread gets a machine from ops->new and runs its jobs on it with
+ * ops->run.  Once all threads have finished, the machines go to
+ * ops->done and the snapshots to ops->drop.  Returns the number of
+ * jobs that failed.
+ */
+int
+batch(const char *path, int nthreads, const struct batchops *o)
+{
+	struct worker *workers;
+	size_t failed = 0, k;
+	int i;
+
+	manifest(path);
+	if (njobs == 0)
+		return 0;
+	group();
+	if ((size_t) nthreads > njobs)
+		nthreads = njobs;
+	ops = o;
+
+	nqueues = nthreads;
+	if ((queues = calloc(nqueues, sizeof(*queues))) == NULL ||
+	    (workers = calloc(nthreads, sizeof(*workers))) == NULL)
+		err(1, NULL);
+	for (i = 0; i < nqueues; i++) {
+		pthread_mutex_init(&queues[i].lock, NULL);
+		queues[i].head = njobs * i / nqueues;
+		queues[i].tail = njobs * (i + 1) / nqueues;
+	}
+
+	for (i = 0; i < nthreads; i++) {
+		workers[i].id = i;
+		if ((workers[i].machine = ops->new()) == NULL)
+			err(1, NULL);
+		if ((errno = pthread_create(&workers[i].thread, NULL, worker,
+		    &workers[i])) != 0)
+			err(1, "pthread_create");
+	}
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		ops->done(workers[i].machine);
+		failed += workers[i].failed;
+	}
+
+	for (k = 0; k < ngroups; k++) {
+		if (groups[k]->snap != NULL)
+			ops->drop(groups[k]->snap);
+		free(groups[k]);
+	}
+	free(groups);
+	free(workers);
+
+	return failed;
+}
+
+/*
+ * Whether job j should start from a snapshot.  The first job of a group
+ * to ask records it and later ones get it once it has been put with
+ * warmput().  Groups of one job, and jobs that ask while the snapshot
+ * is still being made or after it failed, run from scratch.
+ */
+int
+warmget(struct job *j, void **snap)
+{
+	struct warm *w = j->warm;
+	int ret = WARM_COLD;
+
+	pthread_mutex_lock(&warmlock);
+	if (w->snap != NULL) {
+		*snap = w->snap;
+		ret = WARM_READY;
+	} else if (w->jobs > 1 && !w->claimed) {
+		w->claimed = 1;
+		ret = WARM_RECORD;
+	}
+	pthread_mutex_unlock(&warmlock);
+
+	return ret;
+}
+
+/*
+ * Publish the snapshot recorded by job j.
+ */
+void
+warmput(struct job *j, void *snap)
+{
+
+	pthread_mutex_lock(&warmlock);
+	j->warm->snap = snap;
+	pthread_mutex_unlock(&warmlock);
+}
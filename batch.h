@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* What warmget() says to do */
+#define WARM_COLD	0	/* Run from scratch */
+#define WARM_RECORD	1	/* Run from scratch and warmput() a snapshot */
+#define WARM_READY	2	/* Start from the snapshot */
+
+struct warm;
+
+/* One line of a manifest */
+struct job {
+	int		  line;
+	const char	 *prog;
+	const char	 *input;	/* Console input, or "-" for none */
+	const char	 *dir;		/* Host directory for drive A: */
+	int		  argc;		/* Arguments after the program */
+	char		**argv;
+	int		  in, out;	/* Console input and output */
+	struct warm	 *warm;		/* Shared by jobs run the same way */
+};
+
+/* What the front end does for batch() */
+struct batchops {
+	void	*(*new)(void);			/* A machine for a thread */
+	int	 (*run)(void *, struct job *);	/* -1 if the job failed */
+	void	 (*done)(void *);		/* After the threads finish */
+	void	 (*drop)(void *);		/* Free a snapshot */
+};
+
+int	batch(const char *, int, const struct batchops *);
+int	warmget(struct job *, void **);
+void	warmput(struct job *, void *);
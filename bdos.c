@@ -0,0 +1,1029 @@
+/*
+ * Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * File and disk functions of the BDOS, 13 through 40, on a host
+ * directory that plays drive A:.
+ *
+ * Files are found by their FCB name and type.  Host names are matched
+ * without regard to case and new files are created in lower case.
+ * Host files whose names do not fit 8.3 are invisible.  Each struct
+ * bdos is one such drive with state and caches of its own.
+ *
+ * Open files are kept in a small cache of host descriptors keyed by
+ * name.  Each has a WINDOW byte buffer, so sequential and nearby random
+ * record I/O costs one pread(2) or pwrite(2) per window rather than
+ * one per 128-byte record.  Dirty windows are written back when the
+ * window moves, when the file is closed and at exit.
+ *
+ * With BDOS_MMAP, files are mapped instead and every record transfer
+ * is a memcpy between the mapping and the DMA buffer.  Files grow in
+ * steps of GROW bytes while being written.  They are cut back to
+ * their real size, and dirty pages are written out, on close and at
+ * exit.
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <ctype.h>
+#include <dirent.h>
+#include <err.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bdos.h"
+
+#define NHANDLES	16
+#define WINDOW		16384
+#define RECSIZ		128
+#define MAXREC		65536	/* 8MB, the CP/M 2.2 file size limit */
+#define MAPSIZ		(MAXREC * RECSIZ)
+#define GROW		65536
+
+#define M(addr)		b->mem[(addr) & 0xffff]
+
+/* FCB fields */
+#define FCB_EX		12
+#define FCB_S2		14
+#define FCB_RC		15
+#define FCB_CR		32
+#define FCB_R0		33
+
+struct handle {
+	char		key[11];	/* FCB name and type */
+	int		fd;
+	int		rdonly;
+	off_t		size;
+	unsigned char	*map;		/* With BDOS_MMAP, else NULL */
+	off_t		mlen;		/* Host file size while mapped */
+	off_t		off;		/* File offset of buf, or -1 */
+	size_t		len;		/* Valid bytes in buf */
+	int		dirty;
+	unsigned long	stamp;		/* Last use, for eviction */
+	unsigned char	buf[WINDOW];
+};
+
+struct entry {
+	char		key[11];
+	off_t		size;
+};
+
+struct bdos {
+	struct handle		 handles[NHANDLES];
+	unsigned long		 stamp;
+
+	/* Matches of the last search first, handed out by search next */
+	struct entry		*found;
+	size_t			 nfound, nextfound;
+
+	unsigned char		*mem;
+	const char		*root;
+	void			(*touch)(void *, unsigned int, unsigned int);
+	void			*arg;
+
+	unsigned int		 dma;
+	int			 drive, user, mapped;
+	unsigned long long	 nsyscalls;
+};
+
+static unsigned char *
+put32(unsigned char *p, unsigned long v)
+{
+
+	p[0] = v & 0xff;
+	p[1] = (v >> 8) & 0xff;
+	p[2] = (v >> 16) & 0xff;
+	p[3] = (v >> 24) & 0xff;
+
+	return p + 4;
+}
+
+static unsigned long
+get32(const unsigned char *p)
+{
+
+	return p[0] | p[1] << 8 | p[2] << 16 | (unsigned long) p[3] << 24;
+}
+
+static void
+memout(struct bdos *b, unsigned int addr, const void *src, size_t len)
+{
+	const unsigned char *p = src;
+	size_t n;
+
+	while (len > 0) {
+		addr &= 0xffff;
+		n = 0x10000 - addr;
+		if (n > len)
+			n = len;
+		memcpy(&b->mem[addr], p, n);
+		if (b->touch != NULL)
+			b->touch(b->arg, addr, n);
+		addr += n;
+		p += n;
+		len -= n;
+	}
+}
+
+static void
+memin(struct bdos *b, unsigned int addr, void *dst, size_t len)
+{
+	unsigned char *p = dst;
+	size_t n;
+
+	while (len > 0) {
+		addr &= 0xffff;
+		n = 0x10000 - addr;
+		if (n > len)
+			n = len;
+		memcpy(p, &b->mem[addr], n);
+		addr += n;
+		p += n;
+		len -= n;
+	}
+}
+
+static void
+setbyte(struct bdos *b, unsigned int addr, int val)
+{
+	unsigned char c = val;
+
+	memout(b, addr, &c, 1);
+}
+
+/* The name and type of the FCB at fcb, without attribute bits */
+static void
+fcbkey(struct bdos *b, unsigned int fcb, char *key)
+{
+	int i;
+
+	for (i = 0; i < 11; i++)
+		key[i] = toupper(M(fcb + 1 + i) & 0x7f);
+}
+
+/*
+ * Turn a host file name into an FCB name and type.  Returns 0 if the
+ * name does not fit.
+ */
+static int
+hostkey(const char *name, char *key)
+{
+	const char *dot;
+	size_t i, n, t;
+
+	if ((dot = strrchr(name, '.')) == NULL)
+		dot = name + strlen(name);
+	n = dot - name;
+	t = *dot == '.' ? strlen(dot + 1) : 0;
+	if (n == 0 || n > 8 || t > 3 || (*dot == '.' && t == 0))
+		return 0;
+
+	memset(key, ' ', 11);
+	for (i = 0; i < n + t; i++) {
+		int c = i < n ? name[i] : dot[1 + i - n];
+
+		if (c <= ' ' || c > '~' || strchr(".,:;=?*<>[]|", c) != NULL)
+			return 0;
+		key[i < n ? i : 8 + i - n] = toupper(c);
+	}
+
+	return 1;
+}
+
+static void
+hostname(const char *key, char *name)
+{
+	int i;
+
+	for (i = 0; i < 8 && key[i] != ' '; i++)
+		*name++ = tolower((unsigned char) key[i]);
+	if (key[8] != ' ')
+		*name++ = '.';
+	for (i = 8; i < 11 && key[i] != ' '; i++)
+		*name++ = tolower((unsigned char) key[i]);
+	*name = '\0';
+}
+
+static int
+match(const char *pat, const char *key)
+{
+	int i;
+
+	for (i = 0; i < 11; i++) {
+		if (pat[i] != '?' && pat[i] != key[i])
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Find the host file for pat, which may hold '?' wildcards, and put
+ * its path in path and its size in size and FCB name in key if those
+ * are not NULL.  Returns 0 if there is none.
+ */
+static int
+lookup(struct bdos *b, const char *pat, char *path, off_t *size, char *key)
+{
+	struct dirent *dp;
+	struct stat st;
+	char k[11];
+	DIR *dirp;
+	int ok = 0;
+
+	if ((dirp = opendir(b->root)) == NULL)
+		return 0;
+	while (!ok && (dp = readdir(dirp)) != NULL) {
+		if (!hostkey(dp->d_name, k) || !match(pat, k))
+			continue;
+		snprintf(path, PATH_MAX, "%s/%s", b->root, dp->d_name);
+		if (stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+			if (size != NULL)
+				*size = st.st_size;
+			if (key != NULL)
+				memcpy(key, k, sizeof(k));
+			ok = 1;
+		}
+	}
+	closedir(dirp);
+
+	return ok;
+}
+
+static void
+hflush(struct bdos *b, struct handle *h)
+{
+
+	if (!h->dirty)
+		return;
+	b->nsyscalls++;
+	if (h->map != NULL) {
+		if (ftruncate(h->fd, h->size) == -1 ||
+		    (h->size > 0 && msync(h->map, h->size, MS_SYNC) == -1))
+			warn("write");
+		h->mlen = h->size;
+	} else if (pwrite(h->fd, h->buf, h->len, h->off) != (ssize_t) h->len)
+		warn("write");
+	h->dirty = 0;
+}
+
+static void
+hclose(struct bdos *b, struct handle *h)
+{
+
+	if (h->fd == -1)
+		return;
+	hflush(b, h);
+	if (h->map != NULL)
+		munmap(h->map, MAPSIZ);
+	b->nsyscalls++;
+	close(h->fd);
+	h->fd = -1;
+}
+
+static struct handle *
+hfind(struct bdos *b, const char *key)
+{
+	int i;
+
+	for (i = 0; i < NHANDLES; i++) {
+		if (b->handles[i].fd != -1 &&
+		    memcmp(b->handles[i].key, key, 11) == 0) {
+			b->handles[i].stamp = ++b->stamp;
+			return &b->handles[i];
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Return the cached handle for key, opening the host file if needed.
+ * With create set, the file is created or truncated.
+ */
+static struct handle *
+hopen(struct bdos *b, const char *key, int create)
+{
+	struct handle *h, *lru;
+	char path[PATH_MAX], name[13];
+	off_t size = 0;
+	int fd, i, rdonly = 0;
+
+	if ((h = hfind(b, key)) != NULL && !create)
+		return h;
+	if (h != NULL)
+		hclose(b, h);
+
+	if (create) {
+		if (!lookup(b, key, path, NULL, NULL)) {
+			hostname(key, name);
+			snprintf(path, sizeof(path), "%s/%s", b->root, name);
+		}
+		b->nsyscalls++;
+		fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+	} else {
+		if (!lookup(b, key, path, &size, NULL))
+			return NULL;
+		b->nsyscalls++;
+		if ((fd = open(path, O_RDWR)) == -1) {
+			fd = open(path, O_RDONLY);
+			rdonly = 1;
+		}
+	}
+	if (fd == -1)
+		return NULL;
+
+	lru = &b->handles[0];
+	for (i = 0; i < NHANDLES; i++) {
+		if (b->handles[i].fd == -1) {
+			lru = &b->handles[i];
+			break;
+		}
+		if (b->handles[i].stamp < lru->stamp)
+			lru = &b->handles[i];
+	}
+	hclose(b, lru);
+
+	h = lru;
+	memcpy(h->key, key, 11);
+	h->fd = fd;
+	h->rdonly = rdonly;
+	h->size = size;
+	h->map = NULL;
+	h->mlen = size;
+	h->off = -1;
+	h->len = 0;
+	h->dirty = 0;
+	h->stamp = ++b->stamp;
+
+	/* Fall back to the window if the file cannot be mapped */
+	if (b->mapped) {
+		h->map = mmap(NULL, MAPSIZ,
+		    PROT_READ | (rdonly ? 0 : PROT_WRITE), MAP_SHARED, fd, 0);
+		if (h->map == MAP_FAILED)
+			h->map = NULL;
+	}
+
+	return h;
+}
+
+/* Make the window holding byte pos current */
+static void
+window(struct bdos *b, struct handle *h, off_t pos)
+{
+	ssize_t n;
+
+	pos -= pos % WINDOW;
+	if (h->off == pos)
+		return;
+	hflush(b, h);
+	h->off = pos;
+	b->nsyscalls++;
+	n = pread(h->fd, h->buf, WINDOW, pos);
+	h->len = n > 0 ? n : 0;
+}
+
+/* Read record rec into the DMA buffer, ^Z-padding a short last record */
+static int
+rdrec(struct bdos *b, struct handle *h, unsigned long rec)
+{
+	unsigned char eof[RECSIZ];
+	off_t pos = (off_t) rec * RECSIZ;
+	const unsigned char *src;
+	size_t p, n;
+
+	if (rec >= MAXREC || pos >= h->size)
+		return 1;
+	if (h->map != NULL) {
+		src = &h->map[pos];
+		n = h->size - pos;
+	} else {
+		window(b, h, pos);
+		p = pos - h->off;
+		src = &h->buf[p];
+		n = p < h->len ? h->len - p : 0;
+	}
+	if (n > RECSIZ)
+		n = RECSIZ;
+	memout(b, b->dma, src, n);
+	if (n < RECSIZ) {
+		memset(eof, 0x1a, RECSIZ - n);
+		memout(b, b->dma + n, eof, RECSIZ - n);
+	}
+
+	return 0;
+}
+
+static int
+wrrec(struct bdos *b, struct handle *h, unsigned long rec)
+{
+	off_t pos = (off_t) rec * RECSIZ, len;
+	size_t p;
+
+	if (rec >= MAXREC || h->rdonly)
+		return 2;
+	if (h->map != NULL) {
+		if (pos + RECSIZ > h->mlen) {
+			len = (pos + RECSIZ + GROW - 1) / GROW * GROW;
+			b->nsyscalls++;
+			if (ftruncate(h->fd, len) == -1)
+				return 2;
+			h->mlen = len;
+		}
+		memin(b, b->dma, &h->map[pos], RECSIZ);
+		h->dirty = 1;
+		if (pos + RECSIZ > h->size)
+			h->size = pos + RECSIZ;
+		return 0;
+	}
+	window(b, h, pos);
+	p = pos - h->off;
+	if (p > h->len)
+		memset(&h->buf[h->len], 0, p - h->len);
+	memin(b, b->dma, &h->buf[p], RECSIZ);
+	if (p + RECSIZ > h->len)
+		h->len = p + RECSIZ;
+	h->dirty = 1;
+	if (h->off + (off_t) h->len > h->size)
+		h->size = h->off + h->len;
+
+	return 0;
+}
+
+/* The sequential record position of the FCB */
+static unsigned long
+seqrec(struct bdos *b, unsigned int fcb)
+{
+
+	return (M(fcb + FCB_S2) & 0x3f) << 12 | (M(fcb + FCB_EX) & 0x1f) << 7 |
+	    (M(fcb + FCB_CR) & 0x7f);
+}
+
+/* Set the record count of the extent holding rec in a file of size bytes */
+static void
+setrc(struct bdos *b, unsigned int fcb, unsigned long rec, off_t size)
+{
+	long rc = (size + RECSIZ - 1) / RECSIZ - (long) (rec & ~0x7fUL);
+
+	setbyte(b, fcb + FCB_RC, rc < 0 ? 0 : rc > 0x80 ? 0x80 : rc);
+}
+
+/* Point the FCB at record rec */
+static void
+setpos(struct bdos *b, unsigned int fcb, unsigned long rec, off_t size)
+{
+
+	setbyte(b, fcb + FCB_EX, (rec >> 7) & 0x1f);
+	setbyte(b, fcb + FCB_S2, (rec >> 12) & 0x3f);
+	setbyte(b, fcb + FCB_CR, rec & 0x7f);
+	setrc(b, fcb, rec, size);
+}
+
+/* Only drive A: exists */
+static int
+fcbdrive(struct bdos *b, unsigned int fcb)
+{
+	int d = M(fcb);
+
+	return (d == 0 || d == '?' ? b->drive : d - 1) == 0;
+}
+
+static struct handle *
+fcbhandle(struct bdos *b, unsigned int fcb)
+{
+	char key[11];
+
+	if (!fcbdrive(b, fcb))
+		return NULL;
+	fcbkey(b, fcb, key);
+
+	return hopen(b, key, 0);
+}
+
+static unsigned int
+fcbopen(struct bdos *b, unsigned int fcb)
+{
+	struct handle *h;
+
+	if ((h = fcbhandle(b, fcb)) == NULL)
+		return 0xff;
+	setrc(b, fcb, seqrec(b, fcb), h->size);
+
+	return 0;
+}
+
+static unsigned int
+fcbclose(struct bdos *b, unsigned int fcb)
+{
+	struct handle *h;
+	char path[PATH_MAX], key[11];
+
+	if (!fcbdrive(b, fcb))
+		return 0xff;
+	fcbkey(b, fcb, key);
+	if ((h = hfind(b, key)) != NULL) {
+		hclose(b, h);
+		return 0;
+	}
+
+	return lookup(b, key, path, NULL, NULL) ? 0 : 0xff;
+}
+
+/* Write the next match of the last search to the DMA buffer */
+static unsigned int
+fcbnext(struct bdos *b)
+{
+	unsigned char dir[RECSIZ];
+	const struct entry *e;
+	long recs;
+
+	if (b->nextfound == b->nfound)
+		return 0xff;
+	e = &b->found[b->nextfound++];
+	recs = (e->size + RECSIZ - 1) / RECSIZ;
+
+	memset(dir, 0xe5, sizeof(dir));
+	memset(dir, 0, 32);
+	dir[0] = b->user;
+	memcpy(&dir[1], e->key, 11);
+	/* Directory entries share the FCB layout, with the user number first */
+	dir[FCB_EX] = recs > 0 ? ((recs - 1) >> 7) & 0x1f : 0;
+	dir[FCB_S2] = recs > 0 ? ((recs - 1) >> 12) & 0x3f : 0;
+	dir[FCB_RC] = recs > 0 ? (recs - 1) % 0x80 + 1 : 0;
+	memout(b, b->dma, dir, sizeof(dir));
+
+	return 0;
+}
+
+static unsigned int
+fcbsearch(struct bdos *b, unsigned int fcb)
+{
+	struct dirent *dp;
+	struct stat st;
+	struct entry *e;
+	char path[PATH_MAX], pat[11], key[11];
+	DIR *dirp;
+	size_t size = 0;
+
+	b->nfound = b->nextfound = 0;
+	if (!fcbdrive(b, fcb))
+		return 0xff;
+	fcbkey(b, fcb, pat);
+	if (M(fcb) == '?')
+		memset(pat, '?', sizeof(pat));
+
+	bdosflush(b);
+	if ((dirp = opendir(b->root)) == NULL)
+		return 0xff;
+	while ((dp = readdir(dirp)) != NULL) {
+		if (!hostkey(dp->d_name, key) || !match(pat, key))
+			continue;
+		snprintf(path, sizeof(path), "%s/%s", b->root, dp->d_name);
+		if (stat(path, &st) == -1 || !S_ISREG(st.st_mode))
+			continue;
+		if (b->nfound == size) {
+			size = size ? size * 2 : 64;
+			if ((e = reallocarray(b->found, size,
+			    sizeof(*e))) == NULL)
+				err(1, NULL);
+			b->found = e;
+		}
+		memcpy(b->found[b->nfound].key, key, 11);
+		b->found[b->nfound++].size = st.st_size;
+	}
+	closedir(dirp);
+
+	return fcbnext(b);
+}
+
+static unsigned int
+fcberase(struct bdos *b, unsigned int fcb)
+{
+	struct handle *h;
+	char path[PATH_MAX], pat[11], key[11];
+	int any = 0;
+
+	if (!fcbdrive(b, fcb))
+		return 0xff;
+	fcbkey(b, fcb, pat);
+	while (lookup(b, pat, path, NULL, key)) {
+		if ((h = hfind(b, key)) != NULL) {
+			h->dirty = 0;
+			hclose(b, h);
+		}
+		b->nsyscalls++;
+		if (unlink(path) == -1)
+			break;
+		any = 1;
+	}
+
+	return any ? 0 : 0xff;
+}
+
+static unsigned int
+fcbread(struct bdos *b, unsigned int fcb)
+{
+	struct handle *h;
+	unsigned long rec = seqrec(b, fcb);
+	int r;
+
+	if ((h = fcbhandle(b, fcb)) == NULL)
+		return 9;
+	if ((r = rdrec(b, h, rec)) == 0)
+		setpos(b, fcb, rec + 1, h->size);
+
+	return r;
+}
+
+static unsigned int
+fcbwrite(struct bdos *b, unsigned int fcb)
+{
+	struct handle *h;
+	unsigned long rec = seqrec(b, fcb);
+	int r;
+
+	if ((h = fcbhandle(b, fcb)) == NULL)
+		return 9;
+	if ((r = wrrec(b, h, rec)) == 0)
+		setpos(b, fcb, rec + 1, h->size);
+
+	return r;
+}
+
+static unsigned int
+fcbmake(struct bdos *b, unsigned int fcb)
+{
+	struct handle *h;
+	char key[11];
+	int i;
+
+	if (!fcbdrive(b, fcb))
+		return 0xff;
+	fcbkey(b, fcb, key);
+	for (i = 0; i < 11; i++) {
+		if (key[i] == '?')
+			return 0xff;
+	}
+	if ((h = hopen(b, key, 1)) == NULL)
+		return 0xff;
+	setpos(b, fcb, 0, 0);
+
+	return 0;
+}
+
+static unsigned int
+fcbrename(struct bdos *b, unsigned int fcb)
+{
+	struct handle *h;
+	char from[PATH_MAX], to[PATH_MAX], key[11], name[13];
+
+	if (!fcbdrive(b, fcb))
+		return 0xff;
+	fcbkey(b, fcb, key);
+	if ((h = hfind(b, key)) != NULL)
+		hclose(b, h);
+	if (!lookup(b, key, from, NULL, NULL))
+		return 0xff;
+
+	fcbkey(b, fcb + 16, key);
+	if ((h = hfind(b, key)) != NULL)
+		hclose(b, h);
+	hostname(key, name);
+	snprintf(to, sizeof(to), "%s/%s", b->root, name);
+	b->nsyscalls++;
+
+	return rename(from, to) == 0 ? 0 : 0xff;
+}
+
+/* Set the random record field r0-r2 */
+static void
+setrand(struct bdos *b, unsigned int fcb, unsigned long rec)
+{
+
+	setbyte(b, fcb + FCB_R0, rec & 0xff);
+	setbyte(b, fcb + FCB_R0 + 1, (rec >> 8) & 0xff);
+	setbyte(b, fcb + FCB_R0 + 2, (rec >> 16) & 0xff);
+}
+
+static unsigned int
+fcbrandom(struct bdos *b, unsigned int fcb, int write)
+{
+	struct handle *h;
+	unsigned long rec;
+	int r;
+
+	if (M(fcb + FCB_R0 + 2) != 0)
+		return 6;
+	rec = M(fcb + FCB_R0) | M(fcb + FCB_R0 + 1) << 8;
+	if ((h = fcbhandle(b, fcb)) == NULL)
+		return 9;
+	r = write ? wrrec(b, h, rec) : rdrec(b, h, rec);
+	setpos(b, fcb, rec, h->size);
+
+	return r;
+}
+
+static unsigned int
+fcbsize(struct bdos *b, unsigned int fcb)
+{
+	struct handle *h;
+
+	if ((h = fcbhandle(b, fcb)) == NULL)
+		return 0xff;
+	setrand(b, fcb, (h->size + RECSIZ - 1) / RECSIZ);
+
+	return 0;
+}
+
+/*
+ * Run BDOS function func with argument de.  Returns the value for HL;
+ * the caller copies L to A and H to B as CP/M does.
+ */
+unsigned int
+bdoscall(struct bdos *b, int func, unsigned int de)
+{
+	unsigned int fcb = de & 0xffff;
+
+	switch (func) {
+	case 13:	/* DRV_ALLRESET */
+		bdosflush(b);
+		b->dma = 0x80;
+		b->drive = 0;
+		break;
+	case 14:	/* DRV_SET */
+		b->drive = de & 0x0f;
+		break;
+	case 15:	/* F_OPEN */
+		return fcbopen(b, fcb);
+	case 16:	/* F_CLOSE */
+		return fcbclose(b, fcb);
+	case 17:	/* F_SFIRST */
+		return fcbsearch(b, fcb);
+	case 18:	/* F_SNEXT */
+		return fcbnext(b);
+	case 19:	/* F_DELETE */
+		return fcberase(b, fcb);
+	case 20:	/* F_READ */
+		return fcbread(b, fcb);
+	case 21:	/* F_WRITE */
+		return fcbwrite(b, fcb);
+	case 22:	/* F_MAKE */
+		return fcbmake(b, fcb);
+	case 23:	/* F_RENAME */
+		return fcbrename(b, fcb);
+	case 24:	/* DRV_LOGINVEC */
+		return 0x0001;
+	case 25:	/* DRV_GET */
+		return b->drive;
+	case 26:	/* F_DMAOFF */
+		b->dma = de & 0xffff;
+		break;
+	case 30:	/* F_ATTRIB */
+		return fcbhandle(b, fcb) != NULL ? 0 : 0xff;
+	case 32:	/* F_USERNUM */
+		if ((de & 0xff) == 0xff)
+			return b->user;
+		b->user = de & 0x0f;
+		break;
+	case 33:	/* F_READRAND */
+		return fcbrandom(b, fcb, 0);
+	case 34:	/* F_WRITERAND */
+	case 40:	/* F_WRITEZF */
+		return fcbrandom(b, fcb, 1);
+	case 35:	/* F_SIZE */
+		return fcbsize(b, fcb);
+	case 36:	/* F_RANDREC */
+		setrand(b, fcb, seqrec(b, fcb));
+		break;
+	}
+
+	/* 27, 28, 29, 31, 37: no allocation vectors, DPBs or R/O drives */
+	return 0;
+}
+
+void
+bdosflush(struct bdos *b)
+{
+	int i;
+
+	for (i = 0; i < NHANDLES; i++) {
+		if (b->handles[i].fd != -1)
+			hflush(b, &b->handles[i]);
+	}
+}
+
+/*
+ * Fill in an FCB at fcb from a command line argument, as the CCP does.
+ */
+static void
+parsefcb(struct bdos *b, unsigned int fcb, const char *arg, size_t len)
+{
+	char f[12];
+	size_t i, n, end;
+
+	memset(f, 0, sizeof(f));
+	memset(&f[1], ' ', 11);
+	if (arg == NULL)
+		arg = "";
+	if (arg[0] != '\0' && arg[1] == ':') {
+		f[0] = toupper((unsigned char) arg[0]) - 'A' + 1;
+		arg += 2;
+	}
+
+	/* Name in f[1..8], type in f[9..11]; extra characters are dropped */
+	for (n = 1, end = 9; *arg != '\0'; arg++) {
+		if (*arg == '.') {
+			n = 9;
+			end = 12;
+		} else if (*arg == '*') {
+			while (n < end)
+				f[n++] = '?';
+		} else if (n < end)
+			f[n++] = toupper((unsigned char) *arg);
+	}
+
+	memout(b, fcb, f, sizeof(f));
+	for (i = sizeof(f); i < len; i++)
+		setbyte(b, fcb + i, 0);
+}
+
+/*
+ * Set up the default FCBs at 0x5c and 0x6c and the command tail at
+ * 0x80 from the arguments after the program name.
+ */
+void
+bdosargs(struct bdos *b, int argc, char *argv[])
+{
+	unsigned char tail[RECSIZ];
+	size_t len = 0, max = sizeof(tail) - 2;
+	int i;
+	char *p;
+
+	parsefcb(b, 0x5c, argc > 0 ? argv[0] : NULL, 16);
+	parsefcb(b, 0x6c, argc > 1 ? argv[1] : NULL, 20);
+
+	memset(tail, 0, sizeof(tail));
+	for (i = 0; i < argc; i++) {
+		if (len < max)
+			tail[1 + len++] = ' ';
+		for (p = argv[i]; *p != '\0' && len < max; p++)
+			tail[1 + len++] = toupper((unsigned char) *p);
+	}
+	tail[0] = len;
+	memout(b, 0x80, tail, sizeof(tail));
+}
+
+/*
+ * A BDOS for the 64K memory image ram on the host directory dir, or
+ * the current directory if dir is NULL.  If fn is not NULL, it is
+ * called with arg for every range of memory the BDOS writes.
+ */
+struct bdos *
+bdosnew(unsigned char *ram, const char *dir, int flags,
+    void (*fn)(void *, unsigned int, unsigned int), void *arg)
+{
+	struct bdos *b;
+	int i;
+
+	if ((b = calloc(1, sizeof(*b))) == NULL)
+		return NULL;
+	b->mem = ram;
+	b->root = dir != NULL ? dir : ".";
+	b->touch = fn;
+	b->arg = arg;
+	b->dma = 0x80;
+	b->mapped = flags & BDOS_MMAP;
+	for (i = 0; i < NHANDLES; i++)
+		b->handles[i].fd = -1;
+
+	return b;
+}
+
+/*
+ * Write back and close every file.
+ */
+void
+bdosfree(struct bdos *b)
+{
+	int i;
+
+	for (i = 0; i < NHANDLES; i++)
+		hclose(b, &b->handles[i]);
+	free(b->found);
+	free(b);
+}
+
+/*
+ * Give dst the drive, user number, DMA address and search of src, for
+ * a machine started from a copy of src's.  Open files are not shared:
+ * their data is written out and dst opens them again when asked.
+ */
+void
+bdoscopy(struct bdos *dst, struct bdos *src)
+{
+	struct entry *e;
+
+	bdosflush(src);
+	if (src->nfound > 0) {
+		if ((e = reallocarray(dst->found, src->nfound,
+		    sizeof(*e))) == NULL)
+			err(1, NULL);
+		memcpy(e, src->found, src->nfound * sizeof(*e));
+		dst->found = e;
+	}
+	dst->nfound = src->nfound;
+	dst->nextfound = src->nextfound;
+	dst->dma = src->dma;
+	dst->drive = src->drive;
+	dst->user = src->user;
+}
+
+/*
+ * Save the state of b in a buffer for bdosrestore() and return its
+ * length.  Open files are written out first.  They need no saving:
+ * where a program is in a file is kept in its FCB, and the BDOS opens
+ * the file again by name when the program next uses it.
+ */
+size_t
+bdossave(struct bdos *b, unsigned char **bufp)
+{
+	unsigned char *buf, *p;
+	size_t i;
+
+	bdosflush(b);
+	if ((p = buf = malloc(12 + b->nfound * 15)) == NULL)
+		err(1, NULL);
+	*p++ = b->dma & 0xff;
+	*p++ = b->dma >> 8;
+	*p++ = b->drive;
+	*p++ = b->user;
+	p = put32(p, b->nfound);
+	p = put32(p, b->nextfound);
+	for (i = 0; i < b->nfound; i++) {
+		memcpy(p, b->found[i].key, 11);
+		p = put32(p + 11, b->found[i].size);
+	}
+	*bufp = buf;
+
+	return p - buf;
+}
+
+/*
+ * Take up the state saved by bdossave().  Returns -1 if it is bad.
+ */
+int
+bdosrestore(struct bdos *b, const unsigned char *p, size_t len)
+{
+	struct entry *e = NULL;
+	size_t i, n, next;
+
+	if (len < 12)
+		return -1;
+	n = get32(&p[4]);
+	next = get32(&p[8]);
+	if (next > n || len != 12 + n * 15)
+		return -1;
+	if (n > 0 && (e = reallocarray(NULL, n, sizeof(*e))) == NULL)
+		err(1, NULL);
+	for (i = 0; i < n; i++) {
+		memcpy(e[i].key, &p[12 + i * 15], 11);
+		e[i].size = get32(&p[12 + i * 15 + 11]);
+	}
+
+	free(b->found);
+	b->found = e;
+	b->nfound = n;
+	b->nextfound = next;
+	b->dma = p[0] | p[1] << 8;
+	b->drive = p[2] & 0x0f;
+	b->user = p[3] & 0x0f;
+
+	return 0;
+}
+
+/* System calls made, for -c */
+unsigned long long
+bdossyscalls(struct bdos *b)
+{
+
+	return b->nsyscalls;
+}
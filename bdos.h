@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define BDOS_MMAP	0x1	/* Map files for record I/O */
+
+struct bdos;
+
+struct bdos		*bdosnew(unsigned char *, const char *, int,
+			    void (*)(void *, unsigned int, unsigned int),
+			    void *);
+void			 bdosfree(struct bdos *);
+void			 bdosargs(struct bdos *, int, char *[]);
+void			 bdoscopy(struct bdos *, struct bdos *);
+unsigned int		 bdoscall(struct bdos *, int, unsigned int);
+void			 bdosflush(struct bdos *);
+size_t			 bdossave(struct bdos *, unsigned char **);
+int			 bdosrestore(struct bdos *, const unsigned char *,
+			    size_t);
+unsigned long long	 bdossyscalls(struct bdos *);
@@ -0,0 +1,78 @@
+#!/bin/sh
+#
+# Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+#
+# Permission to use, copy, modify, and distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+#
+
+#
+# Run each workload under i80, i80 -j (listed as i80j) and z80 and
+# report the fastest of RUNS runs.  The emulators must be built with
+# -DCYCLES; `make bench' does that and leaves them next to this script.
+# i80j is skipped if the build or host has no JIT.  The last line a workload
+# prints is checked, so a broken core cannot post a good time.
+#
+
+cd "$(dirname "$0")" || exit 1
+
+runs=${RUNS:-3}
+status=0
+
+cpus="i80 i80j z80"
+./i80 -j /dev/null 2>/dev/null || cpus="i80 z80"
+
+expect() {
+	case $1 in
+	sieve)	echo "01899" ;;
+	crc)	echo "D515" ;;
+	copy)	echo "E000" ;;
+	print)	echo "The quick brown fox jumps over the lazy dog 50000" ;;
+	esac
+}
+
+printf "%-8s %-4s %12s %12s %8s %9s %9s\n" workload cpu instructions \
+    T-states MIPS ns/instr syscalls
+
+for w in sieve crc copy print; do
+	for cpu in $cpus; do
+		case $cpu in
+		i80j)	cmd="./i80 -j" ;;
+		*)	cmd=./$cpu ;;
+		esac
+		best=
+		i=0
+		while [ $i -lt $runs ]; do
+			i=$((i + 1))
+			last=$($cmd -c $w.com 2>stats.$$ | tr -d '\r' |
+			    tail -n 1)
+			if [ "$last" != "$(expect $w)" ]; then
+				echo "$cpu $w: unexpected output: $last" >&2
+				status=1
+				best=
+				break
+			fi
+			stats=$(cat stats.$$)
+			best=$(echo "$stats $best" | awk '
+			    NF == 8 || $7 < $12 { print $1, $3, $5, $7; next }
+			    { print $9, $10, $11, $12 }')
+		done
+		rm -f stats.$$
+		[ -n "$best" ] || continue
+		echo "$w $cpu $best" | awk '{
+			printf "%-8s %-4s %12d %12d %8.1f %9.2f %9d\n",
+			    $1, $2, $3, $4, $3 / $6 / 1e6, $6 * 1e9 / $3, $5
+		}'
+	done
+done
+
+exit $status
@@ -0,0 +1,107 @@
+;
+; copy.asm -- block copies: 16K forward with ldax/stax, then back
+; with mov through hl, ITER times.  Prints a checksum of the result.
+;
+bdos	equ	5
+src	equ	1000h
+dst	equ	5000h
+len	equ	4000h
+iter	equ	200
+
+	org	100h
+
+	lxi	sp, stack
+	lxi	h, src			; src[i] = low(i) + high(i)
+	lxi	b, len
+fill:	mov	a, l
+	add	h
+	mov	m, a
+	inx	h
+	dcx	b
+	mov	a, b
+	ora	c
+	jnz	fill
+
+	mvi	a, iter
+	sta	count
+again:	lxi	b, src			; forward: (bc) -> (de)
+	lxi	d, dst
+	lxi	h, len
+fwd:	ldax	b
+	stax	d
+	inx	b
+	inx	d
+	dcx	h
+	mov	a, h
+	ora	l
+	jnz	fwd
+
+	lxi	h, dst+len-1		; backward: (hl) -> (de), adding 1
+	lxi	d, src+len-1
+	lxi	b, len
+back:	mov	a, m
+	inr	a
+	stax	d
+	dcx	h
+	dcx	d
+	dcx	b
+	mov	a, b
+	ora	c
+	jnz	back
+
+	lda	count
+	dcr	a
+	sta	count
+	jnz	again
+
+	lxi	h, src			; sum the source buffer
+	lxi	b, len
+	lxi	d, 0
+sum:	mov	a, e
+	add	m
+	mov	e, a
+	mvi	a, 0
+	adc	d
+	mov	d, a
+	inx	h
+	dcx	b
+	mov	a, b
+	ora	c
+	jnz	sum
+
+	mov	a, d
+	call	phex
+	mov	a, e
+	call	phex
+	lxi	d, crlf
+	mvi	c, 9
+	call	bdos
+	mvi	c, 0
+	call	bdos
+
+; Print a as two hex digits.
+phex:	push	psw
+	rrc
+	rrc
+	rrc
+	rrc
+	call	pnib
+	pop	psw
+pnib:	ani	0fh
+	adi	'0'
+	cpi	'9'+1
+	jc	putc
+	adi	7
+putc:	push	d
+	mov	e, a
+	mvi	c, 2
+	call	bdos
+	pop	d
+	ret
+
+crlf:	db	13, 10, '$'
+count:	db	0
+	ds	64
+stack:
+
+	end
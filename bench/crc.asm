@@ -0,0 +1,93 @@
+;
+; crc.asm -- bitwise CRC-16/CCITT over a 16K buffer, ITER times.
+; Prints the final CRC in hex.
+;
+bdos	equ	5
+buf	equ	1000h
+len	equ	4000h
+iter	equ	48
+
+	org	100h
+
+	lxi	sp, stack
+	lxi	h, buf			; buf[i] = low(i) xor high(i)
+	lxi	b, len
+fill:	mov	a, l
+	xra	h
+	mov	m, a
+	inx	h
+	dcx	b
+	mov	a, b
+	ora	c
+	jnz	fill
+
+	lxi	d, 0ffffh		; de = crc
+	mvi	a, iter
+	sta	count
+again:	lxi	h, buf
+	lxi	b, len
+byte:	mov	a, m
+	xra	d
+	mov	d, a
+	push	b
+	mvi	b, 8
+bit:	xchg				; crc <<= 1, xor 1021h on carry out
+	dad	h
+	xchg
+	jnc	nox
+	mov	a, d
+	xri	10h
+	mov	d, a
+	mov	a, e
+	xri	21h
+	mov	e, a
+nox:	dcr	b
+	jnz	bit
+	pop	b
+	inx	h
+	dcx	b
+	mov	a, b
+	ora	c
+	jnz	byte
+
+	lda	count
+	dcr	a
+	sta	count
+	jnz	again
+
+	mov	a, d
+	call	phex
+	mov	a, e
+	call	phex
+	lxi	d, crlf
+	mvi	c, 9
+	call	bdos
+	mvi	c, 0
+	call	bdos
+
+; Print a as two hex digits.
+phex:	push	psw
+	rrc
+	rrc
+	rrc
+	rrc
+	call	pnib
+	pop	psw
+pnib:	ani	0fh
+	adi	'0'
+	cpi	'9'+1
+	jc	putc
+	adi	7
+putc:	push	d
+	mov	e, a
+	mvi	c, 2
+	call	bdos
+	pop	d
+	ret
+
+crlf:	db	13, 10, '$'
+count:	db	0
+	ds	64
+stack:
+
+	end
@@ -0,0 +1,79 @@
+;
+; print.asm -- console output through the BDOS.  Prints LINES
+; numbered lines PASSES times, the text with C_WRITESTR and each
+; digit with C_WRITE.
+;
+bdos	equ	5
+lines	equ	50000
+passes	equ	4
+
+	org	100h
+
+	lxi	sp, stack
+	mvi	a, passes
+	sta	count
+again:	lxi	h, 0
+loop:	inx	h
+	push	h
+	lxi	d, text
+	mvi	c, 9
+	call	bdos
+	pop	h
+	push	h
+	call	pdec
+	lxi	d, crlf
+	mvi	c, 9
+	call	bdos
+	pop	h
+	mov	a, l
+	cpi	lines and 0ffh
+	jnz	loop
+	mov	a, h
+	cpi	lines shr 8
+	jnz	loop
+
+	lda	count
+	dcr	a
+	sta	count
+	jnz	again
+
+	mvi	c, 0
+	call	bdos
+
+; Print hl as five decimal digits.
+pdec:	lxi	b, -10000
+	call	digit
+	lxi	b, -1000
+	call	digit
+	lxi	b, -100
+	call	digit
+	lxi	b, -10
+	call	digit
+	mov	a, l
+	adi	'0'
+	jmp	putc
+digit:	mvi	e, '0'-1
+dloop:	inr	e
+	dad	b
+	jc	dloop
+	mov	a, l
+	sub	c
+	mov	l, a
+	mov	a, h
+	sbb	b
+	mov	h, a
+	mov	a, e
+putc:	push	h
+	mov	e, a
+	mvi	c, 2
+	call	bdos
+	pop	h
+	ret
+
+text:	db	'The quick brown fox jumps over the lazy dog $'
+crlf:	db	13, 10, '$'
+count:	db	0
+	ds	64
+stack:
+
+	end
@@ -0,0 +1,117 @@
+;
+; sieve.asm -- Sieve of Eratosthenes, BYTE magazine style.
+; Marks the 8191 odd candidates ITER times and prints the prime count.
+;
+bdos	equ	5
+size	equ	8190
+iter	equ	200
+flags	equ	1000h
+fend	equ	flags+size+1
+
+	org	100h
+
+	lxi	sp, stack
+	lxi	h, iter
+	shld	count
+
+again:	lxi	h, flags		; flags[0..size] = 1
+	lxi	b, size+1
+fill:	mvi	m, 1
+	inx	h
+	dcx	b
+	mov	a, b
+	ora	c
+	jnz	fill
+
+	lxi	h, 0
+	shld	primes
+	lxi	b, 0			; bc = i
+loop:	lxi	h, flags
+	dad	b
+	mov	a, m
+	ora	a
+	jz	next
+
+	mov	h, b			; de = prime = i + i + 3
+	mov	l, c
+	dad	h
+	inx	h
+	inx	h
+	inx	h
+	xchg
+	lxi	h, flags		; hl = &flags[i + prime]
+	dad	b
+	dad	d
+strike:	mov	a, l			; while hl < flags + size + 1
+	sui	fend and 0ffh
+	mov	a, h
+	sbi	fend shr 8
+	jnc	found
+	mvi	m, 0
+	dad	d
+	jmp	strike
+
+found:	lhld	primes
+	inx	h
+	shld	primes
+
+next:	inx	b
+	mov	a, b
+	cpi	(size+1) shr 8
+	jnz	loop
+	mov	a, c
+	cpi	(size+1) and 0ffh
+	jnz	loop
+
+	lhld	count
+	dcx	h
+	shld	count
+	mov	a, h
+	ora	l
+	jnz	again
+
+	lhld	primes
+	call	pdec
+	lxi	d, crlf
+	mvi	c, 9
+	call	bdos
+	mvi	c, 0
+	call	bdos
+
+; Print hl as five decimal digits.
+pdec:	lxi	b, -10000
+	call	digit
+	lxi	b, -1000
+	call	digit
+	lxi	b, -100
+	call	digit
+	lxi	b, -10
+	call	digit
+	mov	a, l
+	adi	'0'
+	jmp	putc
+digit:	mvi	e, '0'-1
+dloop:	inr	e
+	dad	b
+	jc	dloop
+	mov	a, l
+	sub	c
+	mov	l, a
+	mov	a, h
+	sbb	b
+	mov	h, a
+	mov	a, e
+putc:	push	h
+	mov	e, a
+	mvi	c, 2
+	call	bdos
+	pop	h
+	ret
+
+crlf:	db	13, 10, '$'
+count:	dw	0
+primes:	dw	0
+	ds	64
+stack:
+
+	end
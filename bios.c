@@ -0,0 +1,634 @@
+/*
+ * Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * The CP/M 2.2 BIOS.  Every entry of the jump table is an out 0; ret
+ * pair, the same trap the BDOS uses at 5, and the main loop tells the
+ * two apart by where the out was.
+ *
+ * Drives A: to P: are raw disk images, in one of the formats below
+ * picked by image size.  Sectors go through a cache of whole tracks:
+ * a track is read with one pread(2) when first wanted and written back
+ * with one pwrite(2) when evicted, at warm boot and at exit.
+ *
+ * With no program to run, the CCP and BDOS are loaded from the reserved
+ * tracks of drive A: and booted.  They are found by the BDOS entry jump
+ * and this BIOS takes the place of the one they were built for.
+ *
+ * Each struct bios has its own drives and cache and talks to its own
+ * console.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bios.h"
+#include "console.h"
+
+#define NDRIVES		16
+#define NTRACKS		16
+#define NBIOS		17	/* Entries in the jump table */
+#define SECSIZ		128
+#define MAXSPT		128
+#define CCPSIZ		0x800
+#define BDOSSIZ		0xe00
+#define COMBIOS		0xf000	/* Where the BIOS goes for .COM files */
+#define BIOSSTATE	16	/* Bytes saved by biossave() */
+
+struct format {
+	const char		*name;
+	off_t			 size;
+	unsigned int		 tracks;
+	unsigned int		 spt;	/* Sectors per track */
+	unsigned int		 first;	/* Number of the first sector */
+	const unsigned char	*xlt;	/* Sector skew, or NULL */
+	unsigned char		 dpb[15];
+};
+
+struct drive {
+	const char		*path;
+	const struct format	*fmt;
+	int			 fd;
+	int			 rdonly;
+	unsigned int		 dph;	/* Disk parameter header */
+};
+
+struct track {
+	int			 drive;	/* -1 if the slot is free */
+	unsigned int		 trk;
+	int			 dirty;
+	unsigned long		 stamp;
+	unsigned char		 buf[MAXSPT * SECSIZ];
+};
+
+static const unsigned char skew6[26] = {
+	1, 7, 13, 19, 25, 5, 11, 17, 23, 3, 9, 15, 21,
+	2, 8, 14, 20, 26, 6, 12, 18, 24, 4, 10, 16, 22
+};
+
+/* DPB: SPT, BSH, BLM, EXM, DSM, DRM, AL0, AL1, CKS, OFF */
+static const struct format formats[] = {
+	/* 8" single sided, single density */
+	{ "ibm-3740", 256256, 77, 26, 1, skew6,
+	    { 26, 0, 3, 7, 0, 242, 0, 63, 0, 0xc0, 0x00, 16, 0, 2, 0 } },
+	/* 4MB hard disk, as in z80pack and many CP/M emulators */
+	{ "hd4mb", 4177920, 255, 128, 0, NULL,
+	    { 128, 0, 4, 15, 0, 0xf7, 0x07, 0xff, 0x03, 0xff, 0xff, 0, 0,
+	    0, 0 } }
+};
+
+struct bios {
+	struct drive		 drives[NDRIVES];
+	int			 ndrives;
+	struct track		 tracks[NTRACKS];
+	unsigned long		 stamp;
+
+	struct console		*con;
+	unsigned char		*mem;
+	void			(*touch)(void *, unsigned int, unsigned int);
+	void			*arg;
+
+	unsigned int		 base, bdos, ccp;
+	unsigned int		 disk, trk, sec, dma;
+	int			 booted;
+	unsigned long long	 nsyscalls;
+};
+
+static unsigned int
+get16(const unsigned char *p)
+{
+
+	return p[0] | p[1] << 8;
+}
+
+static void
+put16(struct bios *b, unsigned int addr, unsigned int v)
+{
+
+	b->mem[addr] = v & 0xff;
+	b->mem[addr + 1] = v >> 8;
+}
+
+static void
+memout(struct bios *b, unsigned int addr, const unsigned char *src, size_t len)
+{
+	size_t n;
+
+	while (len > 0) {
+		addr &= 0xffff;
+		n = 0x10000 - addr;
+		if (n > len)
+			n = len;
+		memcpy(&b->mem[addr], src, n);
+		if (b->touch != NULL)
+			b->touch(b->arg, addr, n);
+		addr += n;
+		src += n;
+		len -= n;
+	}
+}
+
+static void
+tflush(struct bios *b, struct track *t)
+{
+	struct drive *d;
+	size_t len;
+
+	if (t->drive == -1 || !t->dirty)
+		return;
+	d = &b->drives[t->drive];
+	len = d->fmt->spt * SECSIZ;
+	b->nsyscalls++;
+	if (pwrite(d->fd, t->buf, len, (off_t) t->trk * len) != (ssize_t) len)
+		warn("%s", d->path);
+	t->dirty = 0;
+}
+
+/*
+ * Find track trk of drive d in the cache, reading it in over the least
+ * recently used slot if it is not there.  Parts of a track beyond the
+ * end of a short image read as erased.
+ */
+static struct track *
+tget(struct bios *b, int d, unsigned int trk)
+{
+	struct track *t, *lru = &b->tracks[0];
+	size_t len;
+	ssize_t n;
+	int i;
+
+	for (i = 0; i < NTRACKS; i++) {
+		t = &b->tracks[i];
+		if (t->drive == d && t->trk == trk) {
+			t->stamp = ++b->stamp;
+			return t;
+		}
+		if (t->stamp < lru->stamp)
+			lru = t;
+	}
+
+	t = lru;
+	tflush(b, t);
+	len = b->drives[d].fmt->spt * SECSIZ;
+	b->nsyscalls++;
+	n = pread(b->drives[d].fd, t->buf, len, (off_t) trk * len);
+	if (n == -1) {
+		t->drive = -1;
+		return NULL;
+	}
+	memset(&t->buf[n], 0xe5, len - n);
+	t->drive = d;
+	t->trk = trk;
+	t->dirty = 0;
+	t->stamp = ++b->stamp;
+
+	return t;
+}
+
+/*
+ * The cached track holding the current sector, and its offset there.
+ */
+static struct track *
+locate(struct bios *b, size_t *off)
+{
+	const struct format *f;
+
+	if (b->disk >= (unsigned int) b->ndrives)
+		return NULL;
+	f = b->drives[b->disk].fmt;
+	if (b->trk >= f->tracks || b->sec < f->first ||
+	    b->sec - f->first >= f->spt)
+		return NULL;
+	*off = (b->sec - f->first) * SECSIZ;
+
+	return tget(b, b->disk, b->trk);
+}
+
+static int
+rdsec(struct bios *b)
+{
+	struct track *t;
+	size_t off;
+
+	if ((t = locate(b, &off)) == NULL)
+		return 1;
+	memout(b, b->dma, &t->buf[off], SECSIZ);
+
+	return 0;
+}
+
+static int
+wrsec(struct bios *b)
+{
+	struct track *t;
+	size_t i, off;
+
+	if (b->disk < (unsigned int) b->ndrives && b->drives[b->disk].rdonly)
+		return 1;
+	if ((t = locate(b, &off)) == NULL)
+		return 1;
+	for (i = 0; i < SECSIZ; i++)
+		t->buf[off + i] = b->mem[(b->dma + i) & 0xffff];
+	t->dirty = 1;
+
+	return 0;
+}
+
+/*
+ * Copy len bytes of the reserved tracks of drive A:, from off bytes in.
+ */
+static int
+sysread(struct bios *b, unsigned char *dst, size_t off, size_t len)
+{
+	struct track *t;
+	size_t n, tlen = b->drives[0].fmt->spt * SECSIZ;
+
+	while (len > 0) {
+		if ((t = tget(b, 0, off / tlen)) == NULL)
+			return -1;
+		n = tlen - off % tlen;
+		if (n > len)
+			n = len;
+		memcpy(dst, &t->buf[off % tlen], n);
+		dst += n;
+		off += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/*
+ * Load the CCP and BDOS, which follow the boot sector, and set up page
+ * zero.  The drive and user byte and the I/O byte survive a warm boot.
+ * Returns the address of the CCP.
+ */
+static int
+boot(struct bios *b, int cold)
+{
+	unsigned char sys[CCPSIZ + BDOSSIZ];
+
+	if (sysread(b, sys, SECSIZ, sizeof(sys)) == -1) {
+		warn("%s", b->drives[0].path);
+		return -1;
+	}
+	memout(b, b->ccp, sys, sizeof(sys));
+
+	b->mem[0] = 0xc3;
+	put16(b, 1, b->base + 3);
+	if (cold) {
+		b->mem[3] = 0;
+		b->mem[4] = 0;
+	}
+	b->mem[5] = 0xc3;
+	put16(b, 6, b->bdos + 6);
+	if (b->touch != NULL)
+		b->touch(b->arg, 0, 8);
+	b->dma = 0x80;
+
+	return b->ccp;
+}
+
+/*
+ * Give the BIOS n bytes at *p, moving *p past them.
+ */
+static unsigned int
+take(struct bios *b, unsigned int *p, unsigned int n)
+{
+	unsigned int at = *p;
+
+	if (at + n > 0x10000)
+		errx(1, "no room above 0x%04x for the BIOS and its disk tables",
+		    b->base);
+	*p += n;
+	memset(&b->mem[at], 0, n);
+
+	return at;
+}
+
+/*
+ * Lay out the jump table at base, then a directory buffer and, for each
+ * drive, its skew table, DPB, check vector, allocation vector and DPH.
+ */
+static void
+plant(struct bios *b)
+{
+	const struct format *f;
+	unsigned int at, dirbuf, dpb, csv, alv, xlt, p = b->base;
+	int d, i;
+
+	for (i = 0; i < NBIOS; i++) {
+		at = take(b, &p, 3);
+		b->mem[at] = 0xd3;		/* out 0 */
+		b->mem[at + 1] = 0x00;
+		b->mem[at + 2] = 0xc9;	/* ret */
+	}
+	dirbuf = take(b, &p, SECSIZ);
+
+	for (d = 0; d < b->ndrives; d++) {
+		f = b->drives[d].fmt;
+		xlt = 0;
+		if (f->xlt != NULL) {
+			xlt = take(b, &p, f->spt);
+			memcpy(&b->mem[xlt], f->xlt, f->spt);
+		}
+		dpb = take(b, &p, sizeof(f->dpb));
+		memcpy(&b->mem[dpb], f->dpb, sizeof(f->dpb));
+		csv = take(b, &p, get16(&f->dpb[11]));
+		alv = take(b, &p, get16(&f->dpb[5]) / 8 + 1);
+
+		b->drives[d].dph = take(b, &p, 16);
+		put16(b, b->drives[d].dph, xlt);
+		put16(b, b->drives[d].dph + 8, dirbuf);
+		put16(b, b->drives[d].dph + 10, dpb);
+		put16(b, b->drives[d].dph + 12, csv);
+		put16(b, b->drives[d].dph + 14, alv);
+	}
+
+	if (b->touch != NULL)
+		b->touch(b->arg, b->base, p - b->base);
+}
+
+/*
+ * Call BIOS function fn.  Returns what goes in HL, and A, or for the
+ * boot entries the address to continue at.  Returns -1 to stop: a
+ * program run on its own leaving through the BIOS, a booted system
+ * reading past the end of its input, or CONIN told to stop waiting.
+ */
+int
+bioscall(struct bios *b, int fn, unsigned int bc, unsigned int de)
+{
+	int ch;
+
+	switch (fn) {
+	case BIOS_BOOT:
+	case BIOS_WBOOT:
+		biosflush(b);
+		if (!b->booted)
+			return -1;
+		return boot(b, fn == BIOS_BOOT);
+	case 2:		/* CONST */
+		return constat(b->con) ? 0xff : 0;
+	case 3:		/* CONIN */
+		if ((ch = conin(b->con)) == CONSTOP)
+			return -1;
+		if (ch == -1)
+			return b->booted ? -1 : 0x1a;
+		return ch == '\n' ? '\r' : ch;
+	case 4:		/* CONOUT */
+		conputc(b->con, 1, bc & 0xff);
+		break;
+	case 5:		/* LIST */
+	case 6:		/* PUNCH */
+		conputc(b->con, 2, bc & 0xff);
+		break;
+	case 7:		/* READER */
+		return 0x1a;
+	case 8:		/* HOME */
+		b->trk = 0;
+		break;
+	case 9:		/* SELDSK */
+		if ((bc & 0xff) >= (unsigned int) b->ndrives)
+			return 0;
+		b->disk = bc & 0xff;
+		return b->drives[b->disk].dph;
+	case 10:	/* SETTRK */
+		b->trk = bc;
+		break;
+	case 11:	/* SETSEC */
+		b->sec = bc;
+		break;
+	case 12:	/* SETDMA */
+		b->dma = bc;
+		break;
+	case 13:	/* READ */
+		return rdsec(b);
+	case 14:	/* WRITE */
+		return wrsec(b);
+	case 15:	/* LISTST */
+		return 0xff;
+	case 16:	/* SECTRAN */
+		return de != 0 ? b->mem[(de + bc) & 0xffff] : bc;
+	}
+
+	return 0;
+}
+
+/*
+ * The BIOS function whose out 0 leaves the program counter at pc, or -1
+ * if pc is not in the jump table.
+ */
+int
+biosfn(struct bios *b, unsigned int pc)
+{
+
+	if (pc < b->base + 2 || pc >= b->base + 2 + NBIOS * 3 ||
+	    (pc - b->base - 2) % 3 != 0)
+		return -1;
+
+	return (pc - b->base - 2) / 3;
+}
+
+void
+biosflush(struct bios *b)
+{
+	int i;
+
+	for (i = 0; i < NTRACKS; i++)
+		tflush(b, &b->tracks[i]);
+}
+
+/*
+ * Put the disk image at path in the next free drive.  Images that
+ * cannot be written are attached read-only.
+ */
+void
+biosattach(struct bios *b, const char *path)
+{
+	struct drive *d;
+	struct stat st;
+	size_t i;
+
+	if (b->ndrives == NDRIVES)
+		errx(1, "%s: no more than %d drives", path, NDRIVES);
+	d = &b->drives[b->ndrives];
+
+	d->path = path;
+	if ((d->fd = open(path, O_RDWR)) == -1) {
+		if ((errno != EACCES && errno != EROFS) ||
+		    (d->fd = open(path, O_RDONLY)) == -1)
+			err(1, "%s", path);
+		d->rdonly = 1;
+	}
+	if (fstat(d->fd, &st) == -1)
+		err(1, "%s", path);
+
+	for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+		if (formats[i].size == st.st_size)
+			d->fmt = &formats[i];
+	}
+	if (d->fmt == NULL)
+		errx(1, "%s: %lld bytes is not the size of a known disk format",
+		    path, (long long) st.st_size);
+
+	b->ndrives++;
+}
+
+/*
+ * Plant the BIOS in the 64K memory image ram.  If boot is set, find
+ * the system on drive A: and return where to start to boot it.  If fn
+ * is not NULL, it is called with arg for every range of memory the
+ * BIOS writes.
+ */
+unsigned int
+biosinit(struct bios *b, unsigned char *ram, int boot,
+    void (*fn)(void *, unsigned int, unsigned int), void *arg)
+{
+	unsigned char jp[9];
+	const struct format *f;
+
+	b->mem = ram;
+	b->touch = fn;
+	b->arg = arg;
+
+	b->base = COMBIOS;
+	if (boot) {
+		if (b->ndrives == 0)
+			errx(1, "nothing to boot");
+		f = b->drives[0].fmt;
+		if (get16(&f->dpb[13]) * f->spt * SECSIZ <
+		    SECSIZ + CCPSIZ + BDOSSIZ)
+			errx(1, "%s: %s images have no room for a system",
+			    b->drives[0].path, f->name);
+
+		/* The BDOS starts with a serial number and jmp BDOS+0x11 */
+		if (sysread(b, jp, SECSIZ + CCPSIZ, sizeof(jp)) == -1)
+			err(1, "%s", b->drives[0].path);
+		b->bdos = get16(&jp[7]) - 0x11;
+		if (jp[6] != 0xc3 || (b->bdos & 0xff) != 0 ||
+		    b->bdos < 0x1000 || b->bdos + BDOSSIZ > 0xff00)
+			errx(1, "%s: no CP/M 2.2 system on the reserved tracks",
+			    b->drives[0].path);
+		b->ccp = b->bdos - CCPSIZ;
+		b->base = b->bdos + BDOSSIZ;
+		b->booted = 1;
+	}
+	plant(b);
+	if (!b->booted)
+		put16(b, 1, b->base + 3);
+
+	return b->base;
+}
+
+/*
+ * A BIOS with no drives yet that does console I/O on con.
+ */
+struct bios *
+biosnew(struct console *con)
+{
+	struct bios *b;
+	int i;
+
+	if ((b = calloc(1, sizeof(*b))) == NULL)
+		return NULL;
+	b->con = con;
+	b->dma = 0x80;
+	for (i = 0; i < NTRACKS; i++)
+		b->tracks[i].drive = -1;
+
+	return b;
+}
+
+/*
+ * Write back the track cache and detach every image.
+ */
+void
+biosfree(struct bios *b)
+{
+	int d;
+
+	biosflush(b);
+	for (d = 0; d < b->ndrives; d++)
+		close(b->drives[d].fd);
+	free(b);
+}
+
+/*
+ * Save the state of b in a buffer for biosrestore() and return its
+ * length.  The track cache is written out first.
+ */
+size_t
+biossave(struct bios *b, unsigned char **bufp)
+{
+	unsigned char *p;
+	unsigned int v[] = { b->base, b->bdos, b->ccp, b->disk, b->trk,
+	    b->sec, b->dma };
+	size_t i;
+
+	biosflush(b);
+	if ((p = *bufp = malloc(BIOSSTATE)) == NULL)
+		err(1, NULL);
+	for (i = 0; i < sizeof(v) / sizeof(v[0]); i++) {
+		*p++ = v[i] & 0xff;
+		*p++ = (v[i] >> 8) & 0xff;
+	}
+	*p++ = b->booted;
+	*p = b->ndrives;
+
+	return BIOSSTATE;
+}
+
+/*
+ * Take up the state saved by biossave(), after biosinit() without
+ * boot.  The same images must be attached.  Returns -1 if they are not
+ * or the state is bad.
+ */
+int
+biosrestore(struct bios *b, const unsigned char *p, size_t len)
+{
+
+	if (len != BIOSSTATE || p[15] != b->ndrives)
+		return -1;
+	b->base = get16(&p[0]);
+	b->bdos = get16(&p[2]);
+	b->ccp = get16(&p[4]);
+	b->disk = get16(&p[6]);
+	b->trk = get16(&p[8]);
+	b->sec = get16(&p[10]);
+	b->dma = get16(&p[12]);
+	b->booted = p[14] != 0;
+	if (b->base + NBIOS * 3 > 0x10000)
+		return -1;
+
+	return 0;
+}
+
+/* System calls made, for -c */
+unsigned long long
+biossyscalls(struct bios *b)
+{
+
+	return b->nsyscalls;
+}
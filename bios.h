@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define BIOS_BOOT	0
+#define BIOS_WBOOT	1
+
+struct bios;
+struct console;
+
+struct bios		*biosnew(struct console *);
+void			 biosfree(struct bios *);
+void			 biosattach(struct bios *, const char *);
+int			 bioscall(struct bios *, int, unsigned int,
+			    unsigned int);
+int			 biosfn(struct bios *, unsigned int);
+void			 biosflush(struct bios *);
+unsigned int		 biosinit(struct bios *, unsigned char *, int,
+			    void (*)(void *, unsigned int, unsigned int),
+			    void *);
+size_t			 biossave(struct bios *, unsigned char **);
+int			 biosrestore(struct bios *, const unsigned char *,
+			    size_t);
+unsigned long long	 biossyscalls(struct bios *);
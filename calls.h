@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * The execution profile kept by the i80 and z80 cores with -DPROFILE:
+ * a count for every address an instruction started at, and a tree of
+ * the calls made, each node counting the instructions run in that call
+ * but not in the calls it made in turn.
+ *
+ * A shadow stack follows call and ret, with the stack pointer each
+ * return address went to.  A ret drops the frames whose return address
+ * is now below sp, so a routine that pops its return address or resets
+ * sp is unwound at the next ret, and a ret used as a computed jump
+ * drops nothing.  Calls deeper than CALLDEPTH count in the deepest
+ * frame kept.
+ */
+
+#define CALLDEPTH	256
+
+struct callnode {
+	struct callnode		*parent;
+	struct callnode		*child;		/* Its first callee */
+	struct callnode		*next;		/* Its parent's next callee */
+	unsigned long long	 self;		/* Instructions run in it */
+	uint16_t		 addr;		/* Address called */
+};
+
+struct calls {
+	unsigned long long	 hits[0x10000];
+	struct callnode		 root;		/* Outside of any call */
+	struct callnode		*cur;
+	struct {
+		struct callnode	*node;
+		uint16_t	 sp;		/* Of the return address */
+	} stack[CALLDEPTH];
+	int			 depth;
+};
+
+static void
+callsfree(struct callnode *n)
+{
+	struct callnode *next;
+
+	for (n = n->child; n != NULL; n = next) {
+		next = n->next;
+		callsfree(n);
+		free(n);
+	}
+}
+
+/*
+ * Drop the tree and zero the counts.
+ */
+static void
+callsclear(struct calls *c)
+{
+
+	callsfree(&c->root);
+	memset(c, 0, sizeof(*c));
+	c->cur = &c->root;
+}
+
+static void
+callshit(struct calls *c, uint16_t addr, unsigned long long n)
+{
+
+	c->hits[addr] += n;
+	c->cur->self += n;
+}
+
+/*
+ * A return address at slot is gone once sp is above it, allowing for
+ * sp wrapping around at the top of memory.
+ */
+#define CALLGONE(slot, sp)	((uint16_t) ((sp) - (slot) - 1) < 0x8000)
+
+/*
+ * Something returned, leaving the stack pointer at sp.
+ */
+static void
+callsleave(struct calls *c, uint16_t sp)
+{
+
+	while (c->depth > 0 && CALLGONE(c->stack[c->depth - 1].sp, sp))
+		c->depth--;
+	c->cur = c->depth > 0 ? c->stack[c->depth - 1].node : &c->root;
+}
+
+/*
+ * A call to addr pushed its return address at sp.  Frames at or below
+ * sp were left without a ret and are dropped first.
+ */
+static void
+callsenter(struct calls *c, uint16_t addr, uint16_t sp)
+{
+	struct callnode *n, **np;
+
+	callsleave(c, sp + 1);
+	if (c->depth == CALLDEPTH)
+		return;
+
+	for (np = &c->cur->child; (n = *np) != NULL; np = &n->next) {
+		if (n->addr == addr)
+			break;
+	}
+	if (n == NULL) {
+		if ((n = calloc(1, sizeof(*n))) == NULL)
+			err(1, NULL);
+		n->parent = c->cur;
+		n->addr = addr;
+	} else
+		*np = n->next;
+	/* Keep the callee last used first */
+	n->next = c->cur->child;
+	c->cur->child = n;
+
+	c->stack[c->depth].node = n;
+	c->stack[c->depth].sp = sp;
+	c->depth++;
+	c->cur = n;
+}
+
+/*
+ * Call fn for every node that ran instructions, with the addresses
+ * called on the way to it from the outermost.
+ */
+static void
+callswalk(const struct callnode *n, uint16_t *path, int depth,
+    void (*fn)(const unsigned short *, int, unsigned long long, void *),
+    void *arg)
+{
+
+	if (n->self > 0)
+		fn(path, depth, n->self, arg);
+	if (depth == CALLDEPTH)
+		return;
+	for (n = n->child; n != NULL; n = n->next) {
+		path[depth] = n->addr;
+		callswalk(n, path, depth + 1, fn, arg);
+	}
+}
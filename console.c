@@ -0,0 +1,352 @@
+/*
+ * Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Console I/O for the BDOS, one struct console per machine.
+ * Output for the console (fd 1) and the list and auxiliary devices
+ * (fd 2) is collected in a buffer per descriptor and written out when
+ * the buffer passes the threshold, before the program reads console
+ * input, and at exit.  A threshold of 0 writes everything straight
+ * through.
+ *
+ * Input never changes the descriptor flags of its descriptor.  Readiness is
+ * checked with poll(2) and one character of lookahead is kept, so a
+ * status check followed by a read costs a single read(2).  A negative
+ * status is remembered for POLLGAP nanoseconds, which keeps programs
+ * that spin on the console status out of the kernel.  After IDLEMISS
+ * consecutive misses the emulator may also sleep in poll(2) for up to
+ * the idle time, handing the host CPU back until a key arrives.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "console.h"
+
+#define POLLGAP		1000000
+#define IDLEMISS	64
+#define STOPPOLL	250	/* Longest wait in conin() watching flags */
+
+struct outbuf {
+	int	fd;
+	size_t	len;
+	char	buf[CONBUFSIZ];
+};
+
+struct console {
+	struct outbuf		out[2];		/* Console, list and aux */
+	size_t			threshold;
+	int			in;
+	int			pending;	/* Lookahead character */
+	int			eof;		/* in reached end of file */
+	int			idle;		/* Sleep when busy-polling */
+	unsigned int		misses;		/* Empty status checks */
+	uint64_t		quiet;		/* No poll before this time */
+	volatile sig_atomic_t	*stop;		/* Give up waiting when set */
+	volatile sig_atomic_t	*flag;		/* Call fn while waiting */
+	void			(*fn)(void *);
+	void			*arg;
+	unsigned long long	nsyscalls;
+};
+
+static void
+drain(struct console *con, int fd, const char *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		con->nsyscalls++;
+		if ((n = write(fd, buf, len)) == -1) {
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+		buf += n;
+		len -= n;
+	}
+}
+
+static struct outbuf *
+lookup(struct console *con, int fd)
+{
+
+	return fd == 2 ? &con->out[1] : &con->out[0];
+}
+
+/*
+ * A console reading the host descriptor in and writing what goes to
+ * fd 1 to out and what goes to fd 2 to err.  The descriptors stay the
+ * caller's.
+ */
+struct console *
+connew(int in, int out, int err)
+{
+	struct console *con;
+
+	if ((con = calloc(1, sizeof(*con))) == NULL)
+		return NULL;
+	con->out[0].fd = out;
+	con->out[1].fd = err;
+	con->threshold = CONBUFSIZ;
+	con->in = in;
+	con->pending = -1;
+
+	return con;
+}
+
+void
+confree(struct console *con)
+{
+
+	conflush(con);
+	free(con);
+}
+
+/*
+ * Set the flush threshold in bytes.  Negative picks the default:
+ * unbuffered when the output is a terminal, full buffering otherwise.
+ */
+void
+conbuf(struct console *con, long size)
+{
+
+	if (size < 0)
+		size = isatty(con->out[0].fd) ? 0 : CONBUFSIZ;
+	else if (size > CONBUFSIZ)
+		size = CONBUFSIZ;
+
+	conflush(con);
+	con->threshold = size;
+}
+
+void
+conflush(struct console *con)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(con->out) / sizeof(con->out[0]); i++) {
+		drain(con, con->out[i].fd, con->out[i].buf, con->out[i].len);
+		con->out[i].len = 0;
+	}
+}
+
+void
+conout(struct console *con, int fd, const void *buf, size_t len)
+{
+	struct outbuf *ob = lookup(con, fd);
+
+	if (ob->len + len > CONBUFSIZ) {
+		drain(con, ob->fd, ob->buf, ob->len);
+		ob->len = 0;
+	}
+
+	if (con->threshold == 0 || len > CONBUFSIZ) {
+		drain(con, ob->fd, buf, len);
+		return;
+	}
+
+	memcpy(&ob->buf[ob->len], buf, len);
+	ob->len += len;
+
+	if (ob->len >= con->threshold) {
+		drain(con, ob->fd, ob->buf, ob->len);
+		ob->len = 0;
+	}
+}
+
+void
+conputc(struct console *con, int fd, int ch)
+{
+	char c = ch;
+
+	conout(con, fd, &c, 1);
+}
+
+/*
+ * Write the '$'-terminated string at addr in a 64K memory image.
+ * A string may wrap past the top of memory once.
+ */
+void
+conputs(struct console *con, int fd, const unsigned char *mem,
+    unsigned int addr)
+{
+	const unsigned char *end;
+	size_t len;
+
+	addr &= 0xffff;
+	len = 0x10000 - addr;
+	if ((end = memchr(&mem[addr], '$', len)) != NULL) {
+		conout(con, fd, &mem[addr], end - &mem[addr]);
+		return;
+	}
+	conout(con, fd, &mem[addr], len);
+
+	if ((end = memchr(mem, '$', addr)) != NULL)
+		conout(con, fd, mem, end - mem);
+}
+
+static uint64_t
+monotime(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Read one character into the lookahead if one arrives within timeout
+ * milliseconds.  A timeout of -1 waits forever.
+ */
+static void
+fill(struct console *con, int timeout)
+{
+	struct pollfd pfd;
+	unsigned char c;
+	ssize_t n;
+
+	if (con->pending != -1 || con->eof)
+		return;
+
+	conflush(con);
+
+	pfd.fd = con->in;
+	pfd.events = POLLIN;
+	con->nsyscalls++;
+	if (poll(&pfd, 1, timeout) < 1)
+		return;
+
+	con->nsyscalls++;
+	if ((n = read(con->in, &c, 1)) == 1)
+		con->pending = c;
+	else if (n == 0)
+		con->eof = 1;
+}
+
+/*
+ * Sleep for up to ms milliseconds when a program busy-polls the console.
+ * Zero, the default, never sleeps.
+ */
+void
+conidle(struct console *con, int ms)
+{
+
+	con->idle = ms;
+}
+
+/*
+ * Have conin() give up waiting and return CONSTOP once *stop is set,
+ * typically by a signal handler.  NULL waits for input regardless.
+ */
+void
+constop(struct console *con, volatile sig_atomic_t *stop)
+{
+
+	con->stop = stop;
+}
+
+/*
+ * Have conin() call fn with arg whenever *flag is set while it waits,
+ * so that a signal is acted on without waiting for input.  fn clears
+ * the flag.  NULL watches nothing.
+ */
+void
+conwatch(struct console *con, volatile sig_atomic_t *flag,
+    void (*fn)(void *), void *arg)
+{
+
+	con->flag = flag;
+	con->fn = fn;
+	con->arg = arg;
+}
+
+/*
+ * Return the next console character, waiting for one if necessary,
+ * -1 at end of file or CONSTOP if the stop flag was raised.
+ */
+int
+conin(struct console *con)
+{
+	int c;
+
+	while (con->pending == -1 && !con->eof) {
+		if (con->stop != NULL && *con->stop)
+			return CONSTOP;
+		if (con->flag != NULL && *con->flag)
+			con->fn(con->arg);
+		fill(con, con->stop != NULL || con->flag != NULL ?
+		    STOPPOLL : -1);
+	}
+
+	con->misses = 0;
+	con->quiet = 0;
+
+	c = con->pending;
+	con->pending = -1;
+
+	return c;
+}
+
+/*
+ * Return non-zero if a console character is waiting.
+ */
+int
+constat(struct console *con)
+{
+	uint64_t now;
+
+	if (con->pending != -1)
+		return 1;
+	if (con->eof)
+		return 0;
+
+	if (con->idle == 0 || con->misses < IDLEMISS) {
+		now = monotime();
+		if (now < con->quiet) {
+			con->misses++;
+			return 0;
+		}
+		fill(con, 0);
+	} else {
+		fill(con, con->idle);
+		now = monotime();
+	}
+
+	if (con->pending != -1) {
+		con->misses = 0;
+		return 1;
+	}
+
+	con->misses++;
+	con->quiet = now + POLLGAP;
+
+	return 0;
+}
+
+/* System calls made, for -c */
+unsigned long long
+consyscalls(struct console *con)
+{
+
+	return con->nsyscalls;
+}
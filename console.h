@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define CONBUFSIZ	8192
+#define CONSTOP		(-2)	/* conin() gave up, see constop() */
+
+struct console;
+
+struct console		*connew(int, int, int);
+void			 confree(struct console *);
+void			 conbuf(struct console *, long);
+void			 conflush(struct console *);
+void			 conidle(struct console *, int);
+int			 conin(struct console *);
+void			 conout(struct console *, int, const void *, size_t);
+void			 conputc(struct console *, int, int);
+void			 conputs(struct console *, int, const unsigned char *,
+			    unsigned int);
+int			 constat(struct console *);
+void			 constop(struct console *, volatile sig_atomic_t *);
+void			 conwatch(struct console *, volatile sig_atomic_t *,
+			    void (*)(void *), void *);
+unsigned long long	 consyscalls(struct console *);
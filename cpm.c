@@ -0,0 +1,1160 @@
+/*
+ * Copyright (c) 2020 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <err.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "bdos.h"
+#include "bios.h"
+#include "console.h"
+#include "cpm.h"
+#include "profile.h"
+#include "ring.h"
+#include "state.h"
+
+#define SLICE		(1 << 20)	/* Instructions between stop checks */
+#define RINGSIZE	(32 << 20)	/* Trace held for the writer */
+
+/* Calls to one BDOS or BIOS function, for -x */
+struct fnstats {
+	unsigned long long	 calls;
+	unsigned long long	 nsec;		/* Host time spent in them */
+};
+
+/* Opcode tables kept with -DSTATS: none, then after each prefix */
+static const int prefixes[] = { 0, 0xcb, 0xdd, 0xed, 0xfd };
+#define NPREFIXES	(sizeof(prefixes) / sizeof(prefixes[0]))
+
+/* A machine and the CP/M around it */
+struct cpm {
+	void			*m;
+	unsigned char		*ram;
+	struct console		*con;
+	struct bios		*bios;
+	struct bdos		*bdos;
+	struct job		*record;	/* Snapshot at console input */
+	int			 incall;	/* Stopped inside a CP/M call */
+	unsigned long long	 instrs, cycles, nsyscalls;
+	unsigned long long	 ops[NPREFIXES][256];
+	struct fnstats		 bdosfns[256], biosfns[256];
+};
+
+/* A machine stopped at its first console read, for -w */
+struct snap {
+	void			*m;
+	struct bdos		*bdos;
+	unsigned char		*out;		/* Output written until then */
+	size_t			 outlen;
+};
+
+static const struct cpu *cpu;	/* The library under the front end */
+static struct cpm *cpm;	/* The machine, or the batch totals for -c */
+static struct profile *prof;	/* Names for -p and -g */
+static struct ring *ring;	/* On its way to the file for -T */
+static volatile sig_atomic_t stopping;	/* Save and exit, for -S */
+static volatile sig_atomic_t dumping;	/* Write the counts for -x */
+static const char *statsfile;
+static const char *tracefile;
+static pthread_mutex_t statslock = PTHREAD_MUTEX_INITIALIZER;
+
+static long bufsize = -1;
+static int dflags, warmstart;
+
+/*
+ * The BDOS or BIOS wrote len bytes at addr behind the CPU's back.
+ */
+static void
+touched(void *arg, unsigned int addr, unsigned int len)
+{
+	struct cpm *c = arg;
+
+	cpu->touch(c->m, addr, len);
+}
+
+static void
+poke(struct cpm *c, unsigned int addr, int val)
+{
+
+	addr &= 0xffff;
+	c->ram[addr] = val;
+	cpu->touch(c->m, addr, 1);
+}
+
+/*
+ * Set L and A, as the BDOS returns single byte results.
+ */
+static void
+retbyte(void *m, int val)
+{
+
+	cpu->set(m, CPU_L, val);
+	cpu->set(m, CPU_A, val);
+}
+
+static void
+snapfree(void *arg)
+{
+	struct snap *s = arg;
+
+	if (s == NULL)
+		return;
+	if (s->bdos != NULL)
+		bdosfree(s->bdos);
+	if (s->m != NULL)
+		cpu->free(s->m);
+	free(s->out);
+	free(s);
+}
+
+/*
+ * Record the machine for the other jobs of its group, which start with
+ * the console read about to happen.  What the job has written so far
+ * is read back from its output file for them to repeat.
+ */
+static void
+snapshot(struct cpm *c)
+{
+	struct job *j = c->record;
+	struct snap *s;
+	off_t len;
+
+	c->record = NULL;
+	conflush(c->con);
+	if ((len = lseek(j->out, 0, SEEK_CUR)) == -1 ||
+	    (s = calloc(1, sizeof(*s))) == NULL)
+		return;
+	if ((s->m = cpu->new()) == NULL ||
+	    (s->bdos = bdosnew(cpu->ram(s->m), NULL, 0, NULL, NULL)) == NULL ||
+	    (s->out = malloc(len + 1)) == NULL ||
+	    pread(j->out, s->out, len, 0) != len) {
+		snapfree(s);
+		return;
+	}
+	s->outlen = len;
+	cpu->copy(s->m, c->m);
+	bdoscopy(s->bdos, c->bdos);
+
+	warmput(j, s);
+}
+
+/*
+ * Whether the CP/M call at hand reads the console, which is where the
+ * jobs of a group part ways.
+ */
+static int
+coninput(struct cpm *c, void *m)
+{
+
+	switch (biosfn(c->bios, cpu->get(m, CPU_PC))) {
+	case -1:
+		break;
+	case 2:		/* CONST */
+	case 3:		/* CONIN */
+		return 1;
+	default:
+		return 0;
+	}
+
+	switch (cpu->get(m, CPU_C)) {
+	case 1:		/* C_READ */
+	case 10:	/* C_READSTR */
+	case 11:	/* C_STAT */
+		return 1;
+	case 6:		/* C_RAWIO */
+		return cpu->get(m, CPU_E) >= 0xfd;
+	}
+
+	return 0;
+}
+
+/*
+ * A console read gave up because of a signal.  Stop with the call
+ * undone, to be made again when the saved state is restored.
+ */
+static int
+interrupted(struct cpm *c)
+{
+
+	c->incall = 1;
+
+	return 1;
+}
+
+/*
+ * The BDOS entry at 5 and the BIOS jump table both do out 0.  Returns
+ * non-zero when the program is done or stopped.
+ */
+static int
+cpmcall(struct cpm *c, int port, int val)
+{
+	struct console *con = c->con;
+	void *m = c->m;
+	unsigned int addr, save, size;
+	int ch, fn, ret;
+
+	if (port != 0)
+		return 0;
+
+	if (c->record != NULL && coninput(c, m))
+		snapshot(c);
+
+	if ((fn = biosfn(c->bios, cpu->get(m, CPU_PC))) != -1) {
+		if ((ret = bioscall(c->bios, fn, cpu->get(m, CPU_BC),
+		    cpu->get(m, CPU_DE))) == -1)
+			return stopping && fn == 3 ? interrupted(c) : 1;
+		if (fn == BIOS_BOOT || fn == BIOS_WBOOT) {
+			cpu->set(m, CPU_PC, ret);
+			cpu->set(m, CPU_C, c->ram[4]);
+		} else {
+			cpu->set(m, CPU_HL, ret);
+			cpu->set(m, CPU_A, ret & 0xff);
+		}
+		return 0;
+	}
+
+	switch (cpu->get(m, CPU_C)) {
+	case 0:		/* P_TERMCPM */
+		return 1;
+	case 1:		/* C_READ */
+		/* End of input reads as ^Z */
+		if ((ch = conin(con)) == CONSTOP)
+			return interrupted(c);
+		if (ch == -1)
+			ch = 0x1a;
+		retbyte(m, ch);
+		conputc(con, 1, ch);
+		break;
+	case 2:		/* C_WRITE */
+		conputc(con, 1, cpu->get(m, CPU_E));
+		break;
+	case 3:		/* A_READ */
+		retbyte(m, 0);
+		break;
+	case 4:		/* A_WRITE */
+		conputc(con, 2, cpu->get(m, CPU_E));
+		break;
+	case 5:		/* L_WRITE */
+		conputc(con, 2, cpu->get(m, CPU_E));
+		break;
+	case 6:		/* C_RAWIO */
+		switch (cpu->get(m, CPU_E)) {
+		case 0xff:
+			retbyte(m, constat(con) ? conin(con) : 0);
+			break;
+		case 0xfe:
+			retbyte(m, constat(con) ? 0xff : 0);
+			break;
+		case 0xfd:
+			if ((ch = conin(con)) == CONSTOP)
+				return interrupted(c);
+			if (ch == -1)
+				ch = 0x1a;
+			retbyte(m, ch);
+			break;
+		default:
+			conputc(con, 1, cpu->get(m, CPU_E));
+			retbyte(m, 0);
+		}
+		break;
+	case 7:		/* Get I/O byte */
+		break;
+	case 8:		/* Set I/O byte */
+		break;
+	case 9:		/* C_WRITESTR */
+		conputs(con, 1, c->ram, cpu->get(m, CPU_DE));
+		break;
+	case 10:	/* C_READSTR */
+		addr = cpu->get(m, CPU_DE);
+		size = c->ram[addr];
+		save = addr++;
+		++addr;
+		while (1) {
+			/* A line cut short is typed again after restore */
+			if ((ch = conin(con)) == CONSTOP)
+				return interrupted(c);
+			if (ch == -1)
+				ch = '\r';
+
+			if (ch == '\n')
+				ch = '\r';
+
+			if (ch == '\r')
+				break;
+
+			if (addr - save + 2 < size)
+				poke(c, addr, ch);
+
+			conout(con, 1, &c->ram[addr++ & 0xffff], 1);
+		}
+
+		addr = addr - save + 1;
+		poke(c, save + 1, addr & 0xff);
+
+		break;
+	case 11:	/* C_STAT */
+		retbyte(m, constat(con) ? 0xff : 0);
+		break;
+	case 12:	/* S_BDOSVER */
+		cpu->set(m, CPU_H, 0);
+		cpu->set(m, CPU_B, 0);
+		retbyte(m, 0x22);
+		break;
+	default:	/* Files and disks */
+		fn = cpu->get(m, CPU_C);
+		if (fn >= 13 && fn <= 40) {
+			ret = bdoscall(c->bdos, fn, cpu->get(m, CPU_DE));
+			cpu->set(m, CPU_HL, ret);
+			cpu->set(m, CPU_A, ret & 0xff);
+			cpu->set(m, CPU_B, ret >> 8);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * The out handler that io() installs: cpmcall(), which -DSTATS also
+ * counts and times by BDOS or BIOS function.
+ */
+int
+cpmout(void *arg, int port, int val)
+{
+	struct cpm *c = arg;
+#ifdef STATS
+	struct fnstats *fs;
+	struct timespec t0, t1;
+	int fn, ret;
+
+	if (port != 0)
+		return 0;
+	if ((fn = biosfn(c->bios, cpu->get(c->m, CPU_PC))) != -1)
+		fs = &c->biosfns[fn];
+	else
+		fs = &c->bdosfns[cpu->get(c->m, CPU_C)];
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	ret = cpmcall(c, port, val);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	fs->calls++;
+	fs->nsec += (t1.tv_sec - t0.tv_sec) * 1000000000LL +
+	    (t1.tv_nsec - t0.tv_nsec);
+
+	return ret;
+#else
+	return cpmcall(c, port, val);
+#endif
+}
+
+/*
+ * World's smallest CP/M
+ */
+static void
+zero(unsigned char *ram)
+{
+
+	ram[0] = 0x76;
+
+	ram[5] = 0xd3;
+	ram[6] = 0x00;
+	ram[7] = 0xc9;
+}
+
+/*
+ * Load a .COM image into the TPA at 0x100 with as few reads as the
+ * kernel allows.  The TPA ends where the BIOS starts, at top.
+ */
+static int
+load(unsigned char *ram, const char *file, unsigned int top)
+{
+	size_t len = 0, tpa = top - 0x100;
+	ssize_t n;
+	int fd;
+
+	if ((fd = open(file, O_RDONLY)) == -1) {
+		warn("%s", file);
+		return -1;
+	}
+
+	/* Ask for one byte more than fits to detect oversized images */
+	while (len <= tpa) {
+		if ((n = read(fd, &ram[0x100 + len], tpa + 1 - len)) == -1) {
+			warn("%s", file);
+			close(fd);
+			return -1;
+		}
+		if (n == 0)
+			break;
+		len += n;
+	}
+	close(fd);
+
+	if (len > tpa) {
+		warnx("%s: image too large for the %zu byte TPA", file, tpa);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Plant CP/M in memory and load prog with its arguments, or get ready
+ * to boot drive A: if prog is NULL.  Returns where to start, or -1.
+ */
+static int
+setup(struct cpm *c, const char *prog, const char *dir, int argc,
+    char *argv[])
+{
+	unsigned int addr;
+
+	zero(c->ram);
+	addr = biosinit(c->bios, c->ram, prog == NULL, touched, c);
+	if ((c->bdos = bdosnew(c->ram, dir, dflags, touched, c)) == NULL)
+		err(1, NULL);
+	if (prog != NULL) {
+		if (load(c->ram, prog, addr) == -1)
+			return -1;
+		bdosargs(c->bdos, argc, argv);
+		addr = 0x100;
+	}
+	cpu->touch(c->m, 0, 0x10000);
+
+	cpu->io(c->m, c);
+	cpu->set(c->m, CPU_PC, addr);
+
+	return addr;
+}
+
+static void
+fnjson(FILE *fp, const char *name, const struct fnstats *fs)
+{
+	int fn, sep = 0;
+
+	fprintf(fp, ",\n\t\"%s\": {", name);
+	for (fn = 0; fn < 256; fn++) {
+		if (fs[fn].calls == 0)
+			continue;
+		fprintf(fp, "%s\n\t\t\"%d\": { \"calls\": %llu, "
+		    "\"seconds\": %.9f }", sep ? "," : "", fn, fs[fn].calls,
+		    fs[fn].nsec / 1e9);
+		sep = 1;
+	}
+	fprintf(fp, "%s}", sep ? "\n\t" : "");
+}
+
+/*
+ * Write the counts for -x as JSON: the instructions run by opcode,
+ * alone and after each prefix the CPU has, and the calls made to each
+ * BDOS and BIOS function with the host time spent in them.  c holds
+ * the counts of finished runs, and those of live, if not NULL, are
+ * added in.  The file is replaced as a whole, so that readers never
+ * see half of it.
+ */
+static int
+dumpstats(const struct cpm *c, void *live)
+{
+	static const char *const names[] = {
+		"opcodes", "cb", "dd", "ed", "fd"
+	};
+	const unsigned long long *ops;
+	unsigned long long n, total = 0;
+	size_t i, j, len;
+	char *tmp;
+	FILE *fp;
+	int fd, ret = 0, sep;
+
+	len = strlen(statsfile) + sizeof(".XXXXXXXXXX");
+	if ((tmp = malloc(len)) == NULL)
+		err(1, NULL);
+	snprintf(tmp, len, "%s.XXXXXXXXXX", statsfile);
+	if ((fd = mkstemp(tmp)) == -1) {
+		warn("%s", tmp);
+		free(tmp);
+		return -1;
+	}
+	if ((fp = fdopen(fd, "w")) == NULL)
+		err(1, NULL);
+
+	ops = live != NULL ? cpu->ops(live, 0) : NULL;
+	for (j = 0; j < 256; j++)
+		total += c->ops[0][j] + (ops != NULL ? ops[j] : 0);
+	fprintf(fp, "{\n\t\"instructions\": %llu", total);
+	for (i = 0; i < NPREFIXES; i++) {
+		/* Only the tables the CPU has */
+		if (cpu->ops(c->m, prefixes[i]) == NULL)
+			continue;
+		ops = live != NULL ? cpu->ops(live, prefixes[i]) : NULL;
+		fprintf(fp, ",\n\t\"%s\": {", names[i]);
+		sep = 0;
+		for (j = 0; j < 256; j++) {
+			n = c->ops[i][j] + (ops != NULL ? ops[j] : 0);
+			if (n == 0)
+				continue;
+			fprintf(fp, "%s\n\t\t\"0x%02zx\": %llu",
+			    sep ? "," : "", j, n);
+			sep = 1;
+		}
+		fprintf(fp, "%s}", sep ? "\n\t" : "");
+	}
+	fnjson(fp, "bdos", c->bdosfns);
+	fnjson(fp, "bios", c->biosfns);
+	fprintf(fp, "\n}\n");
+
+	if (fflush(fp) == EOF || ferror(fp)) {
+		warn("%s", tmp);
+		ret = -1;
+	}
+	fclose(fp);
+	if (ret == 0 && rename(tmp, statsfile) == -1) {
+		warn("%s", statsfile);
+		ret = -1;
+	}
+	if (ret == -1)
+		unlink(tmp);
+	free(tmp);
+
+	return ret;
+}
+
+/*
+ * Write the counts for -x after a SIGUSR1, with those of the machine
+ * running if it is the only one.  The threads of a batch write the
+ * counts of the jobs finished so far, whichever of them gets here first.
+ */
+static void
+dumpnow(void *arg)
+{
+	struct cpm *c = arg;
+
+	pthread_mutex_lock(&statslock);
+	if (dumping) {
+		dumping = 0;
+		dumpstats(cpm, c == cpm ? c->m : NULL);
+	}
+	pthread_mutex_unlock(&statslock);
+}
+
+/*
+ * Run until the program ends or a signal stops it, then add up the
+ * counters for -c and -x.  A SIGUSR1 has the counts for -x written
+ * out at the next slice, or while waiting for input.  A machine
+ * resumed from a snapshot or a saved state first finishes the CP/M
+ * call it was stopped in.  Returns non-zero if the program was stopped
+ * before its end.
+ */
+static int
+run(struct cpm *c, int resume)
+{
+	const unsigned long long *ops;
+	unsigned long long cycles, instrs;
+	size_t i, j;
+	int ret = CPU_STOP;
+
+	c->incall = 0;
+	if (!resume || cpmout(c, 0, 0) == 0) {
+		while ((ret = cpu->run(c->m, SLICE)) == CPU_BUDGET &&
+		    !stopping) {
+			if (dumping)
+				dumpnow(c);
+		}
+	}
+
+	biosflush(c->bios);
+	bdosflush(c->bdos);
+	conflush(c->con);
+	if (cpu->counters(c->m, &instrs, &cycles) == 0) {
+		c->instrs += instrs;
+		c->cycles += cycles;
+	}
+	for (i = 0; i < NPREFIXES; i++) {
+		if ((ops = cpu->ops(c->m, prefixes[i])) == NULL)
+			continue;
+		for (j = 0; j < 256; j++)
+			c->ops[i][j] += ops[j];
+	}
+	c->nsyscalls += consyscalls(c->con) + biossyscalls(c->bios) +
+	    bdossyscalls(c->bdos);
+
+	return ret == CPU_BUDGET || c->incall;
+}
+
+/*
+ * Write the state of the stopped machine to path, with the directory
+ * the BDOS works in so that -R needs no -d.
+ */
+static int
+save(struct cpm *c, const char *path, const char *dir)
+{
+	unsigned char *buf, *reg;
+	char real[PATH_MAX];
+	struct state *st;
+	unsigned int v;
+	size_t i, len;
+
+	if (realpath(dir != NULL ? dir : ".", real) == NULL) {
+		warn("%s", dir != NULL ? dir : ".");
+		return -1;
+	}
+	if ((st = statecreate(path, cpu->magic,
+	    c->incall ? STATE_INCALL : 0)) == NULL)
+		return -1;
+
+	if ((reg = malloc(cpu->nregs * 3)) == NULL)
+		err(1, NULL);
+	for (i = 0; i < cpu->nregs; i++) {
+		v = cpu->get(c->m, cpu->regs[i]);
+		reg[i * 3] = cpu->regs[i];
+		reg[i * 3 + 1] = v & 0xff;
+		reg[i * 3 + 2] = v >> 8;
+	}
+	stateput(st, "REGS", reg, cpu->nregs * 3);
+	free(reg);
+	stateputmem(st, c->ram);
+	stateput(st, "PORT", cpu->ports(c->m), 256);
+	len = biossave(c->bios, &buf);
+	stateput(st, "BIOS", buf, len);
+	free(buf);
+	len = bdossave(c->bdos, &buf);
+	stateput(st, "BDOS", buf, len);
+	free(buf);
+	stateput(st, "DIR ", real, strlen(real));
+
+	return stateclose(st);
+}
+
+/*
+ * Set the machine up from the state file at path, in place of setup().
+ * Without a directory in *dirp, the one saved is used and put there.
+ * Returns -1 on failure, or whether it stopped inside a CP/M call.
+ */
+static int
+restore(struct cpm *c, const char *path, char **dirp)
+{
+	const unsigned char *p, *reg;
+	struct state *st;
+	size_t i, len, nreg;
+	int flags;
+
+	if ((st = stateopen(path, cpu->magic, &flags)) == NULL)
+		return -1;
+
+	biosinit(c->bios, c->ram, 0, touched, c);
+	if ((p = stateget(st, "BIOS", &len)) == NULL ||
+	    biosrestore(c->bios, p, len) == -1) {
+		warnx("%s: saved with other disk images than -i gives",
+		    path);
+		goto bad;
+	}
+	if (*dirp == NULL && (p = stateget(st, "DIR ", &len)) != NULL &&
+	    (*dirp = strndup((const char *) p, len)) == NULL)
+		err(1, NULL);
+	if ((c->bdos = bdosnew(c->ram, *dirp, dflags, touched, c)) == NULL)
+		err(1, NULL);
+	if ((reg = stateget(st, "REGS", &nreg)) == NULL || nreg % 3 != 0 ||
+	    (p = stateget(st, "BDOS", &len)) == NULL ||
+	    bdosrestore(c->bdos, p, len) == -1 ||
+	    stategetmem(st, c->ram) == -1)
+		goto corrupt;
+
+	for (i = 0; i < nreg; i += 3)
+		cpu->set(c->m, reg[i], reg[i + 1] | reg[i + 2] << 8);
+	if ((p = stateget(st, "PORT", &len)) != NULL && len == 256)
+		memcpy(cpu->ports(c->m), p, 256);
+	statefree(st);
+
+	cpu->touch(c->m, 0, 0x10000);
+	cpu->io(c->m, c);
+
+	return (flags & STATE_INCALL) != 0;
+
+corrupt:
+	warnx("%s: corrupt state file", path);
+bad:
+	statefree(st);
+
+	return -1;
+}
+
+static void
+stop(int sig)
+{
+
+	stopping = 1;
+}
+
+static void
+dump(int sig)
+{
+
+	dumping = 1;
+}
+
+/*
+ * Have the signals that end a process stop the machine instead, for
+ * -S to save it.
+ */
+static void
+catch(struct console *con)
+{
+	struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sigemptyset(&sa.sa_mask);
+	sa.sa_handler = stop;
+	if (sigaction(SIGHUP, &sa, NULL) == -1 ||
+	    sigaction(SIGINT, &sa, NULL) == -1 ||
+	    sigaction(SIGTERM, &sa, NULL) == -1)
+		err(1, "sigaction");
+	constop(con, &stopping);
+}
+
+/*
+ * Print the counters for -c: instructions, T-states, host system calls
+ * made on behalf of the BDOS and wall clock time since start.
+ */
+static void
+report(const struct cpm *c, const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	fprintf(stderr, "%llu instructions %llu T-states %llu syscalls "
+	    "%.6f seconds\n", c->instrs, c->cycles, c->nsyscalls,
+	    (now.tv_sec - start->tv_sec) +
+	    (now.tv_nsec - start->tv_nsec) / 1e9);
+}
+
+/*
+ * Write one call path for -g.
+ */
+static void
+fold(const unsigned short *path, int depth, unsigned long long count,
+    void *arg)
+{
+
+	proffold(prof, arg, path, depth, count);
+}
+
+/*
+ * Write the report for -p and the folded call stacks for -g.
+ */
+static int
+profile(const char *reportfile, const char *foldfile)
+{
+	FILE *fp;
+	int ret = 0;
+
+	if (reportfile != NULL &&
+	    profreport(prof, reportfile, cpu->hits(cpm->m)) == -1)
+		ret = -1;
+	if (foldfile == NULL)
+		return ret;
+
+	if ((fp = fopen(foldfile, "w")) == NULL) {
+		warn("%s", foldfile);
+		return -1;
+	}
+	cpu->calls(cpm->m, fold, fp);
+	if (ferror(fp)) {
+		warn("%s", foldfile);
+		ret = -1;
+	}
+	if (fclose(fp) == EOF && ret == 0) {
+		warn("%s", foldfile);
+		ret = -1;
+	}
+
+	return ret;
+}
+
+/*
+ * End the trace for -T and wait for the rest of it to be written.
+ */
+static int
+tracestop(void)
+{
+	struct ring *r = ring;
+
+	ring = NULL;
+	cpu->trace(cpm->m, NULL, NULL);
+	if (ringclose(r) == -1) {
+		warn("%s", tracefile);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void
+cleanup(void)
+{
+
+	/* An error may end the program, and the trace shows what led up */
+	if (ring != NULL)
+		tracestop();
+	biosflush(cpm->bios);
+	if (cpm->bdos != NULL)
+		bdosflush(cpm->bdos);
+	conflush(cpm->con);
+}
+
+/*
+ * A machine for one thread of a batch.
+ */
+static void *
+jobnew(void)
+{
+	struct cpm *c;
+
+	if ((c = calloc(1, sizeof(*c))) == NULL ||
+	    (c->m = cpu->new()) == NULL)
+		return NULL;
+	c->ram = cpu->ram(c->m);
+
+	return c;
+}
+
+/*
+ * Start a job from the snapshot s.
+ */
+static void
+resume(struct cpm *c, const char *dir, struct snap *s)
+{
+
+	cpu->copy(c->m, s->m);
+	biosinit(c->bios, c->ram, 0, touched, c);
+	if ((c->bdos = bdosnew(c->ram, dir, dflags, touched, c)) == NULL)
+		err(1, NULL);
+	bdoscopy(c->bdos, s->bdos);
+	conout(c->con, 1, s->out, s->outlen);
+	cpu->io(c->m, c);
+}
+
+/*
+ * Fold the counters of a batch job into the process's, for -c and for
+ * -x to write on a SIGUSR1 before the batch is done.
+ */
+static void
+tally(struct cpm *c)
+{
+	size_t i, j;
+
+	pthread_mutex_lock(&statslock);
+	cpm->instrs += c->instrs;
+	cpm->cycles += c->cycles;
+	cpm->nsyscalls += c->nsyscalls;
+	for (i = 0; i < NPREFIXES; i++) {
+		for (j = 0; j < 256; j++)
+			cpm->ops[i][j] += c->ops[i][j];
+	}
+	for (i = 0; i < 256; i++) {
+		cpm->bdosfns[i].calls += c->bdosfns[i].calls;
+		cpm->bdosfns[i].nsec += c->bdosfns[i].nsec;
+		cpm->biosfns[i].calls += c->biosfns[i].calls;
+		cpm->biosfns[i].nsec += c->biosfns[i].nsec;
+	}
+	pthread_mutex_unlock(&statslock);
+
+	c->instrs = c->cycles = c->nsyscalls = 0;
+	memset(c->ops, 0, sizeof(c->ops));
+	memset(c->bdosfns, 0, sizeof(c->bdosfns));
+	memset(c->biosfns, 0, sizeof(c->biosfns));
+}
+
+/*
+ * Run one job of a batch on a clean machine, or with -w from the
+ * snapshot of its group.
+ */
+static int
+jobrun(void *arg, struct job *j)
+{
+	struct cpm *c = arg;
+	void *snap;
+	int ret = 0, warm = WARM_COLD;
+
+	if ((c->con = connew(j->in, j->out, j->out)) == NULL ||
+	    (c->bios = biosnew(c->con)) == NULL)
+		err(1, NULL);
+	conbuf(c->con, bufsize);
+
+	if (warmstart)
+		warm = warmget(j, &snap);
+	if (warm == WARM_READY) {
+		resume(c, j->dir, snap);
+		run(c, 1);
+	} else {
+		cpu->reset(c->m);
+		memset(c->ram, 0, 0x10000);
+		if (warm == WARM_RECORD)
+			c->record = j;
+		if (setup(c, j->prog, j->dir, j->argc, j->argv) == -1)
+			ret = -1;
+		else
+			run(c, 0);
+		c->record = NULL;
+	}
+
+	bdosfree(c->bdos);
+	biosfree(c->bios);
+	confree(c->con);
+	c->bdos = NULL;
+	c->bios = NULL;
+	c->con = NULL;
+	tally(c);
+
+	return ret;
+}
+
+/*
+ * Free the machine of a batch thread.
+ */
+static void
+jobdone(void *arg)
+{
+	struct cpm *c = arg;
+
+	cpu->free(c->m);
+	free(c);
+}
+
+static const struct batchops ops = { jobnew, jobrun, jobdone, snapfree };
+
+static void
+usage(void)
+{
+
+	fprintf(stderr, "usage: %s [%s] [-b bufsize] [-d dir] "
+	    "[-g folded] [-i image]\n"
+	    "           [-p report] [-R state] [-S state] [-s msec] "
+	    "[-T trace]\n"
+	    "           [-x stats] [-y symbols] [file.com [arg ...]]\n"
+	    "       %s [-cmuw] [-b bufsize] [-t threads] [-x stats] "
+	    "-f manifest\n", cpu->name, cpu->jit != NULL ? "-cJjmu" : "-cmu",
+	    cpu->name);
+	exit(1);
+}
+
+/*
+ * Run the program or manifest that argv names on the CPU of c.
+ */
+int
+cpmmain(const struct cpu *c, int argc, char *argv[])
+{
+	char *dir = NULL, *ep, *manifest = NULL, *restorefile = NULL;
+	char *foldfile = NULL, *reportfile = NULL, *savefile = NULL;
+	char *symfile = NULL;
+	const char *top;
+	struct sigaction sa;
+	struct timespec start;
+	unsigned long long x;
+	long n;
+	int ch, failed, images = 0, incall, jit = 0, ms, stats = 0, threads;
+
+	cpu = c;
+	if ((cpm = calloc(1, sizeof(*cpm))) == NULL ||
+	    (cpm->m = cpu->new()) == NULL ||
+	    (cpm->con = connew(0, 1, 2)) == NULL ||
+	    (cpm->bios = biosnew(cpm->con)) == NULL)
+		err(1, NULL);
+	cpm->ram = cpu->ram(cpm->m);
+
+	if ((n = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+		n = 1;
+	threads = n;
+
+	while ((ch = getopt(argc, argv,
+	    "b:cd:f:g:i:Jjmp:R:S:s:T:t:uwx:y:")) != -1) {
+		switch (ch) {
+		case 'b':
+			bufsize = strtol(optarg, &ep, 10);
+			if (*optarg == '\0' || *ep != '\0' || bufsize < 0)
+				errx(1, "invalid buffer size: %s", optarg);
+			break;
+		case 'c':
+			stats = 1;
+			break;
+		case 'd':
+			dir = optarg;
+			break;
+		case 'f':
+			manifest = optarg;
+			break;
+		case 'g':
+			foldfile = optarg;
+			break;
+		case 'i':
+			biosattach(cpm->bios, optarg);
+			images++;
+			break;
+		case 'm':
+			dflags |= BDOS_MMAP;
+			break;
+		case 'J':
+			if (cpu->jit == NULL)
+				usage();
+			jit = 2;
+			break;
+		case 'j':
+			if (cpu->jit == NULL)
+				usage();
+			if (jit == 0)
+				jit = 1;
+			break;
+		case 'p':
+			reportfile = optarg;
+			break;
+		case 'R':
+			restorefile = optarg;
+			break;
+		case 'S':
+			savefile = optarg;
+			break;
+		case 's':
+			ms = strtol(optarg, &ep, 10);
+			if (*optarg == '\0' || *ep != '\0' || ms < 0 ||
+			    ms > 1000)
+				errx(1, "invalid sleep time: %s", optarg);
+			conidle(cpm->con, ms);
+			break;
+		case 'T':
+			tracefile = optarg;
+			break;
+		case 't':
+			n = strtol(optarg, &ep, 10);
+			if (*optarg == '\0' || *ep != '\0' || n < 1 ||
+			    n > 1024)
+				errx(1, "invalid thread count: %s", optarg);
+			threads = n;
+			break;
+		case 'u':
+			bufsize = 0;
+			break;
+		case 'w':
+			warmstart = 1;
+			break;
+		case 'x':
+			statsfile = optarg;
+			break;
+		case 'y':
+			symfile = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	if (manifest != NULL ?
+	    argc > 0 || dir != NULL || images > 0 || jit ||
+	    restorefile != NULL || savefile != NULL || reportfile != NULL ||
+	    foldfile != NULL || tracefile != NULL :
+	    restorefile != NULL ? argc > 0 || warmstart :
+	    (argc < 1 && images == 0) || warmstart)
+		usage();
+	if (symfile != NULL && reportfile == NULL && foldfile == NULL)
+		usage();
+
+	if (stats && cpu->counters(cpm->m, &x, &x) == -1)
+		errx(1, "-c needs a build with -DCYCLES");
+	if (jit && cpu->jit(cpm->m, jit) == -1)
+		errx(1, "-j needs the switch engine on x86-64 with lahf");
+	if (jit && (reportfile != NULL || foldfile != NULL ||
+	    statsfile != NULL || tracefile != NULL))
+		errx(1, "-p, -g, -T and -x cannot be used with -j");
+	if (statsfile != NULL && cpu->ops(cpm->m, 0) == NULL)
+		errx(1, "-x needs a build with -DSTATS");
+	if ((reportfile != NULL || foldfile != NULL) &&
+	    cpu->hits(cpm->m) == NULL)
+		errx(1, "-p and -g need a build with -DPROFILE");
+	if (tracefile != NULL && cpu->trace(cpm->m, NULL, NULL) == -1)
+		errx(1, "-T needs a build with -DTRACE");
+	if (reportfile != NULL || foldfile != NULL) {
+		/* Code outside any call goes by the program's name */
+		if (restorefile != NULL)
+			top = restorefile;
+		else
+			top = argc > 0 ? argv[0] : "boot";
+		if (strrchr(top, '/') != NULL)
+			top = strrchr(top, '/') + 1;
+		if ((prof = profnew(top)) == NULL)
+			err(1, NULL);
+		if (symfile != NULL && profsyms(prof, symfile) == -1)
+			exit(1);
+	}
+
+	if (statsfile != NULL) {
+		memset(&sa, 0, sizeof(sa));
+		sigemptyset(&sa.sa_mask);
+		sa.sa_handler = dump;
+		sa.sa_flags = SA_RESTART;
+		if (sigaction(SIGUSR1, &sa, NULL) == -1)
+			err(1, "sigaction");
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (manifest != NULL) {
+		failed = batch(manifest, threads, &ops);
+		if (stats)
+			report(cpm, &start);
+		if (statsfile != NULL && dumpstats(cpm, NULL) == -1)
+			return 1;
+		return failed > 0;
+	}
+
+	conbuf(cpm->con, bufsize);
+	atexit(cleanup);
+	if (restorefile != NULL) {
+		if ((incall = restore(cpm, restorefile, &dir)) == -1)
+			exit(1);
+	} else {
+		if (setup(cpm, argc > 0 ? argv[0] : NULL, dir, argc - 1,
+		    argv + 1) == -1)
+			exit(1);
+		incall = 0;
+	}
+	if (savefile != NULL)
+		catch(cpm->con);
+	if (tracefile != NULL) {
+		if ((ring = ringnew(tracefile, RINGSIZE)) == NULL)
+			err(1, "%s", tracefile);
+		cpu->trace(cpm->m, ringput, ring);
+	}
+	if (statsfile != NULL)
+		conwatch(cpm->con, &dumping, dumpnow, cpm);
+	if (run(cpm, incall) && save(cpm, savefile, dir) == -1)
+		exit(1);
+	if (ring != NULL && tracestop() == -1)
+		exit(1);
+	if (prof != NULL && profile(reportfile, foldfile) == -1)
+		exit(1);
+	if (statsfile != NULL && dumpstats(cpm, NULL) == -1)
+		exit(1);
+
+	if (stats)
+		report(cpm, &start);
+
+	return 0;
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2020 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * The CP/M front end, shared by i80 and z80 over a table of what their
+ * library does.  libi80 and libz80 number the registers cpmmain() uses,
+ * and why a run returned, alike.
+ */
+
+#define CPU_A		0
+#define CPU_B		2
+#define CPU_C		3
+#define CPU_E		5
+#define CPU_H		6
+#define CPU_L		7
+#define CPU_BC		8
+#define CPU_DE		9
+#define CPU_HL		10
+#define CPU_PC		12
+
+#define CPU_STOP	1
+#define CPU_BUDGET	2
+
+/* A CPU library, its machines passed as void * */
+struct cpu {
+	const char	 *name;		/* Of the program */
+	const char	 *magic;	/* Of its saved states */
+	const int	 *regs;		/* Kept in a saved state */
+	size_t		  nregs;
+	void		*(*new)(void);
+	void		 (*free)(void *);
+	void		 (*reset)(void *);
+	void		 (*copy)(void *, const void *);
+	unsigned char	*(*ram)(void *);
+	unsigned char	*(*ports)(void *);
+	void		 (*touch)(void *, unsigned int, unsigned int);
+	unsigned int	 (*get)(void *, int);
+	void		 (*set)(void *, int, unsigned int);
+	void		 (*io)(void *, void *);	/* Have out call cpmout() */
+	int		 (*run)(void *, long long);
+	int		 (*counters)(void *, unsigned long long *,
+			    unsigned long long *);
+	int		 (*jit)(void *, int);		/* NULL if none */
+	const unsigned long long *(*ops)(void *, int);
+	const unsigned long long *(*hits)(void *);
+	int		 (*calls)(void *, void (*)(const unsigned short *,
+			    int, unsigned long long, void *), void *);
+	int		 (*trace)(void *, void (*)(void *,
+			    const unsigned char *, size_t), void *);
+};
+
+int	cpmout(void *, int, int);
+int	cpmmain(const struct cpu *, int, char *[]);
@@ -0,0 +1,448 @@
+/*
+ * Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dis.h"
+
+/* Operands: # an 8-bit one, @ a 16-bit one */
+static const char *const ops8080[256] = {
+	"nop", "lxi b,@", "stax b", "inx b",	/* 0x00 */
+	"inr b", "dcr b", "mvi b,#", "rlc",
+	"nop", "dad b", "ldax b", "dcx b",
+	"inr c", "dcr c", "mvi c,#", "rrc",
+	"nop", "lxi d,@", "stax d", "inx d",	/* 0x10 */
+	"inr d", "dcr d", "mvi d,#", "ral",
+	"nop", "dad d", "ldax d", "dcx d",
+	"inr e", "dcr e", "mvi e,#", "rar",
+	"nop", "lxi h,@", "shld @", "inx h",	/* 0x20 */
+	"inr h", "dcr h", "mvi h,#", "daa",
+	"nop", "dad h", "lhld @", "dcx h",
+	"inr l", "dcr l", "mvi l,#", "cma",
+	"nop", "lxi sp,@", "sta @", "inx sp",	/* 0x30 */
+	"inr m", "dcr m", "mvi m,#", "stc",
+	"nop", "dad sp", "lda @", "dcx sp",
+	"inr a", "dcr a", "mvi a,#", "cmc",
+	"mov b,b", "mov b,c", "mov b,d", "mov b,e",	/* 0x40 */
+	"mov b,h", "mov b,l", "mov b,m", "mov b,a",
+	"mov c,b", "mov c,c", "mov c,d", "mov c,e",
+	"mov c,h", "mov c,l", "mov c,m", "mov c,a",
+	"mov d,b", "mov d,c", "mov d,d", "mov d,e",	/* 0x50 */
+	"mov d,h", "mov d,l", "mov d,m", "mov d,a",
+	"mov e,b", "mov e,c", "mov e,d", "mov e,e",
+	"mov e,h", "mov e,l", "mov e,m", "mov e,a",
+	"mov h,b", "mov h,c", "mov h,d", "mov h,e",	/* 0x60 */
+	"mov h,h", "mov h,l", "mov h,m", "mov h,a",
+	"mov l,b", "mov l,c", "mov l,d", "mov l,e",
+	"mov l,h", "mov l,l", "mov l,m", "mov l,a",
+	"mov m,b", "mov m,c", "mov m,d", "mov m,e",	/* 0x70 */
+	"mov m,h", "mov m,l", "hlt", "mov m,a",
+	"mov a,b", "mov a,c", "mov a,d", "mov a,e",
+	"mov a,h", "mov a,l", "mov a,m", "mov a,a",
+	"add b", "add c", "add d", "add e",	/* 0x80 */
+	"add h", "add l", "add m", "add a",
+	"adc b", "adc c", "adc d", "adc e",
+	"adc h", "adc l", "adc m", "adc a",
+	"sub b", "sub c", "sub d", "sub e",	/* 0x90 */
+	"sub h", "sub l", "sub m", "sub a",
+	"sbb b", "sbb c", "sbb d", "sbb e",
+	"sbb h", "sbb l", "sbb m", "sbb a",
+	"ana b", "ana c", "ana d", "ana e",	/* 0xa0 */
+	"ana h", "ana l", "ana m", "ana a",
+	"xra b", "xra c", "xra d", "xra e",
+	"xra h", "xra l", "xra m", "xra a",
+	"ora b", "ora c", "ora d", "ora e",	/* 0xb0 */
+	"ora h", "ora l", "ora m", "ora a",
+	"cmp b", "cmp c", "cmp d", "cmp e",
+	"cmp h", "cmp l", "cmp m", "cmp a",
+	"rnz", "pop b", "jnz @", "jmp @",	/* 0xc0 */
+	"cnz @", "push b", "adi #", "rst 0",
+	"rz", "ret", "jz @", "jmp @",
+	"cz @", "call @", "aci #", "rst 1",
+	"rnc", "pop d", "jnc @", "out #",	/* 0xd0 */
+	"cnc @", "push d", "sui #", "rst 2",
+	"rc", "ret", "jc @", "in #",
+	"cc @", "call @", "sbi #", "rst 3",
+	"rpo", "pop h", "jpo @", "xthl",	/* 0xe0 */
+	"cpo @", "push h", "ani #", "rst 4",
+	"rpe", "pchl", "jpe @", "xchg",
+	"cpe @", "call @", "xri #", "rst 5",
+	"rp", "pop psw", "jp @", "di",	/* 0xf0 */
+	"cp @", "push psw", "ori #", "rst 6",
+	"rm", "sphl", "jm @", "ei",
+	"cm @", "call @", "cpi #", "rst 7",
+};
+
+static const char *const r8[] = {
+	"b", "c", "d", "e", "h", "l", "(hl)", "a"
+};
+static const char *const rp[] = { "bc", "de", "hl", "sp" };
+static const char *const rp2[] = { "bc", "de", "hl", "af" };
+static const char *const cc[] = {
+	"nz", "z", "nc", "c", "po", "pe", "p", "m"
+};
+static const char *const alu[] = {
+	"add a,", "adc a,", "sub ", "sbc a,", "and ", "xor ", "or ", "cp "
+};
+static const char *const rot[] = {
+	"rlc", "rrc", "rl", "rr", "sla", "sra", "sll", "srl"
+};
+static const char *const misc[] = {
+	"rlca", "rrca", "rla", "rra", "daa", "cpl", "scf", "ccf"
+};
+static const char *const edmisc[] = {
+	"ld i,a", "ld r,a", "ld a,i", "ld a,r", "rrd", "rld", "nop", "nop"
+};
+static const char *const bitop[] = { "", "bit", "res", "set" };
+static const char *const block[4][4] = {
+	{ "ldi", "cpi", "ini", "outi" },
+	{ "ldd", "cpd", "ind", "outd" },
+	{ "ldir", "cpir", "inir", "otir" },
+	{ "lddr", "cpdr", "indr", "otdr" }
+};
+
+/* The opcodes outside 0x40-0xbf that 0xdd and 0xfd apply to */
+static const unsigned char xyops[] = {
+	0x09, 0x19, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x29, 0x2a, 0x2b,
+	0x2c, 0x2d, 0x2e, 0x34, 0x35, 0x36, 0x39, 0xcb, 0xe1, 0xe3, 0xe5,
+	0xe9, 0xf9
+};
+
+/*
+ * v in hex the way assemblers take it: with an h, and a 0 in front of
+ * a leading letter.
+ */
+static const char *
+hex(char *s, unsigned int v, int digits)
+{
+
+	snprintf(s, 8, "%0*xh", digits, v);
+	if (s[0] >= 'a') {
+		memmove(s + 1, s, strlen(s) + 1);
+		s[0] = '0';
+	}
+
+	return s;
+}
+
+/*
+ * The instruction at c, which was at pc, into buf.  Returns its length.
+ */
+int
+dis8080(const unsigned char *c, unsigned int pc, char *buf, size_t size)
+{
+	const char *p;
+	char s[8];
+	size_t n = 0;
+	int len = 1;
+
+	for (p = ops8080[c[0]]; *p != '\0' && n + 1 < size; p++) {
+		if (*p == '#')
+			n += snprintf(buf + n, size - n, "%s", hex(s, c[1], 2));
+		else if (*p == '@')
+			n += snprintf(buf + n, size - n, "%s",
+			    hex(s, c[1] | c[2] << 8, 4));
+		else {
+			buf[n++] = *p;
+			continue;
+		}
+		len += *p == '#' ? 1 : 2;
+		if (n >= size)
+			n = size - 1;
+	}
+	buf[n] = '\0';
+
+	return len;
+}
+
+/*
+ * The unprefixed instruction at c, or the one after xy standing for
+ * ix or iy: those that use hl take xy in its place, (xy+d) in place of
+ * (hl), and xyh and xyl for h and l where there is no (hl).  Returns
+ * the length from c.
+ */
+static int
+z80main(const unsigned char *c, const char *xy, unsigned int pc,
+    char *buf, size_t size)
+{
+	const char *hl = xy != NULL ? xy : "hl", *names[8];
+	char d[16], s[8], s2[8], xyh[4], xyl[4];
+	int o, op = c[0], x = op >> 6, y = (op >> 3) & 7, z = op & 7;
+	int p = y >> 1, q = y & 1, mem = 0;
+
+	if (x == 1)
+		mem = op != 0x76 && (y == 6 || z == 6);
+	else if (x == 2)
+		mem = z == 6;
+	else if (x == 0 && z >= 4 && z <= 6)
+		mem = y == 6;
+
+	memcpy(names, r8, sizeof(names));
+	o = 1;
+	if (xy != NULL && mem) {
+		snprintf(d, sizeof(d), "(%s%c%s)", xy,
+		    (int8_t) c[1] < 0 ? '-' : '+',
+		    hex(s, abs((int8_t) c[1]), 2));
+		names[6] = d;
+		o = 2;
+	} else if (xy != NULL) {
+		snprintf(xyh, sizeof(xyh), "%sh", xy);
+		snprintf(xyl, sizeof(xyl), "%sl", xy);
+		names[4] = xyh;
+		names[5] = xyl;
+	}
+	hex(s, c[o], 2);
+	hex(s2, c[o] | c[o + 1] << 8, 4);
+
+	switch (x) {
+	case 0:
+		switch (z) {
+		case 0:
+			if (y < 2) {
+				snprintf(buf, size, y == 0 ? "nop" :
+				    "ex af,af'");
+				return 1;
+			}
+			hex(s2, (pc + 2 + (int8_t) c[1]) & 0xffff, 4);
+			if (y < 4)
+				snprintf(buf, size, "%s %s",
+				    y == 2 ? "djnz" : "jr", s2);
+			else
+				snprintf(buf, size, "jr %s,%s", cc[y - 4], s2);
+			return 2;
+		case 1:
+			if (q == 0) {
+				snprintf(buf, size, "ld %s,%s",
+				    p == 2 ? hl : rp[p], s2);
+				return 3;
+			}
+			snprintf(buf, size, "add %s,%s", hl,
+			    p == 2 ? hl : rp[p]);
+			return 1;
+		case 2:
+			if (p < 2) {
+				snprintf(buf, size, q == 0 ? "ld (%s),a" :
+				    "ld a,(%s)", rp[p]);
+				return 1;
+			}
+			if (q == 0)
+				snprintf(buf, size, "ld (%s),%s", s2,
+				    p == 2 ? hl : "a");
+			else
+				snprintf(buf, size, "ld %s,(%s)",
+				    p == 2 ? hl : "a", s2);
+			return 3;
+		case 3:
+			snprintf(buf, size, "%s %s", q == 0 ? "inc" : "dec",
+			    p == 2 ? hl : rp[p]);
+			return 1;
+		case 4:
+		case 5:
+			snprintf(buf, size, "%s %s", z == 4 ? "inc" : "dec",
+			    names[y]);
+			return o;
+		case 6:
+			snprintf(buf, size, "ld %s,%s", names[y], s);
+			return o + 1;
+		default:
+			snprintf(buf, size, "%s", misc[y]);
+			return 1;
+		}
+	case 1:
+		if (op == 0x76)
+			snprintf(buf, size, "halt");
+		else
+			snprintf(buf, size, "ld %s,%s",
+			    y == 6 ? names[6] : mem ? r8[y] : names[y],
+			    z == 6 ? names[6] : mem ? r8[z] : names[z]);
+		return o;
+	case 2:
+		snprintf(buf, size, "%s%s", alu[y], names[z]);
+		return o;
+	}
+
+	switch (z) {
+	case 0:
+		snprintf(buf, size, "ret %s", cc[y]);
+		return 1;
+	case 1:
+		if (q == 0)
+			snprintf(buf, size, "pop %s", p == 2 ? hl : rp2[p]);
+		else if (p == 0)
+			snprintf(buf, size, "ret");
+		else if (p == 1)
+			snprintf(buf, size, "exx");
+		else if (p == 2)
+			snprintf(buf, size, "jp (%s)", hl);
+		else
+			snprintf(buf, size, "ld sp,%s", hl);
+		return 1;
+	case 2:
+		snprintf(buf, size, "jp %s,%s", cc[y], s2);
+		return 3;
+	case 3:
+		switch (y) {
+		case 0:
+			snprintf(buf, size, "jp %s", s2);
+			return 3;
+		case 2:
+		case 3:
+			snprintf(buf, size, y == 2 ? "out (%s),a" :
+			    "in a,(%s)", s);
+			return 2;
+		case 4:
+			snprintf(buf, size, "ex (sp),%s", hl);
+			return 1;
+		default:
+			snprintf(buf, size, "%s", y == 5 ? "ex de,hl" :
+			    y == 6 ? "di" : "ei");
+			return 1;
+		}
+	case 4:
+		snprintf(buf, size, "call %s,%s", cc[y], s2);
+		return 3;
+	case 5:
+		if (q == 0)
+			snprintf(buf, size, "push %s", p == 2 ? hl : rp2[p]);
+		else
+			snprintf(buf, size, "call %s", s2);
+		return q == 0 ? 1 : 3;
+	case 6:
+		snprintf(buf, size, "%s%s", alu[y], s);
+		return 2;
+	default:
+		snprintf(buf, size, "rst %s", hex(s, y * 8, 2));
+		return 1;
+	}
+}
+
+/*
+ * 0xcb op, or 0xdd 0xcb d op and 0xfd 0xcb d op with mem standing for
+ * (xy+d).  The indexed forms other than bit also copy the result to
+ * the register the opcode names.
+ */
+static void
+z80cb(int op, const char *mem, char *buf, size_t size)
+{
+	int x = op >> 6, y = (op >> 3) & 7, z = op & 7;
+	char r[24];
+
+	if (mem == NULL)
+		snprintf(r, sizeof(r), "%s", r8[z]);
+	else if (z == 6 || x == 1)
+		snprintf(r, sizeof(r), "%s", mem);
+	else
+		snprintf(r, sizeof(r), "%s,%s", mem, r8[z]);
+
+	if (x == 0)
+		snprintf(buf, size, "%s %s", rot[y], r);
+	else
+		snprintf(buf, size, "%s %d,%s", bitop[x], y, r);
+}
+
+static int
+z80ed(const unsigned char *c, char *buf, size_t size)
+{
+	int op = c[0], x = op >> 6, y = (op >> 3) & 7, z = op & 7;
+	int p = y >> 1, q = y & 1;
+	char s[8];
+
+	if (x == 2 && z <= 3 && y >= 4) {
+		snprintf(buf, size, "%s", block[y - 4][z]);
+		return 1;
+	}
+	if (x != 1) {
+		snprintf(buf, size, "db 0edh,%s", hex(s, op, 2));
+		return 1;
+	}
+
+	switch (z) {
+	case 0:
+		if (y == 6)
+			snprintf(buf, size, "in (c)");
+		else
+			snprintf(buf, size, "in %s,(c)", r8[y]);
+		break;
+	case 1:
+		snprintf(buf, size, "out (c),%s", y == 6 ? "0" : r8[y]);
+		break;
+	case 2:
+		snprintf(buf, size, "%s hl,%s", q == 0 ? "sbc" : "adc", rp[p]);
+		break;
+	case 3:
+		hex(s, c[1] | c[2] << 8, 4);
+		if (q == 0)
+			snprintf(buf, size, "ld (%s),%s", s, rp[p]);
+		else
+			snprintf(buf, size, "ld %s,(%s)", rp[p], s);
+		return 3;
+	case 4:
+		snprintf(buf, size, "neg");
+		break;
+	case 5:
+		snprintf(buf, size, y == 1 ? "reti" : "retn");
+		break;
+	case 6:
+		snprintf(buf, size, "im %d", (y & 3) < 2 ? 0 : (y & 3) - 1);
+		break;
+	default:
+		snprintf(buf, size, "%s", edmisc[y]);
+		break;
+	}
+
+	return 1;
+}
+
+/*
+ * As dis8080().  A 0xdd or 0xfd before an opcode that does not use hl
+ * comes out as an instruction of its own, as z80 runs it.
+ */
+int
+disz80(const unsigned char *c, unsigned int pc, char *buf, size_t size)
+{
+	const char *xy;
+	char d[16], s[8];
+	int op;
+
+	if (c[0] == 0xcb) {
+		z80cb(c[1], NULL, buf, size);
+		return 2;
+	}
+	if (c[0] == 0xed)
+		return 1 + z80ed(c + 1, buf, size);
+	if (c[0] != 0xdd && c[0] != 0xfd)
+		return z80main(c, NULL, pc, buf, size);
+
+	xy = c[0] == 0xdd ? "ix" : "iy";
+	op = c[1];
+	if ((op < 0x40 || op >= 0xc0 || op == 0x76) &&
+	    memchr(xyops, op, sizeof(xyops)) == NULL) {
+		snprintf(buf, size, "db %s", hex(s, c[0], 2));
+		return 1;
+	}
+	if (op == 0xcb) {
+		snprintf(d, sizeof(d), "(%s%c%s)", xy,
+		    (int8_t) c[2] < 0 ? '-' : '+',
+		    hex(s, abs((int8_t) c[2]), 2));
+		z80cb(c[3], d, buf, size);
+		return 4;
+	}
+	return 1 + z80main(c + 1, xy, pc, buf, size);
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Flag tables shared by the i80 and z80 cores.
+ * Each is indexed by an 8-bit result and laid out like the flag byte
+ * pushed by push psw:
+ *
+ *	S Z 0 AC 0 P 1 CY
+ *
+ * szp[] has S, Z, P and the always-set bit 1.
+ * inrflags[] and dcrflags[] add the AC value that inr and dcr leave
+ * for that result.
+ */
+
+#define FS	0x80
+#define FZ	0x40
+#define FAC	0x10
+#define FP	0x04
+#define FONE	0x02
+#define FCY	0x01
+
+static const uint8_t szp[256] = {
+	0x46, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02,
+	0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06,
+	0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06,
+	0x06, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02,
+	0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06,
+	0x06, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02,
+	0x06, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02,
+	0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06,
+	0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06,
+	0x06, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02,
+	0x06, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02,
+	0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06,
+	0x06, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02,
+	0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06,
+	0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06,
+	0x06, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02,
+	0x82, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86,
+	0x86, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82,
+	0x86, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82,
+	0x82, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86,
+	0x86, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82,
+	0x82, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86,
+	0x82, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86,
+	0x86, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82,
+	0x86, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82,
+	0x82, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86,
+	0x82, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86,
+	0x86, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82,
+	0x82, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86,
+	0x86, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82,
+	0x86, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82,
+	0x82, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86,
+};
+
+static const uint8_t inrflags[256] = {
+	0x56, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02,
+	0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06,
+	0x12, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06,
+	0x06, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02,
+	0x12, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06,
+	0x06, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02,
+	0x16, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02,
+	0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06,
+	0x12, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06,
+	0x06, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02,
+	0x16, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02,
+	0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06,
+	0x16, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02,
+	0x02, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06,
+	0x12, 0x06, 0x06, 0x02, 0x06, 0x02, 0x02, 0x06,
+	0x06, 0x02, 0x02, 0x06, 0x02, 0x06, 0x06, 0x02,
+	0x92, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86,
+	0x86, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82,
+	0x96, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82,
+	0x82, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86,
+	0x96, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82,
+	0x82, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86,
+	0x92, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86,
+	0x86, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82,
+	0x96, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82,
+	0x82, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86,
+	0x92, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86,
+	0x86, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82,
+	0x92, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86,
+	0x86, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82,
+	0x96, 0x82, 0x82, 0x86, 0x82, 0x86, 0x86, 0x82,
+	0x82, 0x86, 0x86, 0x82, 0x86, 0x82, 0x82, 0x86,
+};
+
+static const uint8_t dcrflags[256] = {
+	0x56, 0x12, 0x12, 0x16, 0x12, 0x16, 0x16, 0x12,
+	0x12, 0x16, 0x16, 0x12, 0x16, 0x12, 0x12, 0x06,
+	0x12, 0x16, 0x16, 0x12, 0x16, 0x12, 0x12, 0x16,
+	0x16, 0x12, 0x12, 0x16, 0x12, 0x16, 0x16, 0x02,
+	0x12, 0x16, 0x16, 0x12, 0x16, 0x12, 0x12, 0x16,
+	0x16, 0x12, 0x12, 0x16, 0x12, 0x16, 0x16, 0x02,
+	0x16, 0x12, 0x12, 0x16, 0x12, 0x16, 0x16, 0x12,
+	0x12, 0x16, 0x16, 0x12, 0x16, 0x12, 0x12, 0x06,
+	0x12, 0x16, 0x16, 0x12, 0x16, 0x12, 0x12, 0x16,
+	0x16, 0x12, 0x12, 0x16, 0x12, 0x16, 0x16, 0x02,
+	0x16, 0x12, 0x12, 0x16, 0x12, 0x16, 0x16, 0x12,
+	0x12, 0x16, 0x16, 0x12, 0x16, 0x12, 0x12, 0x06,
+	0x16, 0x12, 0x12, 0x16, 0x12, 0x16, 0x16, 0x12,
+	0x12, 0x16, 0x16, 0x12, 0x16, 0x12, 0x12, 0x06,
+	0x12, 0x16, 0x16, 0x12, 0x16, 0x12, 0x12, 0x16,
+	0x16, 0x12, 0x12, 0x16, 0x12, 0x16, 0x16, 0x02,
+	0x92, 0x96, 0x96, 0x92, 0x96, 0x92, 0x92, 0x96,
+	0x96, 0x92, 0x92, 0x96, 0x92, 0x96, 0x96, 0x82,
+	0x96, 0x92, 0x92, 0x96, 0x92, 0x96, 0x96, 0x92,
+	0x92, 0x96, 0x96, 0x92, 0x96, 0x92, 0x92, 0x86,
+	0x96, 0x92, 0x92, 0x96, 0x92, 0x96, 0x96, 0x92,
+	0x92, 0x96, 0x96, 0x92, 0x96, 0x92, 0x92, 0x86,
+	0x92, 0x96, 0x96, 0x92, 0x96, 0x92, 0x92, 0x96,
+	0x96, 0x92, 0x92, 0x96, 0x92, 0x96, 0x96, 0x82,
+	0x96, 0x92, 0x92, 0x96, 0x92, 0x96, 0x96, 0x92,
+	0x92, 0x96, 0x96, 0x92, 0x96, 0x92, 0x92, 0x86,
+	0x92, 0x96, 0x96, 0x92, 0x96, 0x92, 0x92, 0x96,
+	0x96, 0x92, 0x92, 0x96, 0x92, 0x96, 0x96, 0x82,
+	0x92, 0x96, 0x96, 0x92, 0x96, 0x92, 0x92, 0x96,
+	0x96, 0x92, 0x92, 0x96, 0x92, 0x96, 0x96, 0x82,
+	0x96, 0x92, 0x92, 0x96, 0x92, 0x96, 0x96, 0x92,
+	0x92, 0x96, 0x96, 0x92, 0x96, 0x92, 0x92, 0x86,
+};
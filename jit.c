@@ -0,0 +1,886 @@
+/*
+ * Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * x86-64 translator for the 8080 core.
+ *
+ * A basic block that the interpreter has run HOT times is translated
+ * into native code.  While translated code runs, the 8080 registers
+ * live in the host registers the 8086 inherited them as:
+ *
+ *	al	A		bx	HL		rdi	ram[]
+ *	ah	F		cx	BC		r12	jitcode[]
+ *	si	SP		dx	DE		r13	CPU structure
+ *						r14	jitmap[]
+ *
+ * lahf and sahf move the flags between ah and the host flags, which
+ * use the same bit positions as the 8080.  Only AC after subtraction
+ * differs: the 8080 sets it when there is no borrow out of bit 3.
+ *
+ * A block ends at the first jump, call or return, or before in, out,
+ * hlt and daa, which are left to the interpreter.  Every exit puts the
+ * next 8080 pc in r8d and looks it up in jitmap[]; a miss returns to C,
+ * as does running past the limit jitrun() was given, which r15 points
+ * to and r11 counts towards.
+ * Every store checks jitcode[] and, if it hit translated code, returns
+ * to C after the storing instruction so the blocks can be retired.
+ *
+ * The arena is never writable and executable at the same time.
+ */
+
+#include <stddef.h>
+
+#include "jit.h"
+
+unsigned short jitcode[0x10000];
+
+#if defined(__x86_64__) || defined(__amd64__)
+
+#include <sys/types.h>
+#include <sys/mman.h>
+
+#include <cpuid.h>
+#include <err.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+
+#define ARENASIZ	(4 * 1024 * 1024)
+#define NBLOCKS		16384
+#define BLOCKMAX	64	/* 8080 instructions per block */
+#define HOT		16	/* Interpreted runs before translating */
+
+/* Room for the largest block, stubs included */
+#define RESERVE		(BLOCKMAX * 128 + 512)
+
+#define SMC		0x10000	/* Exit reason: store hit translated code */
+
+/* Host byte registers */
+#define AL	0
+#define CL	1
+#define DL	2
+#define BL	3
+#define AH	4
+#define CH	5
+#define DH	6
+#define BH	7
+
+/* Host word registers */
+#define AX	0
+#define CX	1
+#define DX	2
+#define BX	3
+#define SI	6
+
+#define LAHF	0x9f
+#define SAHF	0x9e
+
+struct jblock {
+	unsigned int	start;
+	unsigned int	end;
+	int		live;
+};
+
+/* Store check that hit, patched once the stub is emitted */
+struct stub {
+	unsigned char	*patch;
+	int		 reg;
+	unsigned int	 addr;
+	unsigned int	 resume;
+	int		 n;
+	int		 cyc;
+};
+
+/* B, C, D, E, H, L, M, A */
+static const int r8[8] = { CH, CL, DH, DL, BH, BL, -1, AL };
+
+/* BC, DE, HL, SP */
+static const int r16[4] = { CX, DX, BX, SI };
+
+/* Jcc for NZ, Z, NC, C, PO, PE, P, M */
+static const unsigned char cctab[8] = {
+	0x85, 0x84, 0x83, 0x82, 0x8b, 0x8a, 0x89, 0x88
+};
+
+/* add, adc, sub, sbb, and, xor, or, cmp al, r/m8; +2 for al, imm8 */
+static const unsigned char aluop[8] = {
+	0x02, 0x12, 0x2a, 0x1a, 0x22, 0x32, 0x0a, 0x3a
+};
+
+static void *jitmap[0x10000];
+static unsigned char heat[0x10000];
+
+static struct jblock blocks[NBLOCKS];
+static int nblocks;
+
+static struct stub stubs[BLOCKMAX * 2 + 4];
+static int nstubs;
+
+static unsigned char *arena, *code;
+static size_t base, used;
+static unsigned char *dispatch, *leaveto;
+static int (*enter)(void *, unsigned long long *);
+
+static const unsigned char *mem;
+static struct jitcpu lay;
+static int verify;
+
+/* The block being translated */
+static unsigned int bstart;
+static unsigned char *bentry;
+static int bn, bcyc;
+
+static void
+emit(int n, ...)
+{
+	va_list ap;
+
+	va_start(ap, n);
+	while (n-- > 0)
+		*code++ = va_arg(ap, int);
+	va_end(ap);
+}
+
+static void
+emit32(uint32_t v)
+{
+
+	memcpy(code, &v, sizeof(v));
+	code += sizeof(v);
+}
+
+static void
+emit64(uint64_t v)
+{
+
+	memcpy(code, &v, sizeof(v));
+	code += sizeof(v);
+}
+
+static void
+rel32(const unsigned char *to)
+{
+
+	emit32(to - (code + 4));
+}
+
+static void
+land(unsigned char *patch)
+{
+	int32_t rel = code - (patch + 4);
+
+	memcpy(patch, &rel, sizeof(rel));
+}
+
+/* [rdi + idx] */
+static void
+ramop(int reg, int idx)
+{
+
+	emit(2, 0x04 | reg << 3, idx << 3 | 0x07);
+}
+
+/* [rdi + addr] */
+static void
+absop(int reg, unsigned int addr)
+{
+
+	emit(1, 0x87 | reg << 3);
+	emit32(addr);
+}
+
+static int
+length(int op)
+{
+
+	if ((op & 0xc7) == 0x06 || (op & 0xc7) == 0xc6 || op == 0xd3 ||
+	    op == 0xdb)
+		return 2;
+	if ((op & 0xcf) == 0x01 || (op & 0xe7) == 0x22 ||
+	    (op & 0xc7) == 0xc2 || (op & 0xc7) == 0xc4 || op == 0xc3 ||
+	    op == 0xcb || op == 0xcd || op == 0xdd || op == 0xed ||
+	    op == 0xfd)
+		return 3;
+
+	return 1;
+}
+
+/*
+ * Can the instruction at pc be translated?  Operands must not wrap
+ * past the top of memory and lhld and shld must not touch 0x10000.
+ */
+static int
+fits(unsigned int pc)
+{
+	int op = mem[pc];
+
+	if (op == 0x27 || op == 0x76 || op == 0xd3 || op == 0xdb)
+		return 0;
+	if (pc + length(op) > 0x10000)
+		return 0;
+	if ((op == 0x22 || op == 0x2a) &&
+	    (mem[pc + 1] | mem[pc + 2] << 8) == 0xffff)
+		return 0;
+
+	return 1;
+}
+
+/* Add n instructions and cyc T-states to the counters */
+static void
+count(int n, int cyc)
+{
+
+	emit(4, 0x49, 0x83, 0xc3, n);			/* add r11, n */
+	if (lay.instrs == -1)
+		return;
+	emit(5, 0x49, 0x83, 0x45, (int) lay.instrs, n);
+	emit(4, 0x49, 0x81, 0x45, (int) lay.cycles);
+	emit32(cyc);
+}
+
+/* Leave the block for the 8080 pc in target */
+static void
+leave(unsigned int target, int extra)
+{
+
+	count(bn, bcyc + extra);
+	if (target == bstart && !verify) {
+		emit(3, 0x4d, 0x3b, 0x1f);		/* cmp r11, [r15] */
+		emit(2, 0x0f, 0x82);			/* jb bentry */
+		rel32(bentry);
+	}
+	emit(2, 0x41, 0xb8);				/* mov r8d, target */
+	emit32(target);
+	emit(1, 0xe9);
+	rel32(dispatch);
+}
+
+/* Leave the block for the 8080 pc already in r8d */
+static void
+away(int extra)
+{
+
+	count(bn, bcyc + extra);
+	emit(1, 0xe9);
+	rel32(dispatch);
+}
+
+/*
+ * After a store to [reg], or to addr if reg is -1, leave through a
+ * stub if it hit translated code.  A wide store checks the next byte
+ * too.  The stub resumes at resume with extra T-states counted.
+ */
+static void
+check(int reg, unsigned int addr, int wide, unsigned int resume, int extra)
+{
+	struct stub *s;
+	int i;
+
+	for (i = 0; i <= wide; i++) {
+		if (reg == -1) {
+			/* cmp word [r12 + 2 * addr], 0 */
+			emit(5, 0x66, 0x41, 0x83, 0xbc, 0x24);
+			emit32((addr + i) * 2);
+			emit(1, 0x00);
+		} else if (i == 0) {
+			/* cmp word [r12 + 2 * reg], 0 */
+			emit(6, 0x66, 0x41, 0x83, 0x3c, 0x44 | reg << 3, 0x00);
+		} else {
+			/* lea r9d, [reg + 1]; movzx r9d, r9w */
+			emit(4, 0x44, 0x8d, 0x48 | reg, 0x01);
+			emit(4, 0x45, 0x0f, 0xb7, 0xc9);
+			/* cmp word [r12 + 2 * r9], 0 */
+			emit(6, 0x66, 0x43, 0x83, 0x3c, 0x4c, 0x00);
+		}
+		emit(2, 0x0f, 0x85);
+		s = &stubs[nstubs++];
+		s->patch = code;
+		s->reg = reg;
+		s->addr = addr;
+		s->resume = resume;
+		s->n = bn;
+		s->cyc = bcyc + extra;
+		emit32(0);
+	}
+}
+
+static void
+stub(const struct stub *s)
+{
+
+	land(s->patch);
+	if (s->reg == -1) {
+		emit(2, 0x41, 0xba);			/* mov r10d, imm */
+		emit32(SMC | s->addr);
+	} else {
+		emit(4, 0x44, 0x0f, 0xb7, 0xd0 | s->reg);	/* movzx r10d */
+		emit(3, 0x41, 0x81, 0xca);		/* or r10d, SMC */
+		emit32(SMC);
+	}
+	count(s->n, s->cyc);
+	emit(2, 0x41, 0xb8);
+	emit32(s->resume);
+	emit(1, 0xe9);
+	rel32(leaveto);
+}
+
+/* Branch if condition cc holds; returns the rel32 to patch */
+static unsigned char *
+branch(int cc)
+{
+	unsigned char *patch;
+
+	emit(3, SAHF, 0x0f, cctab[cc]);
+	patch = code;
+	emit32(0);
+
+	return patch;
+}
+
+static void
+pushw(unsigned int val, unsigned int resume, int extra)
+{
+
+	emit(3, 0x66, 0xff, 0xce);			/* dec si */
+	emit(4, 0xc6, 0x04, 0x37, val >> 8);
+	emit(3, 0x66, 0xff, 0xce);
+	emit(4, 0xc6, 0x04, 0x37, val & 0xff);
+	check(SI, 0, 1, resume, extra);
+}
+
+/* Pop a word into r8d */
+static void
+popw(void)
+{
+
+	emit(5, 0x44, 0x0f, 0xb6, 0x04, 0x37);		/* movzx r8d */
+	emit(3, 0x66, 0xff, 0xc6);			/* inc si */
+	emit(5, 0x44, 0x0f, 0xb6, 0x0c, 0x37);		/* movzx r9d */
+	emit(3, 0x66, 0xff, 0xc6);
+	emit(4, 0x41, 0xc1, 0xe1, 0x08);		/* shl r9d, 8 */
+	emit(3, 0x45, 0x09, 0xc8);			/* or r8d, r9d */
+}
+
+static void
+alu(int k, int s, int imm)
+{
+
+	if (k == 1 || k == 3)
+		emit(1, SAHF);
+	if (s == -1)
+		emit(2, aluop[k] + 2, imm);
+	else if (s == 6) {
+		emit(1, aluop[k]);
+		ramop(AL, BX);
+	} else
+		emit(2, aluop[k], 0xc0 | r8[s]);
+	emit(1, LAHF);
+
+	if (k == 2 || k == 3 || k == 7)
+		emit(3, 0x80, 0xf4, 0x10);		/* xor ah, FAC */
+	else if (k >= 4)
+		emit(3, 0x80, 0xe4, 0xef);		/* and ah, ~FAC */
+}
+
+/*
+ * Translate the instruction op at pc.  Returns non-zero if it ends
+ * the block.
+ */
+static int
+insn(int op, unsigned int pc, unsigned int next)
+{
+	unsigned char *patch;
+	unsigned int imm;
+	int d, s, rp, hi, lo;
+
+	imm = mem[(pc + 1) & 0xffff] | mem[(pc + 2) & 0xffff] << 8;
+	d = (op >> 3) & 0x7;
+	s = op & 0x7;
+	rp = (op >> 4) & 0x3;
+
+	if (op >= 0x40 && op < 0x80) {
+		if (d == 6) {
+			emit(1, 0x88);
+			ramop(r8[s], BX);
+			check(BX, 0, 0, next, 0);
+		} else if (s == 6) {
+			emit(1, 0x8a);
+			ramop(r8[d], BX);
+		} else if (d != s)
+			emit(2, 0x8a, 0xc0 | r8[d] << 3 | r8[s]);
+		return 0;
+	}
+
+	if (op >= 0x80 && op < 0xc0) {
+		alu(d, s, 0);
+		return 0;
+	}
+
+	switch (op & 0xc7) {
+	case 0x00:	/* nop */
+		return 0;
+	case 0x04:	/* inr */
+		emit(1, SAHF);
+		if (d == 6)
+			emit(3, 0xfe, 0x04, 0x1f);
+		else
+			emit(2, 0xfe, 0xc0 | r8[d]);
+		emit(1, LAHF);
+		if (d == 6)
+			check(BX, 0, 0, next, 0);
+		return 0;
+	case 0x05:	/* dcr */
+		emit(1, SAHF);
+		if (d == 6)
+			emit(3, 0xfe, 0x0c, 0x1f);
+		else
+			emit(2, 0xfe, 0xc8 | r8[d]);
+		emit(4, LAHF, 0x80, 0xf4, 0x10);
+		if (d == 6)
+			check(BX, 0, 0, next, 0);
+		return 0;
+	case 0x06:	/* mvi */
+		if (d == 6) {
+			emit(4, 0xc6, 0x04, 0x1f, imm & 0xff);
+			check(BX, 0, 0, next, 0);
+		} else
+			emit(2, 0xb0 | r8[d], imm & 0xff);
+		return 0;
+	case 0xc0:	/* rcc */
+		patch = branch(d ^ 1);
+		popw();
+		away(6);
+		land(patch);
+		leave(next, 0);
+		return 1;
+	case 0xc2:	/* jcc */
+		patch = branch(d);
+		leave(next, 0);
+		land(patch);
+		leave(imm, 0);
+		return 1;
+	case 0xc4:	/* ccc */
+		patch = branch(d ^ 1);
+		pushw(next, imm, 6);
+		leave(imm, 6);
+		land(patch);
+		leave(next, 0);
+		return 1;
+	case 0xc6:	/* alu i8 */
+		alu(d, -1, imm & 0xff);
+		return 0;
+	case 0xc7:	/* rst */
+		pushw(next, op & 0x38, 0);
+		leave(op & 0x38, 0);
+		return 1;
+	}
+
+	switch (op & 0xcf) {
+	case 0x01:	/* lxi */
+		emit(4, 0x66, 0xb8 | r16[rp], imm & 0xff, imm >> 8);
+		return 0;
+	case 0x03:	/* inx */
+		emit(3, 0x66, 0xff, 0xc0 | r16[rp]);
+		return 0;
+	case 0x09:	/* dad */
+		emit(3, 0x80, 0xe4, 0xfe);		/* and ah, ~FCY */
+		emit(3, 0x66, 0x01, 0xc0 | r16[rp] << 3 | BX);
+		emit(3, 0x80, 0xd4, 0x00);		/* adc ah, 0 */
+		return 0;
+	case 0x0b:	/* dcx */
+		emit(3, 0x66, 0xff, 0xc8 | r16[rp]);
+		return 0;
+	case 0xc1:	/* pop */
+		hi = rp == 3 ? AL : r8[rp * 2];
+		lo = rp == 3 ? AH : r8[rp * 2 + 1];
+		emit(1, 0x8a);
+		ramop(lo, SI);
+		emit(4, 0x66, 0xff, 0xc6, 0x8a);
+		ramop(hi, SI);
+		emit(3, 0x66, 0xff, 0xc6);
+		if (rp == 3) {
+			emit(3, 0x80, 0xe4, 0xd5);	/* and ah, valid */
+			emit(3, 0x80, 0xcc, 0x02);	/* or ah, FONE */
+		}
+		return 0;
+	case 0xc5:	/* push */
+		hi = rp == 3 ? AL : r8[rp * 2];
+		lo = rp == 3 ? AH : r8[rp * 2 + 1];
+		emit(4, 0x66, 0xff, 0xce, 0x88);
+		ramop(hi, SI);
+		emit(4, 0x66, 0xff, 0xce, 0x88);
+		ramop(lo, SI);
+		check(SI, 0, 1, next, 0);
+		return 0;
+	}
+
+	switch (op) {
+	case 0x02:	/* stax */
+	case 0x12:
+		emit(1, 0x88);
+		ramop(AL, r16[rp]);
+		check(r16[rp], 0, 0, next, 0);
+		break;
+	case 0x07:	/* rlc */
+		emit(4, SAHF, 0xd0, 0xc0, LAHF);
+		break;
+	case 0x0a:	/* ldax */
+	case 0x1a:
+		emit(1, 0x8a);
+		ramop(AL, r16[rp]);
+		break;
+	case 0x0f:	/* rrc */
+		emit(4, SAHF, 0xd0, 0xc8, LAHF);
+		break;
+	case 0x17:	/* ral */
+		emit(4, SAHF, 0xd0, 0xd0, LAHF);
+		break;
+	case 0x1f:	/* rar */
+		emit(4, SAHF, 0xd0, 0xd8, LAHF);
+		break;
+	case 0x22:	/* shld */
+		emit(2, 0x66, 0x89);
+		absop(BX, imm);
+		check(-1, imm, 1, next, 0);
+		break;
+	case 0x2a:	/* lhld */
+		emit(2, 0x66, 0x8b);
+		absop(BX, imm);
+		break;
+	case 0x2f:	/* cma */
+		emit(2, 0xf6, 0xd0);
+		break;
+	case 0x32:	/* sta */
+		emit(1, 0x88);
+		absop(AL, imm);
+		check(-1, imm, 0, next, 0);
+		break;
+	case 0x37:	/* stc */
+		emit(3, 0x80, 0xcc, 0x01);
+		break;
+	case 0x3a:	/* lda */
+		emit(1, 0x8a);
+		absop(AL, imm);
+		break;
+	case 0x3f:	/* cmc */
+		emit(3, 0x80, 0xf4, 0x01);
+		break;
+	case 0xc3:	/* jmp */
+	case 0xcb:
+		leave(imm, 0);
+		return 1;
+	case 0xc9:	/* ret */
+	case 0xd9:
+		popw();
+		away(0);
+		return 1;
+	case 0xcd:	/* call */
+	case 0xdd:
+	case 0xed:
+	case 0xfd:
+		pushw(next, imm, 0);
+		leave(imm, 0);
+		return 1;
+	case 0xe3:	/* xthl */
+		emit(3, 0x86, 0x1c, 0x37);		/* xchg bl, [rdi+rsi] */
+		emit(3, 0x66, 0xff, 0xc6);
+		emit(3, 0x86, 0x3c, 0x37);
+		emit(3, 0x66, 0xff, 0xce);
+		check(SI, 0, 1, next, 0);
+		break;
+	case 0xe9:	/* pchl */
+		emit(4, 0x44, 0x0f, 0xb7, 0xc3);	/* movzx r8d, bx */
+		away(0);
+		return 1;
+	case 0xeb:	/* xchg */
+		emit(3, 0x66, 0x87, 0xd3);
+		break;
+	case 0xf3:	/* di */
+	case 0xfb:	/* ei */
+		emit(5, 0x41, 0xc6, 0x45, (int) lay.inte, op == 0xfb);
+		break;
+	case 0xf9:	/* sphl */
+		emit(3, 0x66, 0x89, 0xde);
+		break;
+	}
+
+	return 0;
+}
+
+static void
+flush(void)
+{
+
+	memset(jitmap, 0, sizeof(jitmap));
+	memset(jitcode, 0, sizeof(jitcode));
+	nblocks = 0;
+	used = base;
+}
+
+static int
+translate(unsigned int start)
+{
+	struct jblock *b;
+	unsigned int pc, next;
+	int i, ends;
+
+	if (!fits(start))
+		return 0;
+	if (nblocks == NBLOCKS || used + RESERVE > ARENASIZ)
+		flush();
+
+	if (mprotect(arena, ARENASIZ, PROT_READ | PROT_WRITE) == -1)
+		err(1, "mprotect");
+
+	bentry = code = arena + used;
+	bstart = start;
+	bn = bcyc = 0;
+	nstubs = 0;
+	emit(4, 0xf3, 0x0f, 0x1e, 0xfa);		/* endbr64 */
+
+	for (pc = start, ends = 0; !ends && bn < BLOCKMAX && fits(pc);
+	    pc = next) {
+		next = pc + length(mem[pc]);
+		bn++;
+		if (lay.cyctab != NULL)
+			bcyc += lay.cyctab[mem[pc]];
+		ends = insn(mem[pc], pc, next);
+	}
+	if (!ends)
+		leave(pc, 0);
+	for (i = 0; i < nstubs; i++)
+		stub(&stubs[i]);
+
+	if (mprotect(arena, ARENASIZ, PROT_READ | PROT_EXEC) == -1)
+		err(1, "mprotect");
+
+	b = &blocks[nblocks++];
+	b->start = start;
+	b->end = pc;
+	b->live = 1;
+	for (; start < pc; start++)
+		jitcode[start]++;
+	jitmap[b->start] = bentry;
+	used = (code - arena + 15) & ~15;
+
+	return 1;
+}
+
+/* Load the 8080 registers and pc from the CPU structure, or store them */
+static void
+frame(int store)
+{
+	static const int reg[] = { AX, BX, CX, DX, SI };
+	size_t off[] = { lay.af, lay.hl, lay.bc, lay.de, lay.sp };
+	size_t i;
+
+	for (i = 0; i < sizeof(reg) / sizeof(reg[0]); i++) {
+		if (store)
+			emit(5, 0x66, 0x41, 0x89, 0x45 | reg[i] << 3,
+			    (int) off[i]);
+		else
+			emit(5, 0x41, 0x0f, 0xb7, 0x45 | reg[i] << 3,
+			    (int) off[i]);
+	}
+	if (store)
+		emit(5, 0x66, 0x45, 0x89, 0x45, (int) lay.pc);
+	else
+		emit(5, 0x45, 0x0f, 0xb7, 0x45, (int) lay.pc);
+}
+
+/*
+ * Emit the code that loads the 8080 registers, looks up the block for
+ * the 8080 pc and, on a miss or when a block asks for it, stores the
+ * registers back and returns to C.
+ */
+static void
+trampoline(void)
+{
+	unsigned char *miss;
+
+	code = arena;
+	enter = (int (*)(void *, unsigned long long *)) (void *) code;
+	emit(4, 0xf3, 0x0f, 0x1e, 0xfa);		/* endbr64 */
+	emit(10, 0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57);
+	emit(6, 0x49, 0x89, 0xfd, 0x49, 0x89, 0xf7);	/* r13, r15 = args */
+	emit(2, 0x48, 0xbf);
+	emit64((uintptr_t) mem);
+	emit(2, 0x49, 0xbc);
+	emit64((uintptr_t) jitcode);
+	emit(2, 0x49, 0xbe);
+	emit64((uintptr_t) jitmap);
+	emit(3, 0x45, 0x31, 0xdb);			/* xor r11d, r11d */
+	frame(0);
+
+	dispatch = code;
+	emit(3, 0x4d, 0x3b, 0x1f);			/* cmp r11, [r15] */
+	emit(2, 0x73, 0x0c);				/* jae miss */
+	emit(4, 0x4f, 0x8b, 0x0c, 0xc6);		/* mov r9, [r14+r8*8] */
+	emit(3, 0x4d, 0x85, 0xc9);			/* test r9, r9 */
+	emit(2, 0x74, 0x03);				/* jz miss */
+	emit(3, 0x41, 0xff, 0xe1);			/* jmp r9 */
+
+	miss = code;
+	emit(3, 0x45, 0x31, 0xd2);			/* xor r10d, r10d */
+
+	leaveto = code;
+	frame(1);
+	emit(3, 0x4d, 0x89, 0x1f);			/* mov [r15], r11 */
+	emit(3, 0x44, 0x89, 0xd0);			/* mov eax, r10d */
+	emit(11, 0x41, 0x5f, 0x41, 0x5e, 0x41, 0x5d, 0x41, 0x5c, 0x5d, 0x5b,
+	    0xc3);
+
+	/* Checking runs one block at a time */
+	if (verify)
+		dispatch = miss;
+
+	base = used = (code - arena + 15) & ~15;
+}
+
+/*
+ * Set up the translator for the 64K memory image ram and the CPU
+ * structure described by cpu.  If check is set, jitrun() returns
+ * after every block.  Returns -1 if the host cannot run translations.
+ */
+int
+jitinit(unsigned char *ram, const struct jitcpu *cpu, int check)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	/* lahf and sahf are optional in long mode */
+	if (!__get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx) || !(ecx & 1))
+		return -1;
+
+	mem = ram;
+	lay = *cpu;
+	verify = check;
+
+	arena = mmap(NULL, ARENASIZ, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANON, -1, 0);
+	if (arena == MAP_FAILED)
+		err(1, "mmap");
+	trampoline();
+	if (mprotect(arena, ARENASIZ, PROT_READ | PROT_EXEC) == -1)
+		err(1, "mprotect");
+
+	return 0;
+}
+
+/*
+ * Forget every block and unmap the arena, so that nothing is left
+ * pointing at the memory given to jitinit(), which may be called again.
+ */
+void
+jitfini(void)
+{
+
+	if (arena == NULL)
+		return;
+	flush();
+	memset(heat, 0, sizeof(heat));
+	if (munmap(arena, ARENASIZ) == -1)
+		err(1, "munmap");
+	arena = code = NULL;
+	mem = NULL;
+}
+
+/*
+ * Retire every block covering addr.  The interpreter gets the block
+ * start back until it is hot again, so code that patches itself in a
+ * loop is not retranslated on every pass.
+ */
+void
+jitinval(unsigned int addr)
+{
+	struct jblock *b;
+	unsigned int a;
+	int i;
+
+	addr &= 0xffff;
+	for (i = 0; i < nblocks; i++) {
+		b = &blocks[i];
+		if (!b->live || addr < b->start || addr >= b->end)
+			continue;
+		b->live = 0;
+		jitmap[b->start] = NULL;
+		heat[b->start] = 0;
+		for (a = b->start; a < b->end; a++)
+			jitcode[a]--;
+	}
+}
+
+/*
+ * Run translated code from the pc in cpu until the interpreter is
+ * needed or about limit instructions have run.  Returns the number of
+ * 8080 instructions run natively.
+ */
+unsigned long long
+jitrun(void *cpu, long long limit)
+{
+	unsigned long long n, total = 0;
+	uint16_t *pc = (uint16_t *) ((char *) cpu + lay.pc);
+	int r;
+
+	while ((long long) total < limit) {
+		if (jitmap[*pc] == NULL) {
+			if (heat[*pc] < HOT) {
+				heat[*pc]++;
+				break;
+			}
+			if (!translate(*pc))
+				break;
+		}
+		n = limit - total;
+		r = enter(cpu, &n);
+		total += n;
+		if (r & SMC) {
+			jitinval(r);
+			jitinval(r + 1);
+		}
+		if (verify)
+			break;
+	}
+
+	return total;
+}
+
+#else
+
+int
+jitinit(unsigned char *ram, const struct jitcpu *cpu, int check)
+{
+
+	return -1;
+}
+
+void
+jitfini(void)
+{
+}
+
+void
+jitinval(unsigned int addr)
+{
+}
+
+unsigned long long
+jitrun(void *cpu, long long limit)
+{
+
+	return 0;
+}
+
+#endif
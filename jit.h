@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Where the translator finds the 8080 state: byte offsets into the
+ * caller's CPU structure.  A and F form one word, A in the low byte.
+ * The counters are only updated if instrs is not -1.
+ */
+struct jitcpu {
+	size_t			 af;
+	size_t			 bc;
+	size_t			 de;
+	size_t			 hl;
+	size_t			 sp;
+	size_t			 pc;
+	size_t			 inte;
+	long			 instrs;
+	long			 cycles;
+	const unsigned char	*cyctab;
+};
+
+/* Number of translated blocks covering each byte of memory */
+extern unsigned short jitcode[0x10000];
+
+int			jitinit(unsigned char *, const struct jitcpu *, int);
+void			jitfini(void);
+void			jitinval(unsigned int);
+unsigned long long	jitrun(void *, long long);
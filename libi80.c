@@ -0,0 +1,2731 @@
+/*
+ * Copyright (c) 2020 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <err.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "flags.h"
+#include "jit.h"
+#include "libi80.h"
+#ifdef PROFILE
+#include "calls.h"
+#endif
+#ifdef TRACE
+#include "trace.h"
+#include "record.h"
+#endif
+
+typedef uint8_t		byte;
+typedef uint16_t	word;
+
+/*
+ * Register pairs overlay a word on their two byte halves, so 16-bit
+ * operations such as inx, dad and xchg work on the whole pair at once.
+ */
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define PAIR(hi, lo, pair)	\
+	union { struct { byte hi; byte lo; }; word pair; }
+#else
+#define PAIR(hi, lo, pair)	\
+	union { struct { byte lo; byte hi; }; word pair; }
+#endif
+
+/*
+ * With -DBLOCKS, execute() runs from a cache of decoded basic blocks
+ * on top of the threaded engine.  A block is decoded at its first
+ * execution: up to BLOCKMAX instructions, each with its handler, its
+ * operand and the address that follows it, ending after the first
+ * instruction that can transfer control.  Blocks live in a direct
+ * mapped table indexed by start address.
+ *
+ * codemap[] has a bit for every byte that belongs to a decoded block.
+ * A store that lands on one bumps the generation of its 256-byte page,
+ * which retires every block in that page, and ends the running block
+ * so the next instruction is decoded afresh.
+ */
+#ifdef BLOCKS
+#ifndef THREADED
+#define THREADED
+#endif
+
+#define BLOCKMAX	32
+#define NBLOCKS		4096
+
+struct insn {
+	const void *op;		/* Handler */
+	word imm;		/* Operand bytes */
+	word next;		/* Address of the following instruction */
+	byte opcode;
+};
+
+struct block {
+	word start;
+	byte len;		/* Instructions, 0 when unused */
+	byte first;		/* Pages of the first and last byte */
+	byte last;
+	uint32_t gen[2];	/* Their generations when decoded */
+	struct insn insn[BLOCKMAX];
+};
+#endif
+
+/*
+ * The whole machine: registers, memory, ports, the handlers the
+ * embedder gave i80io() and the caches built from the code.
+ */
+struct i80 {
+	byte a;
+	byte f;
+
+	PAIR(b, c, bc);
+	PAIR(d, e, de);
+	PAIR(h, l, hl);
+
+	word sp;
+	word pc;
+
+	byte inte;
+
+#ifdef CYCLES
+	uint64_t cycles;
+	uint64_t instrs;
+#endif
+
+#ifdef LAZYFLAGS
+	byte lres;
+	byte lazy;
+#endif
+
+#ifdef STATS
+	unsigned long long ops[256];	/* Instructions run by opcode */
+#endif
+
+	/* Everything above is state that i80copy() copies */
+	long long budget;	/* Instructions left to run */
+	int jit;		/* 1 translating, 2 also checking */
+
+	int (*in)(struct i80 *, int, void *);
+	int (*out)(struct i80 *, int, int, void *);
+	void *arg;
+
+	byte ram[0x10000];
+	byte inout[256];
+	byte idioms[0x10000];	/* What the loop closed by a jump is */
+
+	int port;
+
+#ifdef BLOCKS
+	struct block blocks[NBLOCKS];
+	uint32_t pagegen[256];
+	byte codemap[0x10000 / 8];
+#endif
+
+#ifdef PROFILE
+	struct calls calls;
+#endif
+
+#ifdef TRACE
+	struct record rec;
+#endif
+};
+
+#ifdef BLOCKS
+static const byte lentab[256] = {
+	1, 3, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1,	/* 0x00 */
+	1, 3, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1,	/* 0x10 */
+	1, 3, 3, 1, 1, 1, 2, 1, 1, 1, 3, 1, 1, 1, 2, 1,	/* 0x20 */
+	1, 3, 3, 1, 1, 1, 2, 1, 1, 1, 3, 1, 1, 1, 2, 1,	/* 0x30 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0x40 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0x50 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0x60 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0x70 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0x80 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0x90 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0xa0 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0xb0 */
+	1, 1, 3, 3, 3, 1, 2, 1, 1, 1, 3, 3, 3, 3, 2, 1,	/* 0xc0 */
+	1, 1, 3, 2, 3, 1, 2, 1, 1, 1, 3, 2, 3, 3, 2, 1,	/* 0xd0 */
+	1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 3, 2, 1,	/* 0xe0 */
+	1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 3, 2, 1,	/* 0xf0 */
+};
+
+/*
+ * Jumps, calls, returns, rst, pchl, hlt and I/O end a block.
+ */
+static int
+endsblock(byte op)
+{
+
+	switch (op) {
+	case 0x76:	/* hlt */
+	case 0xc3:	/* jmp */
+	case 0xcb:
+	case 0xc9:	/* ret */
+	case 0xd9:
+	case 0xcd:	/* call */
+	case 0xdd:
+	case 0xed:
+	case 0xfd:
+	case 0xd3:	/* out */
+	case 0xdb:	/* in */
+	case 0xe9:	/* pchl */
+		return 1;
+	}
+
+	/* Conditional returns, jumps and calls, and rst */
+	if (op >= 0xc0) {
+		switch (op & 7) {
+		case 0:
+		case 2:
+		case 4:
+		case 7:
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void
+invalidate(struct i80 *i80, byte page)
+{
+
+	i80->pagegen[page]++;
+	memset(&i80->codemap[page * (256 / 8)], 0, 256 / 8);
+}
+
+/*
+ * Return the block starting at pc, decoding it if it is not cached or
+ * its code has been written to since.
+ */
+static struct block *
+lookup(struct i80 *i80, word pc, const void *const *optab)
+{
+	struct block *b = &i80->blocks[pc & (NBLOCKS - 1)];
+	struct insn *in;
+	word addr;
+	byte op;
+	int i;
+
+	if (b->len != 0 && b->start == pc &&
+	    b->gen[0] == i80->pagegen[b->first] &&
+	    b->gen[1] == i80->pagegen[b->last])
+		return b;
+
+	b->start = pc;
+	b->first = pc >> 8;
+	for (i = 0; i < BLOCKMAX; ) {
+		op = i80->ram[pc];
+		in = &b->insn[i++];
+		in->op = optab[op];
+		in->opcode = op;
+		in->imm = i80->ram[(word) (pc + 1)] |
+		    i80->ram[(word) (pc + 2)] << 8;
+		for (addr = pc, pc += lentab[op]; addr != pc; addr++)
+			i80->codemap[addr >> 3] |= 1 << (addr & 7);
+		in->next = pc;
+		if (endsblock(op))
+			break;
+	}
+	b->len = i;
+	b->last = (word) (pc - 1) >> 8;
+	b->gen[0] = i80->pagegen[b->first];
+	b->gen[1] = i80->pagegen[b->last];
+
+	return b;
+}
+#endif
+
+/*
+ * Every store to memory goes through poke(), which tells the block
+ * cache when code has been overwritten.  Returns non-zero if so.
+ */
+static int
+poke(struct i80 *i80, word addr, byte val)
+{
+
+	i80->ram[addr] = val;
+#ifndef THREADED
+	if (i80->jit && jitcode[addr])
+		jitinval(addr);
+#endif
+#ifdef BLOCKS
+	if (i80->codemap[addr >> 3] & (1 << (addr & 7))) {
+		invalidate(i80, addr >> 8);
+		return 1;
+	}
+#endif
+
+	return 0;
+}
+
+#ifndef BLOCKS
+static word
+imm16(struct i80 *i80)
+{
+	word w;
+
+	w = i80->ram[i80->pc++];
+	w |= i80->ram[i80->pc++] << 8;
+
+	return w;
+}
+#endif
+
+static void
+ret(struct i80 *i80)
+{
+
+	i80->pc = i80->ram[i80->sp++];
+	i80->pc |= i80->ram[i80->sp++] << 8;
+#ifdef PROFILE
+	callsleave(&i80->calls, i80->sp);
+#endif
+}
+
+static void
+call(struct i80 *i80, word addr)
+{
+
+	poke(i80, --i80->sp, (i80->pc) >> 8);
+	poke(i80, --i80->sp, (i80->pc) & 0xff);
+	i80->pc = addr;
+#ifdef PROFILE
+	callsenter(&i80->calls, addr, i80->sp);
+#endif
+}
+
+/*
+ * With -DLAZYFLAGS, flags() only records the result and S, Z and P are
+ * derived from it when something reads them: the SIGN(), ZERO() and
+ * PARITY() accessors for conditional branches, and flagsync() before
+ * the flag bits are used or replaced as a whole.  AC and CY are always
+ * computed eagerly since they are cheaper to compute than to defer.
+ */
+#ifdef LAZYFLAGS
+#define SIGN(cpu)	((cpu)->lazy ? (cpu)->lres >> 7 : (cpu)->f >> 7)
+#define ZERO(cpu)	((cpu)->lazy ? (cpu)->lres == 0 : ((cpu)->f >> 6) & 0x1)
+#define PARITY(cpu)	\
+	((((cpu)->lazy ? szp[(cpu)->lres] : (cpu)->f) >> 2) & 0x1)
+#else
+#define SIGN(cpu)	((cpu)->f >> 7)
+#define ZERO(cpu)	(((cpu)->f >> 6) & 0x1)
+#define PARITY(cpu)	(((cpu)->f >> 2) & 0x1)
+#endif
+#define HALFCARRY(cpu)	(((cpu)->f >> 4) & 0x1)
+#define CARRY(cpu)	((cpu)->f & FCY)
+
+static void
+flagsync(struct i80 *i80)
+{
+
+#ifdef LAZYFLAGS
+	if (i80->lazy) {
+		i80->f = (i80->f & (FAC | FCY)) | szp[i80->lres];
+		i80->lazy = 0;
+	}
+#endif
+}
+
+static void
+flags(struct i80 *i80, byte reg)
+{
+
+#ifdef LAZYFLAGS
+	i80->lres = reg;
+	i80->lazy = 1;
+#else
+	i80->f = (i80->f & (FAC | FCY)) | szp[reg];
+#endif
+}
+
+/*
+ * Set AC and CY from an 8-bit addition of rega, regb and the carry in
+ * cin that produced sum.  Subtraction passes the complement of the
+ * subtrahend with a carry in of 1, or 1 - CY for sbb, since that is
+ * the addition the 8080 performs; AC is then set when no borrow comes
+ * out of the low nibble.
+ */
+static void
+carryflag(struct i80 *i80, byte rega, byte regb, word sum, int cin)
+{
+
+	i80->f &= ~(FAC | FCY);
+	i80->f |= ((rega & 0xf) + (regb & 0xf) + cin) & FAC;
+	i80->f |= (sum >> 8) & FCY;
+}
+
+static byte
+inr(struct i80 *i80, byte reg)
+{
+
+	reg++;
+	i80->f = (i80->f & FCY) | inrflags[reg];
+#ifdef LAZYFLAGS
+	i80->lazy = 0;
+#endif
+
+	return reg;
+}
+
+static byte
+dcr(struct i80 *i80, byte reg)
+{
+
+	reg--;
+	i80->f = (i80->f & FCY) | dcrflags[reg];
+#ifdef LAZYFLAGS
+	i80->lazy = 0;
+#endif
+
+	return reg;
+}
+
+static void
+daa(struct i80 *i80)
+{
+	word carry;
+
+	if ((((i80->a) & 0xf) > 9) || HALFCARRY(i80) == 1) {
+		if ((((i80->a) & 0xf) + 0x6) > 0xf)
+			i80->f |= FAC;
+		else
+			i80->f &= ~FAC;
+
+		i80->a += 0x6;
+	}
+
+	if ((((i80->a) >> 4) > 9) || CARRY(i80) == 1) {
+		carry = i80->a + 0x60;
+		if (carry > 0xff)
+			i80->f |= FCY;
+
+		i80->a += 0x60;
+	}
+
+	flags(i80, i80->a);
+}
+
+/*
+ * By default execute() runs one instruction through a switch and
+ * returns to i80run() after every opcode.  Building with -DTHREADED
+ * selects a direct-threaded engine instead: each handler fetches the
+ * next opcode and jumps through optab[] to its handler, so execute()
+ * only returns on hlt, out or when the budget of instructions is
+ * spent.  The budget is kept in a local and stored back by LEAVE().
+ * Each instruction is charged as it starts, the first one included, so
+ * the budget holds the instructions left after the one running, as it
+ * does for the switch engine.  The block cache charges a whole block at
+ * a time.
+ * This needs the GCC/Clang computed goto extension.
+ *
+ * Handlers read their operands with IMM8 and IMM16 and write memory
+ * with STORE(), so the block cache can supply the former and watch
+ * the latter.
+ */
+/*
+ * With -DCYCLES, COUNT() bumps cpu->instrs and adds the 8080 T-state
+ * count of the opcode from cyctab[] to cpu->cycles.  Conditional calls
+ * and returns are listed at their not-taken cost; TICK() adds the
+ * difference when taken.  Undocumented opcodes cost the same as the
+ * instruction they alias.
+ * With -DSTATS, it also counts the opcode in cpu->ops[].
+ */
+#ifdef STATS
+#define OPS(op)		(i80->ops[op]++)
+#else
+#define OPS(op)		((void) 0)
+#endif
+
+#ifdef CYCLES
+static const byte cyctab[256] = {
+	 4, 10,  7,  5,  5,  5,  7,  4,	/* 0x00 */
+	 4, 10,  7,  5,  5,  5,  7,  4,
+	 4, 10,  7,  5,  5,  5,  7,  4,	/* 0x10 */
+	 4, 10,  7,  5,  5,  5,  7,  4,
+	 4, 10, 16,  5,  5,  5,  7,  4,	/* 0x20 */
+	 4, 10, 16,  5,  5,  5,  7,  4,
+	 4, 10, 13,  5, 10, 10, 10,  4,	/* 0x30 */
+	 4, 10, 13,  5,  5,  5,  7,  4,
+	 5,  5,  5,  5,  5,  5,  7,  5,	/* 0x40 */
+	 5,  5,  5,  5,  5,  5,  7,  5,
+	 5,  5,  5,  5,  5,  5,  7,  5,	/* 0x50 */
+	 5,  5,  5,  5,  5,  5,  7,  5,
+	 5,  5,  5,  5,  5,  5,  7,  5,	/* 0x60 */
+	 5,  5,  5,  5,  5,  5,  7,  5,
+	 7,  7,  7,  7,  7,  7,  7,  7,	/* 0x70 */
+	 5,  5,  5,  5,  5,  5,  7,  5,
+	 4,  4,  4,  4,  4,  4,  7,  4,	/* 0x80 */
+	 4,  4,  4,  4,  4,  4,  7,  4,
+	 4,  4,  4,  4,  4,  4,  7,  4,	/* 0x90 */
+	 4,  4,  4,  4,  4,  4,  7,  4,
+	 4,  4,  4,  4,  4,  4,  7,  4,	/* 0xa0 */
+	 4,  4,  4,  4,  4,  4,  7,  4,
+	 4,  4,  4,  4,  4,  4,  7,  4,	/* 0xb0 */
+	 4,  4,  4,  4,  4,  4,  7,  4,
+	 5, 10, 10, 10, 11, 11,  7, 11,	/* 0xc0 */
+	 5, 10, 10, 10, 11, 17,  7, 11,
+	 5, 10, 10, 10, 11, 11,  7, 11,	/* 0xd0 */
+	 5, 10, 10, 10, 11, 17,  7, 11,
+	 5, 10, 10, 18, 11, 11,  7, 11,	/* 0xe0 */
+	 5,  5, 10,  4, 11, 17,  7, 11,
+	 5, 10, 10,  4, 11, 11,  7, 11,	/* 0xf0 */
+	 5,  5, 10,  4, 11, 17,  7, 11,
+};
+
+#define TICK(n)		(i80->cycles += (n))
+#define COUNT(op)	(i80->instrs++, TICK(cyctab[op]), OPS(op))
+#else
+#define TICK(n)
+#define COUNT(op)	OPS(op)
+#endif
+
+/*
+ * AT() is given the address of every instruction as it starts.  With
+ * -DPROFILE, HIT() counts the instruction there and in the call it ran
+ * in.  With -DTRACE, RECORD() adds it to the trace while one is being
+ * made.
+ */
+#ifdef PROFILE
+#define HIT(addr)	callshit(&i80->calls, (addr), 1)
+#else
+#define HIT(addr)	((void) 0)
+#endif
+
+#ifdef TRACE
+static void
+traceregs(struct i80 *i80, uint16_t *regs)
+{
+
+	flagsync(i80);
+	regs[TRACE_A] = i80->a;
+	regs[TRACE_F] = i80->f;
+	regs[TRACE_BC] = i80->bc;
+	regs[TRACE_DE] = i80->de;
+	regs[TRACE_HL] = i80->hl;
+	regs[TRACE_SP] = i80->sp;
+}
+
+static void
+record(struct i80 *i80, word addr)
+{
+	uint16_t regs[TRACE_NREGS];
+
+	traceregs(i80, regs);
+	recordinsn(&i80->rec, addr, i80->ram, regs);
+}
+
+#define RECORD(addr)	(i80->rec.fn != NULL ? record(i80, (addr)) : (void) 0)
+#else
+#define RECORD(addr)	((void) 0)
+#endif
+
+#define AT(addr)	(HIT(addr), RECORD(addr))
+
+#ifdef BLOCKS
+#define OP(n)	op_##n
+#define NEXT	\
+	do {								\
+		if (++ip == ipend)					\
+			goto blockend;					\
+		i80->pc = ip->next;					\
+		COUNT(ip->opcode);					\
+		AT(i80->pc - lentab[ip->opcode]);			\
+		goto *ip->op;						\
+	} while (0)
+#define IMM8	((byte) ip->imm)
+#define IMM16	(ip->imm)
+#define STORE(addr, val)	\
+	do {								\
+		if (poke(i80, (addr), (val)))				\
+			ipend = ip + 1;					\
+	} while (0)
+#elif defined(THREADED)
+#define OP(n)	op_##n
+#define NEXT	\
+	do {								\
+		if (budget <= 0)					\
+			LEAVE(1);					\
+		budget--;						\
+		opcode = i80->ram[i80->pc++];				\
+		COUNT(opcode);						\
+		AT(i80->pc - 1);					\
+		goto *optab[opcode];					\
+	} while (0)
+#else
+#define OP(n)	case n
+#define NEXT	break
+#endif
+
+#ifdef THREADED
+#define LEAVE(v)	\
+	do {								\
+		i80->budget = budget;					\
+		return (v);						\
+	} while (0)
+#define BUDGET		budget
+#else
+#define LEAVE(v)	return (v)
+#define BUDGET		(i80->budget)
+#endif
+
+#ifndef BLOCKS
+#define IMM8	i80->ram[i80->pc++]
+#define IMM16	imm16(i80)
+#define STORE(addr, val)	poke(i80, (addr), (val))
+#endif
+
+/*
+ * Loop idioms.  The 8080 has no block instructions, so programs copy,
+ * fill and compare memory and find the ends of strings with short
+ * loops, the compilers' runtimes included:
+ *
+ *	loop:	mov a,m		ldax d		mov m,e		mov a,m
+ *		stax d		cmp m		inx h		ora a
+ *		inx h		jnz differ	dcr c		jz done
+ *		inx d		inx h		jnz loop	inx h
+ *		dcx b		inx d				jmp loop
+ *		mov a,b		dcx b
+ *		ora c		mov a,b
+ *		jnz loop	ora c
+ *				jnz loop
+ *
+ * and their variations: any pair as a pointer or the count, pointers
+ * going down, dcr of a free register as the count, mvi m or a free
+ * register as the fill, a count kept while scanning.  When a jnz or
+ * jmp jumps back, idiom() checks whether the loop it closes is one of
+ * these, and if so runs all of its passes but the last at once.  The
+ * interpreter runs the last, which leaves a and the flags as they
+ * would have been.
+ *
+ * idioms[] remembers by the address of the jump which loops are not
+ * idioms, so an ordinary loop pays one byte compare per pass.  Loops
+ * that are idioms are matched again every time, which also catches
+ * code written over since.
+ */
+#define NOTIDIOM	1
+#define IDIOM		2
+
+struct idiom {
+	int kind;		/* One of the following */
+#define COPY		0
+#define FILL		1
+#define CMP		2
+#define SCAN		3
+	word *src;		/* The pointer read, for COPY and CMP */
+	word *dst;		/* The pointer written or compared with */
+	int ds;			/* Their steps, 1 or -1 */
+	int dd;
+	word *count16;		/* The pair counted with dcx */
+	byte *count8;		/* Or the register counted with dcr */
+	word *tally;		/* Counted up while scanning, if any */
+	const byte *fill;	/* The fill value */
+	int insns;		/* Instructions in a pass */
+	int cycles;		/* and their T-states */
+};
+
+static void
+pass(struct idiom *id, byte op)
+{
+
+	id->insns++;
+#ifdef CYCLES
+	id->cycles += cyctab[op];
+#else
+	(void) op;
+#endif
+}
+
+/*
+ * Register pairs and registers by their numbers in opcodes: bc, de
+ * and hl; b, c, d, e, h, l and, as 7, a.
+ */
+static word *
+pairof(struct i80 *i80, int rp)
+{
+
+	return rp == 0 ? &i80->bc : rp == 1 ? &i80->de : &i80->hl;
+}
+
+static byte *
+regof(struct i80 *i80, int r)
+{
+
+	switch (r) {
+	case 0:
+		return &i80->b;
+	case 1:
+		return &i80->c;
+	case 2:
+		return &i80->d;
+	case 3:
+		return &i80->e;
+	case 4:
+		return &i80->h;
+	case 5:
+		return &i80->l;
+	}
+
+	return &i80->a;
+}
+
+/*
+ * Match the count at the end of a copy, fill or compare loop at addr,
+ * ending at the jnz at jump: dcx of a pair and the test of both its
+ * halves, or dcr of a register.  Puts the pair or register number in
+ * *rp or *r, and -1 in the other.
+ */
+static int
+loopcount(struct i80 *i80, word addr, word jump, struct idiom *id,
+    int *rp, int *r)
+{
+	const byte *ram = i80->ram;
+	byte op = ram[addr], a1, a2;
+	int hi, lo;
+
+	*rp = *r = -1;
+	if ((op & 0xcf) == 0x0b && op != 0x3b) {	/* dcx rp */
+		*rp = op >> 4;
+		hi = *rp * 2;
+		lo = hi + 1;
+		a1 = ram[(word) (addr + 1)];
+		a2 = ram[(word) (addr + 2)];
+		if ((a1 != (0x78 | hi) || a2 != (0xb0 | lo)) &&
+		    (a1 != (0x78 | lo) || a2 != (0xb0 | hi)))
+			return 0;
+		pass(id, op);
+		pass(id, a1);
+		pass(id, a2);
+		id->count16 = pairof(i80, *rp);
+		addr += 3;
+	} else if ((op & 0xc7) == 0x05 && op < 0x30) {	/* dcr r */
+		*r = op >> 3;
+		pass(id, op);
+		id->count8 = regof(i80, *r);
+		addr++;
+	} else
+		return 0;
+	pass(id, 0xc2);
+
+	return addr == jump;
+}
+
+/*
+ * Whether the loop from top to the jump back at jump is an idiom, and
+ * which, in id.
+ */
+static int
+matchloop(struct i80 *i80, word top, word jump, struct idiom *id)
+{
+	const byte *ram = i80->ram;
+	word addr = top;
+	byte op;
+	int load = -1, store = -1, fill = -1, dir[3] = { 0, 0, 0 };
+	int rp, r, used, p;
+
+	memset(id, 0, sizeof(*id));
+
+	if (ram[jump] == 0xc3) {
+		/* mov a,m; ora a, ana a or cpi 0; jz; inx h; jmp */
+		id->kind = SCAN;
+		if (ram[addr] != 0x7e)
+			return 0;
+		pass(id, ram[addr++]);
+		op = ram[addr];
+		if (op == 0xfe && ram[(word) (addr + 1)] == 0)
+			addr += 2;
+		else if (op == 0xb7 || op == 0xa7)
+			addr++;
+		else
+			return 0;
+		pass(id, op);
+		if (ram[addr] != 0xca)
+			return 0;
+		pass(id, 0xca);
+		for (addr += 3; addr != jump; addr++) {
+			op = ram[addr];
+			if (op == 0x23 && id->dst == NULL)
+				id->dst = &i80->hl;
+			else if (op == 0x03 && id->tally == NULL)
+				id->tally = &i80->bc;
+			else if (op == 0x13 && id->tally == NULL)
+				id->tally = &i80->de;
+			else
+				return 0;
+			pass(id, op);
+		}
+		pass(id, 0xc3);
+
+		return id->dst != NULL;
+	}
+	if (ram[jump] != 0xc2)
+		return 0;
+
+	if (ram[addr] == 0x1a && ram[(word) (addr + 1)] == 0xbe &&
+	    ram[(word) (addr + 2)] == 0xc2) {
+		/* ldax d; cmp m; jnz; a step of each */
+		id->kind = CMP;
+		pass(id, 0x1a);
+		pass(id, 0xbe);
+		pass(id, 0xc2);
+		load = 1;
+		store = 2;
+		for (addr += 5; ; addr++) {
+			op = ram[addr];
+			p = op >> 4;
+			if ((op & 0xc7) != 0x03 || p == 0 || p == 3 ||
+			    dir[p] != 0)
+				break;
+			dir[p] = (op & 0x8) ? -1 : 1;
+			pass(id, op);
+		}
+		if (dir[1] == 0 || dir[2] == 0)
+			return 0;
+		id->src = &i80->hl;
+		id->ds = dir[2];
+		id->dst = &i80->de;
+		id->dd = dir[1];
+	} else {
+		/* Copy or fill: a load, a store, a step of each pointer */
+		for (;; addr++) {
+			op = ram[addr];
+			p = op >> 4;
+			if (op == 0x7e || op == 0x0a || op == 0x1a) {
+				/* mov a,m; ldax */
+				if (load != -1 || store != -1)
+					return 0;
+				load = op == 0x7e ? 2 : p;
+			} else if (op == 0x77 || op == 0x02 || op == 0x12) {
+				/* mov m,a; stax */
+				if (store != -1)
+					return 0;
+				store = op == 0x77 ? 2 : p;
+				if (load == -1)
+					fill = 7;
+			} else if ((op >= 0x70 && op <= 0x75) || op == 0x36) {
+				/* mov m,r; mvi m */
+				if (store != -1 || load != -1)
+					return 0;
+				store = 2;
+				if (op == 0x36)
+					id->fill = &ram[(word) ++addr];
+				else
+					fill = op & 0x7;
+			} else if ((op & 0xc7) == 0x03 && p != 3 &&
+			    (p == load || p == store) && dir[p] == 0) {
+				/* inx or dcx of a pointer, after its use */
+				dir[p] = (op & 0x8) ? -1 : 1;
+			} else
+				break;
+			pass(id, op);
+		}
+		if (store == -1 || dir[store] == 0)
+			return 0;
+		if (load != -1) {
+			id->kind = COPY;
+			if (load == store || dir[load] == 0)
+				return 0;
+			id->src = pairof(i80, load);
+			id->ds = dir[load];
+		} else {
+			id->kind = FILL;
+			if (fill != -1)
+				id->fill = regof(i80, fill);
+		}
+		id->dst = pairof(i80, store);
+		id->dd = dir[store];
+	}
+	if (!loopcount(i80, addr, jump, id, &rp, &r))
+		return 0;
+
+	/* The count and the fill must be clear of the pointers */
+	used = 1 << store | (load != -1 ? 1 << load : 0);
+	if ((rp != -1 && (used & 1 << rp)) ||
+	    (r != -1 && (used & 1 << (r >> 1))))
+		return 0;
+	if (fill == 7 && rp != -1)
+		return 0;	/* mov a,hi takes a */
+	if (fill != -1 && fill != 7 && ((used & 1 << (fill >> 1)) ||
+	    fill == r || fill >> 1 == rp))
+		return 0;
+
+	return 1;
+}
+
+/*
+ * Whether the n bytes written from start in direction dir meet the len
+ * bytes from lo.
+ */
+static int
+overlaps(word start, unsigned int n, int dir, word lo, unsigned int len)
+{
+	word a = dir > 0 ? start : start - n + 1;
+
+	return (word) (lo - a) < n || (word) (a - lo) < len;
+}
+
+/*
+ * Copy n bytes as n passes of a copy loop would.  With both pointers
+ * going the same way, the copy goes in runs that neither wrap nor read
+ * a byte already written, as the Z80's ldir does.
+ */
+static void
+idiomcopy(struct i80 *i80, const struct idiom *id, unsigned int n)
+{
+	word s = *id->src, d = *id->dst;
+	unsigned int dist, len;
+
+	if (id->ds != id->dd) {
+		while (n-- > 0) {
+			i80->ram[d] = i80->ram[s];
+			s += id->ds;
+			d += id->dd;
+		}
+		return;
+	}
+
+	dist = (word) (id->dd > 0 ? d - s : s - d);
+	while (n > 0) {
+		len = n;
+		if (dist > 1 && dist < len)
+			len = dist;
+		if (id->dd > 0) {
+			if (len > 0x10000U - s)
+				len = 0x10000U - s;
+			if (len > 0x10000U - d)
+				len = 0x10000U - d;
+			if (dist == 1)
+				memset(&i80->ram[d], i80->ram[s], len);
+			else
+				memmove(&i80->ram[d], &i80->ram[s], len);
+			s += len;
+			d += len;
+		} else {
+			if (len > s + 1U)
+				len = s + 1U;
+			if (len > d + 1U)
+				len = d + 1U;
+			if (dist == 1)
+				memset(&i80->ram[d - len + 1], i80->ram[s],
+				    len);
+			else
+				memmove(&i80->ram[d - len + 1],
+				    &i80->ram[s - len + 1], len);
+			s -= len;
+			d -= len;
+		}
+		n -= len;
+	}
+}
+
+/*
+ * Called with pc after a jnz or jmp that is about to jump back to top,
+ * and the budget of instructions left after it, which every engine
+ * keeps exact.  Runs the passes of an idiom loop there, all but the
+ * last and no more than budget allows less one, and returns the number
+ * of instructions they make.  Every pass sets a and the flags, or
+ * leaves them alone, so the one the interpreter runs next puts them
+ * right.
+ */
+static long long
+idiom(struct i80 *i80, word top, long long budget)
+{
+	struct idiom id;
+	word jump = i80->pc - 3, a, b;
+	unsigned int i, n, len;
+	const byte *p;
+
+#if defined(PROFILE) || defined(STATS)
+	/* Every pass has to be counted, by address or by opcode */
+	i80->idioms[jump] = NOTIDIOM;
+	return 0;
+#endif
+#ifdef TRACE
+	/* Or recorded, while a trace is being made */
+	if (i80->rec.fn != NULL)
+		return 0;
+#endif
+	if (i80->jit || !matchloop(i80, top, jump, &id)) {
+		i80->idioms[jump] = NOTIDIOM;
+		return 0;
+	}
+	i80->idioms[jump] = IDIOM;
+
+	if (id.count16 != NULL)
+		n = *id.count16 - 1;
+	else if (id.count8 != NULL)
+		n = *id.count8 - 1;
+	else
+		n = 0xffff;
+	/* Leave the interpreter at least one whole pass, to set a and F */
+	if (budget < 2 * id.insns || n == -1U)
+		return 0;
+	if (n > budget / id.insns - 1)
+		n = budget / id.insns - 1;
+
+	switch (id.kind) {
+	case COPY:
+	case FILL:
+		if (n == 0 || overlaps(*id.dst, n, id.dd, top, jump + 3 - top))
+			return 0;
+		if (id.kind == COPY) {
+			idiomcopy(i80, &id, n);
+			*id.src += n * id.ds;
+		} else if (id.dd > 0) {
+			for (a = *id.dst, i = n; i > 0; a += len, i -= len) {
+				len = i < 0x10000U - a ? i : 0x10000U - a;
+				memset(&i80->ram[a], *id.fill, len);
+			}
+		} else {
+			for (a = *id.dst, i = n; i > 0; a -= len, i -= len) {
+				len = i < a + 1U ? i : a + 1U;
+				memset(&i80->ram[a - len + 1], *id.fill, len);
+			}
+		}
+		a = *id.dst;
+		*id.dst += n * id.dd;
+		/* Tell the caches of translated code */
+		i80touch(i80, id.dd > 0 ? a : (word) (a - n + 1), n);
+		break;
+	case CMP:
+		a = *id.src;
+		b = *id.dst;
+		for (i = 0; i < n && i80->ram[a] == i80->ram[b]; i++) {
+			a += id.ds;
+			b += id.dd;
+		}
+		n = i;
+		*id.src = a;
+		*id.dst = b;
+		break;
+	case SCAN:
+		a = *id.dst;
+		for (i = 0; i < n; i += len) {
+			len = n - i < 0x10000U - a ? n - i : 0x10000U - a;
+			if ((p = memchr(&i80->ram[a], 0, len)) != NULL) {
+				i += p - &i80->ram[a];
+				break;
+			}
+			a += len;
+		}
+		n = i;
+		*id.dst += n;
+		if (id.tally != NULL)
+			*id.tally += n;
+		break;
+	}
+
+	if (id.count16 != NULL)
+		*id.count16 -= n;
+	else if (id.count8 != NULL)
+		*id.count8 -= n;
+#ifdef CYCLES
+	i80->instrs += (uint64_t) n * id.insns;
+	i80->cycles += (uint64_t) n * id.cycles;
+#endif
+
+	return (long long) n * id.insns;
+}
+
+static int
+execute(struct i80 *i80, byte opcode)
+{
+	uint32_t doublecarry;
+	word carry = 0, sb1, sb2;
+	byte halfcarry = 0;
+#ifdef BLOCKS
+	const struct block *b;
+	const struct insn *ip, *ipend;
+#endif
+#ifdef THREADED
+	long long budget = i80->budget;
+	static const void *const optab[256] = {
+		&&op_0x00, &&op_0x01, &&op_0x02, &&op_0x03,
+		&&op_0x04, &&op_0x05, &&op_0x06, &&op_0x07,
+		&&op_0x08, &&op_0x09, &&op_0x0a, &&op_0x0b,
+		&&op_0x0c, &&op_0x0d, &&op_0x0e, &&op_0x0f,
+		&&op_0x10, &&op_0x11, &&op_0x12, &&op_0x13,
+		&&op_0x14, &&op_0x15, &&op_0x16, &&op_0x17,
+		&&op_0x18, &&op_0x19, &&op_0x1a, &&op_0x1b,
+		&&op_0x1c, &&op_0x1d, &&op_0x1e, &&op_0x1f,
+		&&op_0x20, &&op_0x21, &&op_0x22, &&op_0x23,
+		&&op_0x24, &&op_0x25, &&op_0x26, &&op_0x27,
+		&&op_0x28, &&op_0x29, &&op_0x2a, &&op_0x2b,
+		&&op_0x2c, &&op_0x2d, &&op_0x2e, &&op_0x2f,
+		&&op_0x30, &&op_0x31, &&op_0x32, &&op_0x33,
+		&&op_0x34, &&op_0x35, &&op_0x36, &&op_0x37,
+		&&op_0x38, &&op_0x39, &&op_0x3a, &&op_0x3b,
+		&&op_0x3c, &&op_0x3d, &&op_0x3e, &&op_0x3f,
+		&&op_0x40, &&op_0x41, &&op_0x42, &&op_0x43,
+		&&op_0x44, &&op_0x45, &&op_0x46, &&op_0x47,
+		&&op_0x48, &&op_0x49, &&op_0x4a, &&op_0x4b,
+		&&op_0x4c, &&op_0x4d, &&op_0x4e, &&op_0x4f,
+		&&op_0x50, &&op_0x51, &&op_0x52, &&op_0x53,
+		&&op_0x54, &&op_0x55, &&op_0x56, &&op_0x57,
+		&&op_0x58, &&op_0x59, &&op_0x5a, &&op_0x5b,
+		&&op_0x5c, &&op_0x5d, &&op_0x5e, &&op_0x5f,
+		&&op_0x60, &&op_0x61, &&op_0x62, &&op_0x63,
+		&&op_0x64, &&op_0x65, &&op_0x66, &&op_0x67,
+		&&op_0x68, &&op_0x69, &&op_0x6a, &&op_0x6b,
+		&&op_0x6c, &&op_0x6d, &&op_0x6e, &&op_0x6f,
+		&&op_0x70, &&op_0x71, &&op_0x72, &&op_0x73,
+		&&op_0x74, &&op_0x75, &&op_0x76, &&op_0x77,
+		&&op_0x78, &&op_0x79, &&op_0x7a, &&op_0x7b,
+		&&op_0x7c, &&op_0x7d, &&op_0x7e, &&op_0x7f,
+		&&op_0x80, &&op_0x81, &&op_0x82, &&op_0x83,
+		&&op_0x84, &&op_0x85, &&op_0x86, &&op_0x87,
+		&&op_0x88, &&op_0x89, &&op_0x8a, &&op_0x8b,
+		&&op_0x8c, &&op_0x8d, &&op_0x8e, &&op_0x8f,
+		&&op_0x90, &&op_0x91, &&op_0x92, &&op_0x93,
+		&&op_0x94, &&op_0x95, &&op_0x96, &&op_0x97,
+		&&op_0x98, &&op_0x99, &&op_0x9a, &&op_0x9b,
+		&&op_0x9c, &&op_0x9d, &&op_0x9e, &&op_0x9f,
+		&&op_0xa0, &&op_0xa1, &&op_0xa2, &&op_0xa3,
+		&&op_0xa4, &&op_0xa5, &&op_0xa6, &&op_0xa7,
+		&&op_0xa8, &&op_0xa9, &&op_0xaa, &&op_0xab,
+		&&op_0xac, &&op_0xad, &&op_0xae, &&op_0xaf,
+		&&op_0xb0, &&op_0xb1, &&op_0xb2, &&op_0xb3,
+		&&op_0xb4, &&op_0xb5, &&op_0xb6, &&op_0xb7,
+		&&op_0xb8, &&op_0xb9, &&op_0xba, &&op_0xbb,
+		&&op_0xbc, &&op_0xbd, &&op_0xbe, &&op_0xbf,
+		&&op_0xc0, &&op_0xc1, &&op_0xc2, &&op_0xc3,
+		&&op_0xc4, &&op_0xc5, &&op_0xc6, &&op_0xc7,
+		&&op_0xc8, &&op_0xc9, &&op_0xca, &&op_0xcb,
+		&&op_0xcc, &&op_0xcd, &&op_0xce, &&op_0xcf,
+		&&op_0xd0, &&op_0xd1, &&op_0xd2, &&op_0xd3,
+		&&op_0xd4, &&op_0xd5, &&op_0xd6, &&op_0xd7,
+		&&op_0xd8, &&op_0xd9, &&op_0xda, &&op_0xdb,
+		&&op_0xdc, &&op_0xdd, &&op_0xde, &&op_0xdf,
+		&&op_0xe0, &&op_0xe1, &&op_0xe2, &&op_0xe3,
+		&&op_0xe4, &&op_0xe5, &&op_0xe6, &&op_0xe7,
+		&&op_0xe8, &&op_0xe9, &&op_0xea, &&op_0xeb,
+		&&op_0xec, &&op_0xed, &&op_0xee, &&op_0xef,
+		&&op_0xf0, &&op_0xf1, &&op_0xf2, &&op_0xf3,
+		&&op_0xf4, &&op_0xf5, &&op_0xf6, &&op_0xf7,
+		&&op_0xf8, &&op_0xf9, &&op_0xfa, &&op_0xfb,
+		&&op_0xfc, &&op_0xfd, &&op_0xfe, &&op_0xff,
+	};
+
+#ifdef BLOCKS
+	/* main() has fetched the opcode already; run the block it starts */
+	i80->pc--;
+	goto blockend;
+#else
+	/* i80run() only gets here with budget left */
+	budget--;
+	COUNT(opcode);
+	AT(i80->pc - 1);
+	goto *optab[opcode];
+#endif
+	{
+#else
+	COUNT(opcode);
+	AT(i80->pc - 1);
+	switch (opcode) {
+#endif
+	OP(0x00):	/* nop */
+	OP(0x08):
+	OP(0x10):
+	OP(0x18):
+	OP(0x20):
+	OP(0x28):
+	OP(0x30):
+	OP(0x38):
+		NEXT;
+	OP(0x01):	/* lxi b, i16 */
+		i80->bc = IMM16;
+		NEXT;
+	OP(0x02):	/* stax b */
+		STORE(i80->bc, i80->a);
+		NEXT;
+	OP(0x03):	/* inx b */
+		i80->bc++;
+		NEXT;
+	OP(0x04):	/* inr b */
+		i80->b = inr(i80, i80->b);
+		NEXT;
+	OP(0x05):	/* dcr b */
+		i80->b = dcr(i80, i80->b);
+		NEXT;
+	OP(0x06):	/* mvi b, i8 */
+		i80->b = IMM8;
+		NEXT;
+	OP(0x07):	/* rlc */
+		carry = (i80->a) << 1;
+		if (carry > 0xff)
+			i80->f |= FCY;
+		else
+			i80->f &= ~FCY;
+		i80->a = carry & 0xff;
+		if (CARRY(i80) == 1)
+			i80->a++;
+		NEXT;
+	OP(0x09):	/* dad b */
+		doublecarry = i80->hl + i80->bc;
+		i80->f = (i80->f & ~FCY) | (doublecarry >> 16);
+		i80->hl = doublecarry;
+		NEXT;
+	OP(0x0a):	/* ldax b */
+		i80->a = i80->ram[i80->bc];
+		NEXT;
+	OP(0x0b):	/* dcx b */
+		i80->bc--;
+		NEXT;
+	OP(0x0c):	/* inr c */
+		i80->c = inr(i80, i80->c);
+		NEXT;
+	OP(0x0d):	/* dcr c */
+		i80->c = dcr(i80, i80->c);
+		NEXT;
+	OP(0x0e):	/* mvi c, i8 */
+		i80->c = IMM8;
+		NEXT;
+	OP(0x0f):	/* rrc */
+		carry = (i80->a) & 0x1;
+		i80->a = (i80->a) >> 1;
+		if (carry) {
+			i80->a += 0x80;
+			i80->f |= FCY;
+		} else {
+			i80->f &= ~FCY;
+		}
+		NEXT;
+	OP(0x11):	/* lxi d, i16 */
+		i80->de = IMM16;
+		NEXT;
+	OP(0x12):	/* stax d */
+		STORE(i80->de, i80->a);
+		NEXT;
+	OP(0x13):	/* inx d */
+		i80->de++;
+		NEXT;
+	OP(0x14):	/* inr d */
+		i80->d = inr(i80, i80->d);
+		NEXT;
+	OP(0x15):	/* dcr d */
+		i80->d = dcr(i80, i80->d);
+		NEXT;
+	OP(0x16):	/* mvi d, i8 */
+		i80->d = IMM8;
+		NEXT;
+	OP(0x17):	/* ral */
+		carry = (i80->a) << 1;
+		i80->a = carry & 0xff;
+		if (CARRY(i80) == 1)
+			i80->a++;
+
+		if (carry > 0xff)
+			i80->f |= FCY;
+		else
+			i80->f &= ~FCY;
+		NEXT;
+	OP(0x19):	/* dad d */
+		doublecarry = i80->hl + i80->de;
+		i80->f = (i80->f & ~FCY) | (doublecarry >> 16);
+		i80->hl = doublecarry;
+		NEXT;
+	OP(0x1a):	/* ldax d */
+		i80->a = i80->ram[i80->de];
+		NEXT;
+	OP(0x1b):	/* dcx d */
+		i80->de--;
+		NEXT;
+	OP(0x1c):	/* inr e */
+		i80->e = inr(i80, i80->e);
+		NEXT;
+	OP(0x1d):	/* dcr e */
+		i80->e = dcr(i80, i80->e);
+		NEXT;
+	OP(0x1e):	/* mvi e, i8 */
+		i80->e = IMM8;
+		NEXT;
+	OP(0x1f):	/* rar */
+		carry = (i80->a) & 0x1;
+		i80->a = (i80->a) >> 1;
+		if (CARRY(i80) == 1)
+			i80->a += 0x80;
+
+		if (carry)
+			i80->f |= FCY;
+		else
+			i80->f &= ~FCY;
+		NEXT;
+	OP(0x21):	/* lxi h, i16 */
+		i80->hl = IMM16;
+		NEXT;
+	OP(0x22):	/* shld i16 */
+		sb1 = IMM16;
+		STORE(sb1++, i80->l);
+		STORE(sb1, i80->h);
+		NEXT;
+	OP(0x23):	/* inx h */
+		i80->hl++;
+		NEXT;
+	OP(0x24):	/* inr h */
+		i80->h = inr(i80, i80->h);
+		NEXT;
+	OP(0x25):	/* dcr h */
+		i80->h = dcr(i80, i80->h);
+		NEXT;
+	OP(0x26):	/* mvi h, i8 */
+		i80->h = IMM8;
+		NEXT;
+	OP(0x27):	/* daa */
+		daa(i80);
+		NEXT;
+	OP(0x29):	/* dad h */
+		doublecarry = i80->hl + i80->hl;
+		i80->f = (i80->f & ~FCY) | (doublecarry >> 16);
+		i80->hl = doublecarry;
+		NEXT;
+	OP(0x2a):	/* lhld i16 */
+		sb1 = IMM16;
+		i80->l = i80->ram[sb1++];
+		i80->h = i80->ram[sb1];
+		NEXT;
+	OP(0x2b):	/* dcx h */
+		i80->hl--;
+		NEXT;
+	OP(0x2c):	/* inr l */
+		i80->l = inr(i80, i80->l);
+		NEXT;
+	OP(0x2d):	/* dcr l */
+		i80->l = dcr(i80, i80->l);
+		NEXT;
+	OP(0x2e):	/* mvi l, i8 */
+		i80->l = IMM8;
+		NEXT;
+	OP(0x2f):	/* cma */
+		i80->a = ~(i80->a);
+		NEXT;
+	OP(0x31):	/* lxi sp, i16 */
+		i80->sp = IMM16;
+		NEXT;
+	OP(0x32):	/* sta i16 */
+		sb1 = IMM16;
+		STORE(sb1, i80->a);
+		NEXT;
+	OP(0x33):	/* inx sp */
+		++i80->sp;
+		NEXT;
+	OP(0x34):	/* inr m */
+		STORE(i80->hl, inr(i80, i80->ram[i80->hl]));
+		NEXT;
+	OP(0x35):	/* dcr m */
+		STORE(i80->hl, dcr(i80, i80->ram[i80->hl]));
+		NEXT;
+	OP(0x36):	/* mvi m, i8 */
+		STORE(i80->hl, IMM8);
+		NEXT;
+	OP(0x37):	/* stc */
+		i80->f |= FCY;
+		NEXT;
+	OP(0x39):	/* dad sp */
+		doublecarry = i80->hl + i80->sp;
+		i80->f = (i80->f & ~FCY) | (doublecarry >> 16);
+		i80->hl = doublecarry;
+		NEXT;
+	OP(0x3a):	/* lda i16 */
+		sb1 = IMM16;
+		i80->a = i80->ram[sb1];
+		NEXT;
+	OP(0x3b):	/* dcx sp */
+		--i80->sp;
+		NEXT;
+	OP(0x3c):	/* inr a */
+		i80->a = inr(i80, i80->a);
+		NEXT;
+	OP(0x3d):	/* dcr a */
+		i80->a = dcr(i80, i80->a);
+		NEXT;
+	OP(0x3e):	/* mvi a, i8 */
+		i80->a = IMM8;
+		NEXT;
+	OP(0x3f):	/* cmc */
+		i80->f ^= FCY;
+		NEXT;
+	OP(0x40):	/* mov b, b */
+		/* cheat, do nothing */
+		NEXT;
+	OP(0x41):	/* mov b, c */
+		i80->b = i80->c;
+		NEXT;
+	OP(0x42):	/* mov b, d */
+		i80->b = i80->d;
+		NEXT;
+	OP(0x43):	/* mov b, e */
+		i80->b = i80->e;
+		NEXT;
+	OP(0x44):	/* mov b, h */
+		i80->b = i80->h;
+		NEXT;
+	OP(0x45):	/* mov b, l */
+		i80->b = i80->l;
+		NEXT;
+	OP(0x46):	/* mov b, m */
+		i80->b = i80->ram[i80->hl];
+		NEXT;
+	OP(0x47):	/* mov b, a */
+		i80->b = i80->a;
+		NEXT;
+	OP(0x48):	/* mov c, b */
+		i80->c = i80->b;
+		NEXT;
+	OP(0x49):	/* mov c, c */
+		/* cheat, do nothing */
+		NEXT;
+	OP(0x4a):	/* mov c, d */
+		i80->c = i80->d;
+		NEXT;
+	OP(0x4b):	/* mov c, e */
+		i80->c = i80->e;
+		NEXT;
+	OP(0x4c):	/* mov c, h */
+		i80->c = i80->h;
+		NEXT;
+	OP(0x4d):	/* mov c, l */
+		i80->c = i80->l;
+		NEXT;
+	OP(0x4e):	/* mov c, m */
+		i80->c = i80->ram[i80->hl];
+		NEXT;
+	OP(0x4f):	/* mov c, a */
+		i80->c = i80->a;
+		NEXT;
+	OP(0x50):	/* mov d, b */
+		i80->d = i80->b;
+		NEXT;
+	OP(0x51):	/* mov d, c */
+		i80->d = i80->c;
+		NEXT;
+	OP(0x52):	/* mov d, d */
+		/* cheat, do nothing */
+		NEXT;
+	OP(0x53):	/* mov d, e */
+		i80->d = i80->e;
+		NEXT;
+	OP(0x54):	/* mov d, h */
+		i80->d = i80->h;
+		NEXT;
+	OP(0x55):	/* mov d, l */
+		i80->d = i80->l;
+		NEXT;
+	OP(0x56):	/* mov d, m */
+		i80->d = i80->ram[i80->hl];
+		NEXT;
+	OP(0x57):	/* mov d, a */
+		i80->d = i80->a;
+		NEXT;
+	OP(0x58):	/* mov e, b */
+		i80->e = i80->b;
+		NEXT;
+	OP(0x59):	/* mov e, c */
+		i80->e = i80->c;
+		NEXT;
+	OP(0x5a):	/* mov e, d */
+		i80->e = i80->d;
+		NEXT;
+	OP(0x5b):	/* mov e, e */
+		/* cheat, do nothing */
+		NEXT;
+	OP(0x5c):	/* mov e, h */
+		i80->e = i80->h;
+		NEXT;
+	OP(0x5d):	/* mov e, l */
+		i80->e = i80->l;
+		NEXT;
+	OP(0x5e):	/* mov e, m */
+		i80->e = i80->ram[i80->hl];
+		NEXT;
+	OP(0x5f):	/* mov e, a */
+		i80->e = i80->a;
+		NEXT;
+	OP(0x60):	/* mov h, b */
+		i80->h = i80->b;
+		NEXT;
+	OP(0x61):	/* mov h, c */
+		i80->h = i80->c;
+		NEXT;
+	OP(0x62):	/* mov h, d */
+		i80->h = i80->d;
+		NEXT;
+	OP(0x63):	/* mov h, e */
+		i80->h = i80->e;
+		NEXT;
+	OP(0x64):	/* mov h, h */
+		/* cheat, do nothing */
+		NEXT;
+	OP(0x65):	/* mov h, l */
+		i80->h = i80->l;
+		NEXT;
+	OP(0x66):	/* mov h, m */
+		i80->h = i80->ram[i80->hl];
+		NEXT;
+	OP(0x67):	/* mov h, a */
+		i80->h = i80->a;
+		NEXT;
+	OP(0x68):	/* mov l, b */
+		i80->l = i80->b;
+		NEXT;
+	OP(0x69):	/* mov l, c */
+		i80->l = i80->c;
+		NEXT;
+	OP(0x6a):	/* mov l, d */
+		i80->l = i80->d;
+		NEXT;
+	OP(0x6b):	/* mov l, e */
+		i80->l = i80->e;
+		NEXT;
+	OP(0x6c):	/* mov l, h */
+		i80->l = i80->h;
+		NEXT;
+	OP(0x6d):	/* mov l, l */
+		/* cheat, do nothing */
+		NEXT;
+	OP(0x6e):	/* mov l, m */
+		i80->l = i80->ram[i80->hl];
+		NEXT;
+	OP(0x6f):	/* mov l, a */
+		i80->l = i80->a;
+		NEXT;
+	OP(0x70):	/* mov m, b */
+		STORE(i80->hl, i80->b);
+		NEXT;
+	OP(0x71):	/* mov m, c */
+		STORE(i80->hl, i80->c);
+		NEXT;
+	OP(0x72):	/* mov m, d */
+		STORE(i80->hl, i80->d);
+		NEXT;
+	OP(0x73):	/* mov m, e */
+		STORE(i80->hl, i80->e);
+		NEXT;
+	OP(0x74):	/* mov m, h */
+		STORE(i80->hl, i80->h);
+		NEXT;
+	OP(0x75):	/* mov m, l */
+		STORE(i80->hl, i80->l);
+		NEXT;
+	OP(0x76):	/* hlt */
+		LEAVE(0);
+	OP(0x77):	/* mov m, a */
+		STORE(i80->hl, i80->a);
+		NEXT;
+	OP(0x78):	/* mov a, b */
+		i80->a = i80->b;
+		NEXT;
+	OP(0x79):	/* mov a, c */
+		i80->a = i80->c;
+		NEXT;
+	OP(0x7a):	/* mov a, d */
+		i80->a = i80->d;
+		NEXT;
+	OP(0x7b):	/* mov a, e */
+		i80->a = i80->e;
+		NEXT;
+	OP(0x7c):	/* mov a, h */
+		i80->a = i80->h;
+		NEXT;
+	OP(0x7d):	/* mov a, l */
+		i80->a = i80->l;
+		NEXT;
+	OP(0x7e):	/* mov a, m */
+		i80->a = i80->ram[i80->hl];
+		NEXT;
+	OP(0x7f):	/* mov a, a */
+		/* cheat, do nothing */
+		NEXT;
+	OP(0x80):	/* add b */
+		carry = i80->a + i80->b;
+		carryflag(i80, i80->a, i80->b, carry, 0);
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x81):	/* add c */
+		carry = i80->a + i80->c;
+		carryflag(i80, i80->a, i80->c, carry, 0);
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x82):	/* add d */
+		carry = i80->a + i80->d;
+		carryflag(i80, i80->a, i80->d, carry, 0);
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x83):	/* add e */
+		carry = i80->a + i80->e;
+		carryflag(i80, i80->a, i80->e, carry, 0);
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x84):	/* add h */
+		carry = i80->a + i80->h;
+		carryflag(i80, i80->a, i80->h, carry, 0);
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x85):	/* add l */
+		carry = i80->a + i80->l;
+		carryflag(i80, i80->a, i80->l, carry, 0);
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x86):	/* add m */
+		carry = i80->a + i80->ram[i80->hl];
+		carryflag(i80, i80->a, i80->ram[i80->hl], carry, 0);
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x87):	/* add a */
+		carry = i80->a + i80->a;
+		carryflag(i80, i80->a, i80->a, carry, 0);
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x88):	/* adc b */
+		carry = i80->a + i80->b + CARRY(i80);
+		carryflag(i80, i80->a, i80->b, carry, CARRY(i80));
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x89):	/* adc c */
+		carry = i80->a + i80->c + CARRY(i80);
+		carryflag(i80, i80->a, i80->c, carry, CARRY(i80));
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x8a):	/* adc d */
+		carry = i80->a + i80->d + CARRY(i80);
+		carryflag(i80, i80->a, i80->d, carry, CARRY(i80));
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x8b):	/* adc e */
+		carry = i80->a + i80->e + CARRY(i80);
+		carryflag(i80, i80->a, i80->e, carry, CARRY(i80));
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x8c):	/* adc h */
+		carry = i80->a + i80->h + CARRY(i80);
+		carryflag(i80, i80->a, i80->h, carry, CARRY(i80));
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x8d):	/* adc l */
+		carry = i80->a + i80->l + CARRY(i80);
+		carryflag(i80, i80->a, i80->l, carry, CARRY(i80));
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x8e):	/* adc m */
+		carry = i80->a + i80->ram[i80->hl] + CARRY(i80);
+		carryflag(i80, i80->a, i80->ram[i80->hl], carry, CARRY(i80));
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x8f):	/* adc a */
+		carry = i80->a + i80->a + CARRY(i80);
+		carryflag(i80, i80->a, i80->a, carry, CARRY(i80));
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x90):	/* sub b */
+		carry = i80->a + ~(i80->b) + 1;
+		carryflag(i80, i80->a, ~(i80->b), carry, 1);
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x91):	/* sub c */
+		carry = i80->a + ~(i80->c) + 1;
+		carryflag(i80, i80->a, ~(i80->c), carry, 1);
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x92):	/* sub d */
+		carry = i80->a + ~(i80->d) + 1;
+		carryflag(i80, i80->a, ~(i80->d), carry, 1);
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x93):	/* sub e */
+		carry = i80->a + ~(i80->e) + 1;
+		carryflag(i80, i80->a, ~(i80->e), carry, 1);
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x94):	/* sub h */
+		carry = i80->a + ~(i80->h) + 1;
+		carryflag(i80, i80->a, ~(i80->h), carry, 1);
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x95):	/* sub l */
+		carry = i80->a + ~(i80->l) + 1;
+		carryflag(i80, i80->a, ~(i80->l), carry, 1);
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x96):	/* sub m */
+		carry = i80->a + ~(i80->ram[i80->hl]) + 1;
+		carryflag(i80, i80->a, ~(i80->ram[i80->hl]), carry, 1);
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x97):	/* sub a */
+		carry = i80->a + ~(i80->a) + 1;
+		carryflag(i80, i80->a, ~(i80->a), carry, 1);
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x98):	/* sbb b */
+		carry = i80->a + ~(i80->b) + 1 - CARRY(i80);
+		carryflag(i80, i80->a, ~(i80->b), carry, 1 - CARRY(i80));
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x99):	/* sbb c */
+		carry = i80->a + ~(i80->c) + 1 - CARRY(i80);
+		carryflag(i80, i80->a, ~(i80->c), carry, 1 - CARRY(i80));
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x9a):	/* sbb d */
+		carry = i80->a + ~(i80->d) + 1 - CARRY(i80);
+		carryflag(i80, i80->a, ~(i80->d), carry, 1 - CARRY(i80));
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x9b):	/* sbb e */
+		carry = i80->a + ~(i80->e) + 1 - CARRY(i80);
+		carryflag(i80, i80->a, ~(i80->e), carry, 1 - CARRY(i80));
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x9c):	/* sbb h */
+		carry = i80->a + ~(i80->h) + 1 - CARRY(i80);
+		carryflag(i80, i80->a, ~(i80->h), carry, 1 - CARRY(i80));
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x9d):	/* sbb l */
+		carry = i80->a + ~(i80->l) + 1 - CARRY(i80);
+		carryflag(i80, i80->a, ~(i80->l), carry, 1 - CARRY(i80));
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x9e):	/* sbb m */
+		carry = i80->a + ~(i80->ram[i80->hl]) + 1 - CARRY(i80);
+		carryflag(i80, i80->a, ~(i80->ram[i80->hl]), carry,
+		    1 - CARRY(i80));
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0x9f):	/* sbb a */
+		carry = i80->a + ~(i80->a) + 1 - CARRY(i80);
+		carryflag(i80, i80->a, ~(i80->a), carry, 1 - CARRY(i80));
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0xa0):	/* ana b */
+		i80->a = i80->a & i80->b;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xa1):	/* ana c */
+		i80->a = i80->a & i80->c;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xa2):	/* ana d */
+		i80->a = i80->a & i80->d;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xa3):	/* ana e */
+		i80->a = i80->a & i80->e;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xa4):	/* ana h */
+		i80->a = i80->a & i80->h;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xa5):	/* ana l */
+		i80->a = i80->a & i80->l;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xa6):	/* ana m */
+		i80->a = i80->a & i80->ram[i80->hl];
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xa7):	/* ana a */
+		i80->a = i80->a & i80->a;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xa8):	/* xra b */
+		i80->a = i80->a ^ i80->b;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xa9):	/* xra c */
+		i80->a = i80->a ^ i80->c;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xaa):	/* xra d */
+		i80->a = i80->a ^ i80->d;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xab):	/* xra e */
+		i80->a = i80->a ^ i80->e;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xac):	/* xra h */
+		i80->a = i80->a ^ i80->h;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xad):	/* xra l */
+		i80->a = i80->a ^ i80->l;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xae):	/* xra m */
+		i80->a = i80->a ^ i80->ram[i80->hl];
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xaf):	/* xra a */
+		i80->a = i80->a ^ i80->a;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xb0):	/* ora b */
+		i80->a = i80->a | i80->b;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xb1):	/* ora c */
+		i80->a = i80->a | i80->c;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xb2):	/* ora d */
+		i80->a = i80->a | i80->d;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xb3):	/* ora e */
+		i80->a = i80->a | i80->e;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xb4):	/* ora h */
+		i80->a = i80->a | i80->h;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xb5):	/* ora l */
+		i80->a = i80->a | i80->l;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xb6):	/* ora m */
+		i80->a = i80->a | i80->ram[i80->hl];
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xb7):	/* ora a */
+		i80->a = i80->a | i80->a;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xb8):	/* cmp b */
+		carry = i80->a + ~(i80->b) + 1;
+		carryflag(i80, i80->a, ~(i80->b), carry, 1);
+		flags(i80, carry);
+		NEXT;
+	OP(0xb9):	/* cmp c */
+		carry = i80->a + ~(i80->c) + 1;
+		carryflag(i80, i80->a, ~(i80->c), carry, 1);
+		flags(i80, carry);
+		NEXT;
+	OP(0xba):	/* cmp d */
+		carry = i80->a + ~(i80->d) + 1;
+		carryflag(i80, i80->a, ~(i80->d), carry, 1);
+		flags(i80, carry);
+		NEXT;
+	OP(0xbb):	/* cmp e */
+		carry = i80->a + ~(i80->e) + 1;
+		carryflag(i80, i80->a, ~(i80->e), carry, 1);
+		flags(i80, carry);
+		NEXT;
+	OP(0xbc):	/* cmp h */
+		carry = i80->a + ~(i80->h) + 1;
+		carryflag(i80, i80->a, ~(i80->h), carry, 1);
+		flags(i80, carry);
+		NEXT;
+	OP(0xbd):	/* cmp l */
+		carry = i80->a + ~(i80->l) + 1;
+		carryflag(i80, i80->a, ~(i80->l), carry, 1);
+		flags(i80, carry);
+		NEXT;
+	OP(0xbe):	/* cmp m */
+		carry = i80->a + ~(i80->ram[i80->hl]) + 1;
+		carryflag(i80, i80->a, ~(i80->ram[i80->hl]), carry, 1);
+		flags(i80, carry);
+		NEXT;
+	OP(0xbf):	/* cmp a */
+		carry = i80->a + ~(i80->a) + 1;
+		carryflag(i80, i80->a, ~(i80->a), carry, 1);
+		flags(i80, carry);
+		NEXT;
+	OP(0xc0):	/* rnz */
+		if (ZERO(i80) == 0) {
+			ret(i80);
+			TICK(6);
+		}
+		NEXT;
+	OP(0xc1):	/* pop b */
+		i80->c = i80->ram[i80->sp++];
+		i80->b = i80->ram[i80->sp++];
+		NEXT;
+	OP(0xc2):	/* jnz i16 */
+		sb1 = IMM16;
+		if (ZERO(i80) == 0) {
+			if (sb1 < i80->pc &&
+			    i80->idioms[(word) (i80->pc - 3)] != NOTIDIOM)
+				BUDGET -= idiom(i80, sb1, BUDGET);
+			i80->pc = sb1;
+		}
+		NEXT;
+	OP(0xc3):	/* jmp i16 */
+	OP(0xcb):
+		sb1 = IMM16;
+		if (sb1 < i80->pc &&
+		    i80->idioms[(word) (i80->pc - 3)] != NOTIDIOM)
+			BUDGET -= idiom(i80, sb1, BUDGET);
+		i80->pc = sb1;
+		NEXT;
+	OP(0xc4):	/* cnz i16 */
+		sb1 = IMM16;
+		if (ZERO(i80) == 0) {
+			call(i80, sb1);
+			TICK(6);
+		}
+		NEXT;
+	OP(0xc5):	/* push b */
+		STORE(--i80->sp, i80->b);
+		STORE(--i80->sp, i80->c);
+		NEXT;
+	OP(0xc6):	/* adi i8 */
+		halfcarry = IMM8;
+		carry = i80->a + halfcarry;
+		carryflag(i80, i80->a, halfcarry, carry, 0);
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0xc7):	/* rst 0 */
+		call(i80, 0x00);
+		NEXT;
+	OP(0xc8):	/* rz */
+		if (ZERO(i80) == 1) {
+			ret(i80);
+			TICK(6);
+		}
+		NEXT;
+	OP(0xc9):	/* ret */
+	OP(0xd9):
+		ret(i80);
+		NEXT;
+	OP(0xca):	/* jz i16 */
+		sb1 = IMM16;
+		if (ZERO(i80) == 1)
+			i80->pc = sb1;
+		NEXT;
+	OP(0xcc):	/* cz i16 */
+		sb1 = IMM16;
+		if (ZERO(i80) == 1) {
+			call(i80, sb1);
+			TICK(6);
+		}
+		NEXT;
+	OP(0xcd):	/* call i16 */
+	OP(0xdd):
+	OP(0xed):
+	OP(0xfd):
+		sb1 = IMM16;
+		call(i80, sb1);
+		NEXT;
+	OP(0xce):	/* aci i8 */
+		halfcarry = IMM8;
+		carry = i80->a + halfcarry + CARRY(i80);
+		carryflag(i80, i80->a, halfcarry, carry, CARRY(i80));
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0xcf):	/* rst 1 */
+		call(i80, 0x08);
+		NEXT;
+	OP(0xd0):	/* rnc */
+		if (CARRY(i80) == 0) {
+			ret(i80);
+			TICK(6);
+		}
+		NEXT;
+	OP(0xd1):	/* pop d */
+		i80->e = i80->ram[i80->sp++];
+		i80->d = i80->ram[i80->sp++];
+		NEXT;
+	OP(0xd2):	/* jnc i16 */
+		sb1 = IMM16;
+		if (CARRY(i80) == 0)
+			i80->pc = sb1;
+		NEXT;
+	OP(0xd3):	/* out i8 */
+		i80->port = IMM8;
+		i80->inout[i80->port] = i80->a;
+		LEAVE(1);
+	OP(0xd4):	/* cnc i16 */
+		sb1 = IMM16;
+		if (CARRY(i80) == 0) {
+			call(i80, sb1);
+			TICK(6);
+		}
+		NEXT;
+	OP(0xd5):	/* push d */
+		STORE(--i80->sp, i80->d);
+		STORE(--i80->sp, i80->e);
+		NEXT;
+	OP(0xd6):	/* sui i8 */
+		halfcarry = IMM8;
+		carry = i80->a + ~(halfcarry) + 1;
+		carryflag(i80, i80->a, ~(halfcarry), carry, 1);
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0xd7):	/* rst 2 */
+		call(i80, 0x10);
+		NEXT;
+	OP(0xd8):	/* rc */
+		if (CARRY(i80) == 1) {
+			ret(i80);
+			TICK(6);
+		}
+		NEXT;
+	OP(0xda):	/* jc i16 */
+		sb1 = IMM16;
+		if (CARRY(i80) == 1)
+			i80->pc = sb1;
+		NEXT;
+	OP(0xdb):	/* in i8 */
+		sb1 = IMM8;
+		if (i80->in != NULL)
+			i80->a = i80->in(i80, sb1, i80->arg);
+		else
+			i80->a = i80->inout[sb1];
+		NEXT;
+	OP(0xdc):	/* cc i16 */
+		sb1 = IMM16;
+		if (CARRY(i80) == 1) {
+			call(i80, sb1);
+			TICK(6);
+		}
+		NEXT;
+	OP(0xde):	/* sbi i8 */
+		halfcarry = IMM8;
+		carry = i80->a + ~(halfcarry) + 1 - CARRY(i80);
+		carryflag(i80, i80->a, ~(halfcarry), carry, 1 - CARRY(i80));
+		i80->a = carry & 0xff;
+		flags(i80, i80->a);
+		NEXT;
+	OP(0xdf):	/* rst 3 */
+		call(i80, 0x18);
+		NEXT;
+	OP(0xe0):	/* rpo */
+		if (PARITY(i80) == 0) {
+			ret(i80);
+			TICK(6);
+		}
+		NEXT;
+	OP(0xe1):	/* pop h */
+		i80->l = i80->ram[i80->sp++];
+		i80->h = i80->ram[i80->sp++];
+		NEXT;
+	OP(0xe2):	/* jpo i16 */
+		sb1 = IMM16;
+		if (PARITY(i80) == 0)
+			i80->pc = sb1;
+		NEXT;
+	OP(0xe3):	/* xthl */
+		sb1 = i80->hl;
+		sb2 = i80->sp + 1;
+		i80->l = i80->ram[i80->sp];
+		i80->h = i80->ram[sb2];
+		STORE(i80->sp, sb1 & 0xff);
+		STORE(sb2, sb1 >> 8);
+		NEXT;
+	OP(0xe4):	/* cpo i16 */
+		sb1 = IMM16;
+		if (PARITY(i80) == 0) {
+			call(i80, sb1);
+			TICK(6);
+		}
+		NEXT;
+	OP(0xe5):	/* push h */
+		STORE(--i80->sp, i80->h);
+		STORE(--i80->sp, i80->l);
+		NEXT;
+	OP(0xe6):	/* ani i8 */
+		i80->a = i80->a & IMM8;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xe7):	/* rst 4 */
+		call(i80, 0x20);
+		NEXT;
+	OP(0xe8):	/* rpe */
+		if (PARITY(i80) == 1) {
+			ret(i80);
+			TICK(6);
+		}
+		NEXT;
+	OP(0xe9):	/* pchl */
+		i80->pc = i80->hl;
+		NEXT;
+	OP(0xea):	/* jpe i16 */
+		sb1 = IMM16;
+		if (PARITY(i80) == 1)
+			i80->pc = sb1;
+		NEXT;
+	OP(0xeb):	/* xchg */
+		sb1 = i80->de;
+		i80->de = i80->hl;
+		i80->hl = sb1;
+		NEXT;
+	OP(0xec):	/* cpe i16 */
+		sb1 = IMM16;
+		if (PARITY(i80) == 1) {
+			call(i80, sb1);
+			TICK(6);
+		}
+		NEXT;
+	OP(0xee):	/* xri i8 */
+		halfcarry = IMM8;
+		i80->a = i80->a ^ halfcarry;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xef):	/* rst 5 */
+		call(i80, 0x28);
+		NEXT;
+	OP(0xf0):	/* rp */
+		if (SIGN(i80) == 0) {
+			ret(i80);
+			TICK(6);
+		}
+		NEXT;
+	OP(0xf1):	/* pop psw */
+		flagsync(i80);
+		i80->f = (i80->ram[i80->sp++] & (FS | FZ | FAC | FP | FCY)) |
+		    FONE;
+		i80->a = i80->ram[i80->sp++];
+		NEXT;
+	OP(0xf2):	/* jp i16 */
+		sb1 = IMM16;
+		if (SIGN(i80) == 0)
+			i80->pc = sb1;
+		NEXT;
+	OP(0xf3):	/* di */
+		i80->inte = 0;
+		NEXT;
+	OP(0xf4):	/* cp i16 */
+		sb1 = IMM16;
+		if (SIGN(i80) == 0) {
+			call(i80, sb1);
+			TICK(6);
+		}
+		NEXT;
+	OP(0xf5):	/* push psw */
+		flagsync(i80);
+		STORE(--i80->sp, i80->a);
+		STORE(--i80->sp, i80->f);
+		NEXT;
+	OP(0xf6):	/* ori i8 */
+		halfcarry = IMM8;
+		i80->a = i80->a | halfcarry;
+		flags(i80, i80->a);
+		i80->f &= ~(FAC | FCY);
+		NEXT;
+	OP(0xf7):	/* rst 6 */
+		call(i80, 0x30);
+		NEXT;
+	OP(0xf8):	/* rm */
+		if (SIGN(i80) == 1) {
+			ret(i80);
+			TICK(6);
+		}
+		NEXT;
+	OP(0xf9):	/* sphl */
+		i80->sp = i80->hl;
+		NEXT;
+	OP(0xfa):	/* jm i16 */
+		sb1 = IMM16;
+		if (SIGN(i80) == 1)
+			i80->pc = sb1;
+		NEXT;
+	OP(0xfb):	/* ei */
+		i80->inte = 1;
+		NEXT;
+	OP(0xfc):	/* cm i16 */
+		sb1 = IMM16;
+		if (SIGN(i80) == 1) {
+			call(i80, sb1);
+			TICK(6);
+		}
+		NEXT;
+	OP(0xfe):	/* cpi i8 */
+		halfcarry = IMM8;
+		carry = i80->a + ~(halfcarry) + 1;
+		carryflag(i80, i80->a, ~(halfcarry), carry, 1);
+		flags(i80, carry);
+		NEXT;
+	OP(0xff):	/* rst 7 */
+		call(i80, 0x38);
+		NEXT;
+#ifdef BLOCKS
+blockend:
+		if (budget <= 0)
+			LEAVE(1);
+		b = lookup(i80, i80->pc, optab);
+		budget -= b->len;
+		ip = b->insn;
+		ipend = ip + b->len;
+		i80->pc = ip->next;
+		COUNT(ip->opcode);
+		AT(i80->pc - lentab[ip->opcode]);
+		goto *ip->op;
+#endif
+	}
+
+	return 1;
+}
+
+#ifndef THREADED
+static int jitclaimed;
+
+static const struct jitcpu jitcpu = {
+	offsetof(struct i80, a),
+	offsetof(struct i80, bc),
+	offsetof(struct i80, de),
+	offsetof(struct i80, hl),
+	offsetof(struct i80, sp),
+	offsetof(struct i80, pc),
+	offsetof(struct i80, inte),
+#ifdef CYCLES
+	offsetof(struct i80, instrs),
+	offsetof(struct i80, cycles),
+	cyctab
+#else
+	-1,
+	-1,
+	NULL
+#endif
+};
+
+static void
+jitdump(const char *what, const struct i80 *i80)
+{
+
+	fprintf(stderr, "%s: af %02x%02x bc %04x de %04x hl %04x sp %04x "
+	    "pc %04x\n", what, i80->a, i80->f, i80->bc, i80->de, i80->hl,
+	    i80->sp, i80->pc);
+}
+
+/*
+ * For -J: run one translated block, then run the same instructions
+ * through execute() from the same state and stop at any difference.
+ * The interpreter's results are kept.  Each block start is checked
+ * the first 255 times it runs, which keeps long programs usable.
+ */
+static unsigned long long
+jitcheck(struct i80 *i80)
+{
+	static struct i80 before, after;
+	static byte checked[0x10000];
+	unsigned long long i, n;
+
+	flagsync(i80);
+	if (checked[i80->pc] == 0xff)
+		return jitrun(i80, i80->budget);
+	before = *i80;
+	if ((n = jitrun(i80, i80->budget)) == 0)
+		return 0;
+	checked[before.pc]++;
+
+	after = *i80;
+	*i80 = before;
+	for (i = 0; i < n; i++)
+		execute(i80, i80->ram[i80->pc++]);
+	flagsync(i80);
+
+	if (after.a != i80->a || after.f != i80->f || after.bc != i80->bc ||
+	    after.de != i80->de || after.hl != i80->hl ||
+	    after.sp != i80->sp || after.pc != i80->pc ||
+	    after.inte != i80->inte ||
+#ifdef CYCLES
+	    after.instrs != i80->instrs || after.cycles != i80->cycles ||
+#endif
+	    memcmp(after.ram, i80->ram, sizeof(i80->ram)) != 0) {
+		jitdump("before", &before);
+		jitdump("native", &after);
+		jitdump("interp", i80);
+		errx(1, "translated block at 0x%04x differs from the "
+		    "interpreter", before.pc);
+	}
+
+	return n;
+}
+#endif
+
+/*
+ * Run one instruction in the interpreter, after as much translated
+ * code as there is for the current pc and the budget allows.
+ */
+static int
+step(struct i80 *i80)
+{
+
+#ifndef THREADED
+	if (i80->jit == 2) {
+		i80->budget -= jitcheck(i80);
+	} else if (i80->jit) {
+		flagsync(i80);
+		i80->budget -= jitrun(i80, i80->budget);
+	}
+	if (i80->budget <= 0)
+		return 1;
+	i80->budget--;
+#endif
+
+	return execute(i80, i80->ram[i80->pc++]);
+}
+
+struct i80 *
+i80new(void)
+{
+	struct i80 *i80;
+
+	if ((i80 = calloc(1, sizeof(*i80))) == NULL)
+		return NULL;
+	i80reset(i80);
+
+	return i80;
+}
+
+void
+i80free(struct i80 *i80)
+{
+
+#ifdef PROFILE
+	callsclear(&i80->calls);
+#endif
+#ifndef THREADED
+	/* The translator is free for another machine */
+	if (i80->jit) {
+		jitfini();
+		jitclaimed = 0;
+	}
+#endif
+	free(i80);
+}
+
+/*
+ * Reset the registers and the counters.  Memory and ports are left
+ * alone.
+ */
+void
+i80reset(struct i80 *i80)
+{
+
+	i80->a = 0;
+	i80->b = 0;
+	i80->c = 0;
+	i80->d = 0;
+	i80->e = 0;
+	i80->h = 0;
+	i80->l = 0;
+
+	i80->f = FZ | FP | FONE;
+
+	i80->pc = 0;
+	i80->sp = 0;
+
+	i80->inte = 0;
+
+#ifdef CYCLES
+	i80->cycles = 0;
+	i80->instrs = 0;
+#endif
+
+#ifdef STATS
+	memset(i80->ops, 0, sizeof(i80->ops));
+#endif
+
+#ifdef LAZYFLAGS
+	i80->lazy = 0;
+#endif
+
+#ifdef PROFILE
+	callsclear(&i80->calls);
+#endif
+
+	i80->port = -1;
+}
+
+unsigned char *
+i80ram(struct i80 *i80)
+{
+
+	return i80->ram;
+}
+
+/*
+ * The last byte written to each port, which in reads back when there
+ * is no in handler.
+ */
+unsigned char *
+i80ports(struct i80 *i80)
+{
+
+	return i80->inout;
+}
+
+/*
+ * The embedder wrote len bytes at addr behind the CPU's back.  Pass
+ * them through poke() so that cached and translated code is retired.
+ */
+void
+i80touch(struct i80 *i80, unsigned int addr, unsigned int len)
+{
+
+	while (len-- > 0) {
+		addr &= 0xffff;
+		poke(i80, addr, i80->ram[addr]);
+		i80->idioms[addr] = 0;
+		addr++;
+	}
+}
+
+/*
+ * Make dst a copy of src: registers, counters, memory and ports.  dst
+ * keeps its handlers and translator and drops any code it had cached.
+ */
+void
+i80copy(struct i80 *dst, const struct i80 *src)
+{
+#ifdef BLOCKS
+	int page;
+#endif
+#ifndef THREADED
+	unsigned int addr;
+#endif
+
+	/* The registers and counters lead struct i80 */
+	memcpy(dst, src, offsetof(struct i80, budget));
+	memcpy(dst->ram, src->ram, sizeof(dst->ram));
+	memcpy(dst->inout, src->inout, sizeof(dst->inout));
+	memset(dst->idioms, 0, sizeof(dst->idioms));
+	dst->port = -1;
+
+#ifdef BLOCKS
+	for (page = 0; page < 256; page++)
+		invalidate(dst, page);
+#endif
+#ifndef THREADED
+	if (dst->jit) {
+		for (addr = 0; addr < 0x10000; addr++) {
+			if (jitcode[addr])
+				jitinval(addr);
+		}
+	}
+#endif
+}
+
+unsigned int
+i80get(struct i80 *i80, int reg)
+{
+
+	switch (reg) {
+	case I80_A:
+		return i80->a;
+	case I80_F:
+		flagsync(i80);
+		return i80->f;
+	case I80_B:
+		return i80->b;
+	case I80_C:
+		return i80->c;
+	case I80_D:
+		return i80->d;
+	case I80_E:
+		return i80->e;
+	case I80_H:
+		return i80->h;
+	case I80_L:
+		return i80->l;
+	case I80_BC:
+		return i80->bc;
+	case I80_DE:
+		return i80->de;
+	case I80_HL:
+		return i80->hl;
+	case I80_SP:
+		return i80->sp;
+	case I80_PC:
+		return i80->pc;
+	case I80_INTE:
+		return i80->inte;
+	}
+
+	return 0;
+}
+
+void
+i80set(struct i80 *i80, int reg, unsigned int v)
+{
+
+	switch (reg) {
+	case I80_A:
+		i80->a = v;
+		break;
+	case I80_F:
+		flagsync(i80);
+		i80->f = (v & (FS | FZ | FAC | FP | FCY)) | FONE;
+		break;
+	case I80_B:
+		i80->b = v;
+		break;
+	case I80_C:
+		i80->c = v;
+		break;
+	case I80_D:
+		i80->d = v;
+		break;
+	case I80_E:
+		i80->e = v;
+		break;
+	case I80_H:
+		i80->h = v;
+		break;
+	case I80_L:
+		i80->l = v;
+		break;
+	case I80_BC:
+		i80->bc = v;
+		break;
+	case I80_DE:
+		i80->de = v;
+		break;
+	case I80_HL:
+		i80->hl = v;
+		break;
+	case I80_SP:
+		i80->sp = v;
+		break;
+	case I80_PC:
+		i80->pc = v;
+		break;
+	case I80_INTE:
+		i80->inte = v != 0;
+		break;
+	}
+}
+
+/*
+ * Install the port handlers.  in returns the byte read from a port;
+ * without it, in reads back the last byte written there.  out is
+ * called after every out instruction and returns non-zero to make
+ * i80run() stop.  arg is passed to both.
+ */
+void
+i80io(struct i80 *i80, int (*in)(struct i80 *, int, void *),
+    int (*out)(struct i80 *, int, int, void *), void *arg)
+{
+
+	i80->in = in;
+	i80->out = out;
+	i80->arg = arg;
+}
+
+/*
+ * Run n instructions, or a few more to finish the block or translated
+ * code the block cache or translator is in.  Returns I80_HALT after hlt,
+ * I80_STOP if the out handler asked for it and I80_BUDGET otherwise.
+ */
+int
+i80run(struct i80 *i80, long long n)
+{
+	int port;
+
+	i80->budget = n;
+	while (i80->budget > 0) {
+		if (!step(i80))
+			return I80_HALT;
+		if (i80->port != -1) {
+			port = i80->port;
+			i80->port = -1;
+			if (i80->out != NULL &&
+			    i80->out(i80, port, i80->inout[port], i80->arg))
+				return I80_STOP;
+		}
+	}
+
+	return I80_BUDGET;
+}
+
+/*
+ * Instructions and T-states run since the last reset.  Returns -1 if
+ * the counters were not built in.
+ */
+int
+i80counters(struct i80 *i80, unsigned long long *instrs,
+    unsigned long long *cycles)
+{
+
+#ifdef CYCLES
+	*instrs = i80->instrs;
+	*cycles = i80->cycles;
+
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+/*
+ * The instructions run with each opcode after prefix since the last
+ * reset, or NULL if there are no such opcodes or the counts were not
+ * built in.  The 8080 has no prefixes, only 0 for none.
+ */
+const unsigned long long *
+i80ops(struct i80 *i80, int prefix)
+{
+
+#ifdef STATS
+	if (prefix == 0)
+		return i80->ops;
+#endif
+
+	return NULL;
+}
+
+/*
+ * The instructions run at each address since the last reset, or NULL
+ * if the profile was not built in.  Translated code is not counted.
+ */
+const unsigned long long *
+i80hits(struct i80 *i80)
+{
+
+#ifdef PROFILE
+	return i80->calls.hits;
+#else
+	return NULL;
+#endif
+}
+
+/*
+ * Call fn for every call path that ran instructions since the last
+ * reset, with the addresses called from the outermost in, how many
+ * there are and the instructions run at the end of the path itself.
+ * The path is empty for code run outside of any call.  Returns -1 if
+ * the profile was not built in.
+ */
+int
+i80calls(struct i80 *i80,
+    void (*fn)(const unsigned short *, int, unsigned long long, void *),
+    void *arg)
+{
+#ifdef PROFILE
+	uint16_t path[CALLDEPTH] = { 0 };
+
+	callswalk(&i80->calls.root, path, 0, fn, arg);
+
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+/*
+ * Start a trace of the instructions run from here on, in the format
+ * described in trace.h, handing it to fn a piece at a time.  With fn
+ * NULL, end the trace and hand over the rest.  Translated code is not
+ * traced.  Returns -1 if tracing was not built in.
+ */
+int
+i80trace(struct i80 *i80,
+    void (*fn)(void *, const unsigned char *, size_t), void *arg)
+{
+#ifdef TRACE
+	uint16_t regs[TRACE_NREGS];
+
+	traceregs(i80, regs);
+	if (fn != NULL)
+		recordstart(&i80->rec, "I80T", regs, TRACE_SP + 1, i80->pc,
+		    fn, arg);
+	else if (i80->rec.fn != NULL)
+		recordend(&i80->rec, regs);
+
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+/*
+ * Run hot code through the x86-64 translator, checking every block
+ * against the interpreter if mode is 2.  Only one machine per process
+ * can have it at a time, until i80free().  Returns -1 if it cannot be
+ * had.
+ */
+int
+i80jit(struct i80 *i80, int mode)
+{
+
+#ifdef THREADED
+	return -1;
+#else
+	if (jitclaimed || jitinit(i80->ram, &jitcpu, mode == 2) == -1)
+		return -1;
+	jitclaimed = 1;
+	i80->jit = mode;
+
+	return 0;
+#endif
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * libi80: an 8080 with 64K of memory and 256 ports.  Machines share
+ * nothing but the translator, so any number can live in one process,
+ * one thread at a time each.  Whoever writes to i80ram() directly must
+ * call i80touch() for the bytes written.
+ */
+
+struct i80;
+
+/* Registers for i80get() and i80set() */
+#define I80_A		0
+#define I80_F		1
+#define I80_B		2
+#define I80_C		3
+#define I80_D		4
+#define I80_E		5
+#define I80_H		6
+#define I80_L		7
+#define I80_BC		8
+#define I80_DE		9
+#define I80_HL		10
+#define I80_SP		11
+#define I80_PC		12
+#define I80_INTE	13
+
+/* Why i80run() returned */
+#define I80_HALT	0	/* hlt */
+#define I80_STOP	1	/* The out handler asked to stop */
+#define I80_BUDGET	2	/* The instructions asked for have run */
+
+struct i80	*i80new(void);
+void		 i80free(struct i80 *);
+void		 i80reset(struct i80 *);
+void		 i80copy(struct i80 *, const struct i80 *);
+unsigned char	*i80ram(struct i80 *);
+unsigned char	*i80ports(struct i80 *);
+void		 i80touch(struct i80 *, unsigned int, unsigned int);
+unsigned int	 i80get(struct i80 *, int);
+void		 i80set(struct i80 *, int, unsigned int);
+void		 i80io(struct i80 *, int (*)(struct i80 *, int, void *),
+		    int (*)(struct i80 *, int, int, void *), void *);
+int		 i80run(struct i80 *, long long);
+int		 i80counters(struct i80 *, unsigned long long *,
+		    unsigned long long *);
+int		 i80jit(struct i80 *, int);
+const unsigned long long *i80ops(struct i80 *, int);
+const unsigned long long *i80hits(struct i80 *);
+int		 i80calls(struct i80 *, void (*)(const unsigned short *, int,
+		    unsigned long long, void *), void *);
+int		 i80trace(struct i80 *, void (*)(void *, const unsigned char *,
+		    size_t), void *);
@@ -0,0 +1,2634 @@
+/*
+ * Copyright (c) 2020, 2023 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <err.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "flags.h"
+#include "libz80.h"
+#ifdef PROFILE
+#include "calls.h"
+#endif
+#ifdef TRACE
+#include "trace.h"
+#include "record.h"
+#endif
+
+typedef uint8_t		byte;
+typedef uint16_t	word;
+
+/*
+ * Register pairs overlay a word on their two byte halves, so 16-bit
+ * operations such as inx, dad and xchg work on the whole pair at once.
+ */
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define PAIR(hi, lo, pair)	\
+	union { struct { byte hi; byte lo; }; word pair; }
+#else
+#define PAIR(hi, lo, pair)	\
+	union { struct { byte lo; byte hi; }; word pair; }
+#endif
+
+struct z80 {
+	byte a;
+	byte ap;
+	byte f;
+	byte fp;
+
+	PAIR(b, c, bc);
+	PAIR(bp, cp, bcp);
+	PAIR(d, e, de);
+	PAIR(dp, ep, dep);
+	PAIR(h, l, hl);
+	PAIR(hp, lp, hlp);
+
+	word ix;
+	word iy;
+	word sp;
+	word pc;
+
+	byte i;
+	byte r;		/* Refresh counter, see rreg() */
+	byte inte;	/* IFF1 */
+	byte iff2;
+	byte im;	/* Interrupt mode, kept for ld a,i and retn only */
+
+#ifdef CYCLES
+	uint64_t cycles;
+	uint64_t instrs;
+#endif
+
+#ifdef LAZYFLAGS
+	byte lres;
+	byte lazy;
+#endif
+
+#ifdef STATS
+	/* Instructions run by opcode, alone and after each prefix */
+	unsigned long long ops[5][256];
+#endif
+
+	/* Everything above is state that z80copy() copies */
+	long long budget;	/* Instructions left to run */
+	long long rmark;	/* budget when r was last brought up to date */
+
+	int (*in)(struct z80 *, int, void *);
+	int (*out)(struct z80 *, int, int, void *);
+	void *arg;
+
+	byte ram[0x10000];
+	byte inout[256];
+
+	int port;
+
+#ifdef PROFILE
+	struct calls calls;
+#endif
+
+#ifdef TRACE
+	struct record rec;
+#endif
+};
+
+static void
+ret(struct z80 *z80)
+{
+
+	z80->pc = z80->ram[z80->sp++];
+	z80->pc |= z80->ram[z80->sp++] << 8;
+#ifdef PROFILE
+	callsleave(&z80->calls, z80->sp);
+#endif
+}
+
+static void
+call(struct z80 *z80, word addr)
+{
+
+	z80->ram[--z80->sp] = (z80->pc) >> 8;
+	z80->ram[--z80->sp] = (z80->pc) & 0xff;
+	z80->pc = addr;
+#ifdef PROFILE
+	callsenter(&z80->calls, addr, z80->sp);
+#endif
+}
+
+/*
+ * The Z80 flag byte is S Z 0 H 0 P/V N C.  It shares its layout with
+ * the 8080's, but P/V holds overflow after arithmetic and parity after
+ * everything else, and N, the 8080's always-set bit 1, records whether
+ * the last operation subtracted, for daa.  Bits 3 and 5 are not kept.
+ *
+ * With -DLAZYFLAGS, logic() only records the result and S, Z and P are
+ * derived from it when something reads them: the SIGN(), ZERO() and
+ * PARITY() accessors for conditional branches, and flagsync() before
+ * the flag bits are used or replaced as a whole.  Arithmetic sets P/V
+ * to overflow, so it computes all flags eagerly through setf().
+ */
+#define FN		FONE
+#define SZP(r)		(szp[(r)] & ~FONE)
+
+#ifdef LAZYFLAGS
+#define SIGN(cpu)	((cpu)->lazy ? (cpu)->lres >> 7 : (cpu)->f >> 7)
+#define ZERO(cpu)	((cpu)->lazy ? (cpu)->lres == 0 : ((cpu)->f >> 6) & 0x1)
+#define PARITY(cpu)	\
+	((((cpu)->lazy ? szp[(cpu)->lres] : (cpu)->f) >> 2) & 0x1)
+#else
+#define SIGN(cpu)	((cpu)->f >> 7)
+#define ZERO(cpu)	(((cpu)->f >> 6) & 0x1)
+#define PARITY(cpu)	(((cpu)->f >> 2) & 0x1)
+#endif
+#define HALFCARRY(cpu)	(((cpu)->f >> 4) & 0x1)
+#define CARRY(cpu)	((cpu)->f & FCY)
+
+static void
+flagsync(struct z80 *z80)
+{
+
+#ifdef LAZYFLAGS
+	if (z80->lazy) {
+		z80->f = (z80->f & (FAC | FN | FCY)) | SZP(z80->lres);
+		z80->lazy = 0;
+	}
+#endif
+}
+
+static void
+setf(struct z80 *z80, byte f)
+{
+
+	z80->f = f;
+#ifdef LAZYFLAGS
+	z80->lazy = 0;
+#endif
+}
+
+/*
+ * and, xor and or: S, Z and P from a, H as given, N and C clear.
+ */
+static void
+logic(struct z80 *z80, byte h)
+{
+
+#ifdef LAZYFLAGS
+	z80->lres = z80->a;
+	z80->lazy = 1;
+	z80->f = h;
+#else
+	z80->f = SZP(z80->a) | h;
+#endif
+}
+
+static byte
+add8(struct z80 *z80, byte a, byte v, int c)
+{
+	unsigned int r = a + v + c;
+
+	setf(z80, (SZP(r & 0xff) & (FS | FZ)) | ((a ^ v ^ r) & FAC) |
+	    (((a ^ r) & (v ^ r) & 0x80) >> 5) | (r >> 8));
+
+	return r;
+}
+
+static byte
+sub8(struct z80 *z80, byte a, byte v, int c)
+{
+	unsigned int r = a - v - c;
+
+	setf(z80, (SZP(r & 0xff) & (FS | FZ)) | ((a ^ v ^ r) & FAC) |
+	    (((a ^ v) & (a ^ r) & 0x80) >> 5) | FN | ((r >> 8) & FCY));
+
+	return r;
+}
+
+/*
+ * The eight accumulator operations, numbered as in bits 3-5 of their
+ * opcodes.
+ */
+static void
+alu(struct z80 *z80, int op, byte v)
+{
+
+	switch (op) {
+	case 0:		/* add */
+		z80->a = add8(z80, z80->a, v, 0);
+		break;
+	case 1:		/* adc */
+		z80->a = add8(z80, z80->a, v, CARRY(z80));
+		break;
+	case 2:		/* sub */
+		z80->a = sub8(z80, z80->a, v, 0);
+		break;
+	case 3:		/* sbc */
+		z80->a = sub8(z80, z80->a, v, CARRY(z80));
+		break;
+	case 4:		/* and */
+		z80->a &= v;
+		logic(z80, FAC);
+		break;
+	case 5:		/* xor */
+		z80->a ^= v;
+		logic(z80, 0);
+		break;
+	case 6:		/* or */
+		z80->a |= v;
+		logic(z80, 0);
+		break;
+	case 7:		/* cp */
+		sub8(z80, z80->a, v, 0);
+		break;
+	}
+}
+
+/*
+ * add hl, rr and its ix and iy forms: S, Z and P/V are left alone.
+ */
+static word
+add16(struct z80 *z80, word a, word v)
+{
+	uint32_t r = a + v;
+
+	z80->f = (z80->f & ~(FAC | FN | FCY)) | (((a ^ v ^ r) >> 8) & FAC) |
+	    (r >> 16);
+
+	return r;
+}
+
+/*
+ * adc hl, rr and sbc hl, rr set every flag from the 16-bit result.
+ */
+static word
+adc16(struct z80 *z80, word a, word v)
+{
+	uint32_t r = a + v + CARRY(z80);
+
+	setf(z80, ((r >> 8) & FS) | ((r & 0xffff) == 0 ? FZ : 0) |
+	    (((a ^ v ^ r) >> 8) & FAC) |
+	    ((((a ^ r) & (v ^ r)) >> 13) & FP) | (r >> 16));
+
+	return r;
+}
+
+static word
+sbc16(struct z80 *z80, word a, word v)
+{
+	uint32_t r = a - v - CARRY(z80);
+
+	setf(z80, ((r >> 8) & FS) | ((r & 0xffff) == 0 ? FZ : 0) |
+	    (((a ^ v ^ r) >> 8) & FAC) |
+	    ((((a ^ v) & (a ^ r)) >> 13) & FP) | FN | ((r >> 16) & FCY));
+
+	return r;
+}
+
+static byte
+inr(struct z80 *z80, byte reg)
+{
+
+	reg++;
+	setf(z80, (z80->f & FCY) | (SZP(reg) & (FS | FZ)) |
+	    ((reg & 0xf) == 0 ? FAC : 0) | (reg == 0x80 ? FP : 0));
+
+	return reg;
+}
+
+static byte
+dcr(struct z80 *z80, byte reg)
+{
+
+	reg--;
+	setf(z80, (z80->f & FCY) | (SZP(reg) & (FS | FZ)) | FN |
+	    ((reg & 0xf) == 0xf ? FAC : 0) | (reg == 0x7f ? FP : 0));
+
+	return reg;
+}
+
+/*
+ * Correct a after a BCD addition, or after a subtraction if N is set.
+ */
+static void
+daa(struct z80 *z80)
+{
+	byte a = z80->a, fix = 0, h;
+	int carry = CARRY(z80);
+
+	if (HALFCARRY(z80) || (a & 0xf) > 9)
+		fix = 0x06;
+	if (carry || a > 0x99) {
+		fix |= 0x60;
+		carry = 1;
+	}
+	if (z80->f & FN) {
+		h = HALFCARRY(z80) && (a & 0xf) < 6;
+		z80->a = a - fix;
+	} else {
+		h = (a & 0xf) > 9;
+		z80->a = a + fix;
+	}
+
+	setf(z80, SZP(z80->a) | (h ? FAC : 0) | (z80->f & FN) | carry);
+}
+
+static void
+exafaf(struct z80 *z80)
+{
+	byte ta, tf;
+
+	flagsync(z80);
+
+	ta = z80->a;
+	tf = z80->f;
+
+	z80->a = z80->ap;
+	z80->f = z80->fp;
+
+	z80->ap = ta;
+	z80->fp = tf;
+}
+
+static void
+exx(struct z80 *z80)
+{
+	word tmp;
+
+	tmp = z80->bc;
+	z80->bc = z80->bcp;
+	z80->bcp = tmp;
+
+	tmp = z80->de;
+	z80->de = z80->dep;
+	z80->dep = tmp;
+
+	tmp = z80->hl;
+	z80->hl = z80->hlp;
+	z80->hlp = tmp;
+}
+
+/*
+ * With -DCYCLES, COUNT() bumps cpu->instrs and adds the Z80 T-state
+ * count of the opcode from cyctab[] to cpu->cycles.  Conditional
+ * calls, returns and relative jumps are listed at their not-taken
+ * cost; TICK() adds the difference when taken.  The prefixes are
+ * listed at 4 and their second level adds the rest.  With -DSTATS, it
+ * also counts the opcode in cpu->ops[], and OPS() counts the opcodes
+ * that follow the prefixes.
+ */
+#define MAIN		0	/* Tables in cpu->ops[] */
+#define CB		1
+#define DD		2
+#define ED		3
+#define FD		4
+
+#ifdef STATS
+#define OPS(t, op)	(z80->ops[t][op]++)
+#else
+#define OPS(t, op)	((void) 0)
+#endif
+
+#ifdef CYCLES
+static const byte cyctab[256] = {
+	 4, 10,  7,  6,  4,  4,  7,  4,	/* 0x00 */
+	 4, 11,  7,  6,  4,  4,  7,  4,
+	 8, 10,  7,  6,  4,  4,  7,  4,	/* 0x10 */
+	 7, 11,  7,  6,  4,  4,  7,  4,
+	 7, 10, 16,  6,  4,  4,  7,  4,	/* 0x20 */
+	 7, 11, 16,  6,  4,  4,  7,  4,
+	 7, 10, 13,  6, 11, 11, 10,  4,	/* 0x30 */
+	 7, 11, 13,  6,  4,  4,  7,  4,
+	 4,  4,  4,  4,  4,  4,  7,  4,	/* 0x40 */
+	 4,  4,  4,  4,  4,  4,  7,  4,
+	 4,  4,  4,  4,  4,  4,  7,  4,	/* 0x50 */
+	 4,  4,  4,  4,  4,  4,  7,  4,
+	 4,  4,  4,  4,  4,  4,  7,  4,	/* 0x60 */
+	 4,  4,  4,  4,  4,  4,  7,  4,
+	 7,  7,  7,  7,  7,  7,  4,  7,	/* 0x70 */
+	 4,  4,  4,  4,  4,  4,  7,  4,
+	 4,  4,  4,  4,  4,  4,  7,  4,	/* 0x80 */
+	 4,  4,  4,  4,  4,  4,  7,  4,
+	 4,  4,  4,  4,  4,  4,  7,  4,	/* 0x90 */
+	 4,  4,  4,  4,  4,  4,  7,  4,
+	 4,  4,  4,  4,  4,  4,  7,  4,	/* 0xa0 */
+	 4,  4,  4,  4,  4,  4,  7,  4,
+	 4,  4,  4,  4,  4,  4,  7,  4,	/* 0xb0 */
+	 4,  4,  4,  4,  4,  4,  7,  4,
+	 5, 10, 10, 10, 10, 11,  7, 11,	/* 0xc0 */
+	 5, 10, 10,  4, 10, 17,  7, 11,
+	 5, 10, 10, 11, 10, 11,  7, 11,	/* 0xd0 */
+	 5,  4, 10, 11, 10,  4,  7, 11,
+	 5, 10, 10, 19, 10, 11,  7, 11,	/* 0xe0 */
+	 5,  4, 10,  4, 10,  4,  7, 11,
+	 5, 10, 10,  4, 10, 11,  7, 11,	/* 0xf0 */
+	 5,  6, 10,  4, 10,  4,  7, 11,
+};
+
+#define TICK(n)		(z80->cycles += (n))
+#define COUNT(op)	(z80->instrs++, TICK(cyctab[op]), OPS(MAIN, op))
+#else
+#define TICK(n)
+#define COUNT(op)	OPS(MAIN, op)
+#endif
+
+/*
+ * AT() is given the address of every instruction as it starts.  With
+ * -DPROFILE, HIT() counts instructions there and in the call they ran
+ * in.  With -DTRACE, RECORD() adds the instruction to the trace while
+ * one is being made.
+ */
+#ifdef PROFILE
+#define HIT(addr, n)	callshit(&z80->calls, (addr), (n))
+#else
+#define HIT(addr, n)	((void) 0)
+#endif
+
+#ifdef TRACE
+static void
+traceregs(struct z80 *z80, uint16_t *regs)
+{
+
+	flagsync(z80);
+	regs[TRACE_A] = z80->a;
+	regs[TRACE_F] = z80->f;
+	regs[TRACE_BC] = z80->bc;
+	regs[TRACE_DE] = z80->de;
+	regs[TRACE_HL] = z80->hl;
+	regs[TRACE_SP] = z80->sp;
+	regs[TRACE_IX] = z80->ix;
+	regs[TRACE_IY] = z80->iy;
+	regs[TRACE_AFP] = z80->ap << 8 | z80->fp;
+	regs[TRACE_BCP] = z80->bcp;
+	regs[TRACE_DEP] = z80->dep;
+	regs[TRACE_HLP] = z80->hlp;
+}
+
+static void
+record(struct z80 *z80, word addr)
+{
+	uint16_t regs[TRACE_NREGS];
+
+	traceregs(z80, regs);
+	recordinsn(&z80->rec, addr, z80->ram, regs);
+}
+
+#define RECORD(addr)	(z80->rec.fn != NULL ? record(z80, (addr)) : (void) 0)
+#else
+#define RECORD(addr)	((void) 0)
+#endif
+
+#define AT(addr)	(HIT((addr), 1), RECORD(addr))
+
+/*
+ * jr and djnz: take the displacement and jump if cond.
+ */
+static void
+jr(struct z80 *z80, int cond)
+{
+	int8_t e = z80->ram[z80->pc++];
+
+	if (cond) {
+		z80->pc += e;
+		TICK(5);
+	}
+}
+
+/*
+ * The current refresh register.  r counts instructions rather than
+ * opcode fetches, and is brought up to date lazily from how much of
+ * the budget has been spent since rmark.
+ */
+static byte
+rreg(const struct z80 *z80)
+{
+
+	return (z80->r & 0x80) | ((z80->r + z80->rmark - z80->budget) & 0x7f);
+}
+
+static byte
+portin(struct z80 *z80, int port)
+{
+
+	if (z80->in != NULL)
+		return z80->in(z80, port, z80->arg);
+
+	return z80->inout[port];
+}
+
+/*
+ * The 8-bit operand numbered r in bits 0-2 or 3-5 of an opcode: b, c,
+ * d, e, h, l, (hl) or a.
+ */
+static byte
+get8(struct z80 *z80, int r)
+{
+
+	switch (r) {
+	case 0:
+		return z80->b;
+	case 1:
+		return z80->c;
+	case 2:
+		return z80->d;
+	case 3:
+		return z80->e;
+	case 4:
+		return z80->h;
+	case 5:
+		return z80->l;
+	case 6:
+		return z80->ram[z80->hl];
+	}
+
+	return z80->a;
+}
+
+static void
+put8(struct z80 *z80, int r, byte v)
+{
+
+	switch (r) {
+	case 0:
+		z80->b = v;
+		break;
+	case 1:
+		z80->c = v;
+		break;
+	case 2:
+		z80->d = v;
+		break;
+	case 3:
+		z80->e = v;
+		break;
+	case 4:
+		z80->h = v;
+		break;
+	case 5:
+		z80->l = v;
+		break;
+	case 6:
+		z80->ram[z80->hl] = v;
+		break;
+	default:
+		z80->a = v;
+	}
+}
+
+/*
+ * The register pair numbered p in bits 4-5 of an opcode: bc, de, hl
+ * or sp.
+ */
+static word *
+pair(struct z80 *z80, int p)
+{
+
+	switch (p) {
+	case 0:
+		return &z80->bc;
+	case 1:
+		return &z80->de;
+	case 2:
+		return &z80->hl;
+	}
+
+	return &z80->sp;
+}
+
+/*
+ * rlc, rrc, rl, rr, sla, sra, sll and srl, numbered as in bits 3-5 of
+ * their opcodes.  sll shifts a 1 in and is undocumented.
+ */
+static byte
+rot(struct z80 *z80, int op, byte v)
+{
+	byte r;
+	int c;
+
+	switch (op) {
+	case 0:
+		c = v >> 7;
+		r = v << 1 | c;
+		break;
+	case 1:
+		c = v & 0x1;
+		r = v >> 1 | c << 7;
+		break;
+	case 2:
+		c = v >> 7;
+		r = v << 1 | CARRY(z80);
+		break;
+	case 3:
+		c = v & 0x1;
+		r = v >> 1 | CARRY(z80) << 7;
+		break;
+	case 4:
+		c = v >> 7;
+		r = v << 1;
+		break;
+	case 5:
+		c = v & 0x1;
+		r = v >> 1 | (v & 0x80);
+		break;
+	case 6:
+		c = v >> 7;
+		r = v << 1 | 0x1;
+		break;
+	default:
+		c = v & 0x1;
+		r = v >> 1;
+	}
+	setf(z80, SZP(r) | c);
+
+	return r;
+}
+
+static void
+bit(struct z80 *z80, int n, byte v)
+{
+
+	v &= 1 << n;
+	setf(z80, (z80->f & FCY) | FAC | (v & FS) | (v == 0 ? FZ | FP : 0));
+}
+
+/*
+ * 0xcb: rotates, shifts and single bits of the operand in bits 0-2.
+ */
+static void
+execcb(struct z80 *z80)
+{
+	byte op = z80->ram[z80->pc++], v;
+	int r = op & 0x7, y = (op >> 3) & 0x7;
+
+	OPS(CB, op);
+	v = get8(z80, r);
+	switch (op >> 6) {
+	case 0:
+		put8(z80, r, rot(z80, y, v));
+		break;
+	case 1:
+		bit(z80, y, v);
+		TICK(r == 6 ? 8 : 4);
+		return;
+	case 2:
+		put8(z80, r, v & ~(1 << y));
+		break;
+	case 3:
+		put8(z80, r, v | 1 << y);
+		break;
+	}
+	TICK(r == 6 ? 11 : 4);
+}
+
+/*
+ * 0xdd 0xcb and 0xfd 0xcb: as 0xcb but on (ix+d) or (iy+d).  Unless
+ * the operand bits name (hl), the result is also copied to that
+ * register, which is undocumented.
+ */
+static void
+execxycb(struct z80 *z80, word xy)
+{
+	word addr = xy + (int8_t) z80->ram[z80->pc++];
+	byte op = z80->ram[z80->pc++], v = z80->ram[addr];
+	int y = (op >> 3) & 0x7;
+
+	switch (op >> 6) {
+	case 0:
+		v = rot(z80, y, v);
+		break;
+	case 1:
+		bit(z80, y, v);
+		TICK(16);
+		return;
+	case 2:
+		v &= ~(1 << y);
+		break;
+	case 3:
+		v |= 1 << y;
+		break;
+	}
+	z80->ram[addr] = v;
+	if ((op & 0x7) != 6)
+		put8(z80, op & 0x7, v);
+	TICK(19);
+}
+
+/*
+ * Operand r with h and l standing for the halves of xy, as the
+ * undocumented ixh, ixl, iyh and iyl forms have it.
+ */
+static byte
+getxy8(struct z80 *z80, word xy, int r)
+{
+
+	if (r == 4)
+		return xy >> 8;
+	if (r == 5)
+		return xy & 0xff;
+
+	return get8(z80, r);
+}
+
+static void
+putxy8(struct z80 *z80, word *xy, int r, byte v)
+{
+
+	if (r == 4)
+		*xy = (*xy & 0xff) | v << 8;
+	else if (r == 5)
+		*xy = (*xy & 0xff00) | v;
+	else
+		put8(z80, r, v);
+}
+
+/*
+ * 0xdd and 0xfd: the instructions that use hl, with ix or iy in its
+ * place and (ix+d) or (iy+d) in place of (hl).  Before any other
+ * opcode the prefix does nothing and the opcode runs on its own.
+ */
+static void
+execxy(struct z80 *z80, word *xy)
+{
+	byte op = z80->ram[z80->pc++], v;
+	word sb1;
+	int r, y;
+
+	OPS(xy == &z80->ix ? DD : FD, op);
+	switch (op) {
+	case 0x09:	/* add ix, bc */
+		*xy = add16(z80, *xy, z80->bc);
+		TICK(11);
+		break;
+	case 0x19:	/* add ix, de */
+		*xy = add16(z80, *xy, z80->de);
+		TICK(11);
+		break;
+	case 0x29:	/* add ix, ix */
+		*xy = add16(z80, *xy, *xy);
+		TICK(11);
+		break;
+	case 0x39:	/* add ix, sp */
+		*xy = add16(z80, *xy, z80->sp);
+		TICK(11);
+		break;
+	case 0x21:	/* ld ix, i16 */
+		*xy = z80->ram[z80->pc++];
+		*xy |= z80->ram[z80->pc++] << 8;
+		TICK(10);
+		break;
+	case 0x22:	/* ld (i16), ix */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		z80->ram[sb1++] = *xy & 0xff;
+		z80->ram[sb1] = *xy >> 8;
+		TICK(16);
+		break;
+	case 0x2a:	/* ld ix, (i16) */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		*xy = z80->ram[sb1++];
+		*xy |= z80->ram[sb1] << 8;
+		TICK(16);
+		break;
+	case 0x23:	/* inc ix */
+		++*xy;
+		TICK(6);
+		break;
+	case 0x2b:	/* dec ix */
+		--*xy;
+		TICK(6);
+		break;
+	case 0x24:	/* inc ixh */
+	case 0x2c:	/* inc ixl */
+		r = op >> 3;
+		putxy8(z80, xy, r, inr(z80, getxy8(z80, *xy, r)));
+		TICK(4);
+		break;
+	case 0x25:	/* dec ixh */
+	case 0x2d:	/* dec ixl */
+		r = op >> 3;
+		putxy8(z80, xy, r, dcr(z80, getxy8(z80, *xy, r)));
+		TICK(4);
+		break;
+	case 0x26:	/* ld ixh, i8 */
+	case 0x2e:	/* ld ixl, i8 */
+		putxy8(z80, xy, op >> 3, z80->ram[z80->pc++]);
+		TICK(7);
+		break;
+	case 0x34:	/* inc (ix+d) */
+		sb1 = *xy + (int8_t) z80->ram[z80->pc++];
+		z80->ram[sb1] = inr(z80, z80->ram[sb1]);
+		TICK(19);
+		break;
+	case 0x35:	/* dec (ix+d) */
+		sb1 = *xy + (int8_t) z80->ram[z80->pc++];
+		z80->ram[sb1] = dcr(z80, z80->ram[sb1]);
+		TICK(19);
+		break;
+	case 0x36:	/* ld (ix+d), i8 */
+		sb1 = *xy + (int8_t) z80->ram[z80->pc++];
+		z80->ram[sb1] = z80->ram[z80->pc++];
+		TICK(15);
+		break;
+	case 0xcb:
+		execxycb(z80, *xy);
+		break;
+	case 0xe1:	/* pop ix */
+		*xy = z80->ram[z80->sp++];
+		*xy |= z80->ram[z80->sp++] << 8;
+		TICK(10);
+		break;
+	case 0xe3:	/* ex (sp), ix */
+		sb1 = *xy;
+		*xy = z80->ram[z80->sp];
+		*xy |= z80->ram[(word) (z80->sp + 1)] << 8;
+		z80->ram[z80->sp] = sb1 & 0xff;
+		z80->ram[(word) (z80->sp + 1)] = sb1 >> 8;
+		TICK(19);
+		break;
+	case 0xe5:	/* push ix */
+		z80->ram[--z80->sp] = *xy >> 8;
+		z80->ram[--z80->sp] = *xy & 0xff;
+		TICK(11);
+		break;
+	case 0xe9:	/* jp (ix) */
+		z80->pc = *xy;
+		TICK(4);
+		break;
+	case 0xf9:	/* ld sp, ix */
+		z80->sp = *xy;
+		TICK(6);
+		break;
+	default:
+		r = op & 0x7;
+		y = (op >> 3) & 0x7;
+		if (op < 0x40 || op >= 0xc0 || op == 0x76) {
+			/* Not an hl instruction */
+			z80->pc--;
+		} else if (op < 0x80 && (r == 6 || y == 6)) {
+			/* ld r, (ix+d) and ld (ix+d), r use the real h and l */
+			sb1 = *xy + (int8_t) z80->ram[z80->pc++];
+			if (r == 6)
+				put8(z80, y, z80->ram[sb1]);
+			else
+				z80->ram[sb1] = get8(z80, r);
+			TICK(15);
+		} else if (op < 0x80) {
+			putxy8(z80, xy, y, getxy8(z80, *xy, r));
+			TICK(4);
+		} else if (r == 6) {
+			sb1 = *xy + (int8_t) z80->ram[z80->pc++];
+			alu(z80, y, z80->ram[sb1]);
+			TICK(15);
+		} else {
+			v = getxy8(z80, *xy, r);
+			alu(z80, y, v);
+			TICK(4);
+		}
+	}
+}
+
+/*
+ * The steps the block instruction counting n from its register can run
+ * at once: no more than the budget allows, so that z80run() hands back
+ * at the same instruction it would stepping one at a time.  The budget
+ * already holds the first step.
+ */
+static unsigned int
+steps(struct z80 *z80, unsigned int n)
+{
+
+#ifdef TRACE
+	/* Every step has to be recorded, while a trace is being made */
+	if (z80->rec.fn != NULL)
+		return 1;
+#endif
+	return n - 1 < z80->budget ? n : z80->budget + 1;
+}
+
+/*
+ * The steps writing from addr on in direction dir that can run before
+ * one of them lands on the instruction itself, which the Z80 would
+ * fetch again.  The step that does is the last run at once.
+ */
+static unsigned int
+nowrite(struct z80 *z80, unsigned int n, word addr, int dir)
+{
+	word op = z80->pc - 2;
+	unsigned int j, k;
+
+	j = (word) (dir > 0 ? op - addr : addr - op);
+	k = (word) (dir > 0 ? op + 1 - addr : addr - op - 1);
+	if (k < j)
+		j = k;
+
+	return n > j ? j + 1 : n;
+}
+
+/*
+ * Account for k steps of the repeating block instruction 0xed op, all
+ * but the first of which are extra instructions.  If more is set the
+ * instruction runs again, as the Z80 does.
+ */
+static void
+repeat(struct z80 *z80, byte op, unsigned int k, int more)
+{
+
+	z80->budget -= k - 1;
+#ifdef CYCLES
+	z80->instrs += k - 1;
+#endif
+#ifdef STATS
+	z80->ops[MAIN][0xed] += k - 1;
+	z80->ops[ED][op] += k - 1;
+#endif
+	TICK(21 * (k - 1));
+	HIT(z80->pc - 2, k - 1);
+	if (more) {
+		z80->pc -= 2;
+		TICK(17);
+	} else
+		TICK(12);
+}
+
+/*
+ * n steps of ldi or ldd, as a step of ldir and lddr.  The copy goes
+ * in runs that neither wrap around memory nor read a byte this copy
+ * has already written, so memmove() leaves what the steps one at a
+ * time would.  A destination one byte along from the source spreads
+ * the first byte, which is a fill.
+ */
+static void
+ldi(struct z80 *z80, int dir, unsigned int n)
+{
+	unsigned int d, len;
+
+	d = (word) (dir > 0 ? z80->de - z80->hl : z80->hl - z80->de);
+	z80->bc -= n;
+	while (n > 0) {
+		len = n;
+		if (d > 1 && d < len)
+			len = d;
+		if (dir > 0) {
+			if (len > 0x10000 - z80->hl)
+				len = 0x10000 - z80->hl;
+			if (len > 0x10000 - z80->de)
+				len = 0x10000 - z80->de;
+			if (d == 1)
+				memset(&z80->ram[z80->de], z80->ram[z80->hl],
+				    len);
+			else
+				memmove(&z80->ram[z80->de], &z80->ram[z80->hl],
+				    len);
+			z80->hl += len;
+			z80->de += len;
+		} else {
+			if (len > z80->hl + 1U)
+				len = z80->hl + 1U;
+			if (len > z80->de + 1U)
+				len = z80->de + 1U;
+			if (d == 1)
+				memset(&z80->ram[z80->de - len + 1],
+				    z80->ram[z80->hl], len);
+			else
+				memmove(&z80->ram[z80->de - len + 1],
+				    &z80->ram[z80->hl - len + 1], len);
+			z80->hl -= len;
+			z80->de -= len;
+		}
+		n -= len;
+	}
+	flagsync(z80);
+	z80->f = (z80->f & (FS | FZ | FCY)) | (z80->bc != 0 ? FP : 0);
+}
+
+/*
+ * Up to n steps of cpi or cpd, as a step of cpir and cpdr, stopping at
+ * a match.  Only the last step's flags survive, so the bytes before it
+ * are skipped with memchr() and the last is compared as cpi does.
+ * Returns the steps run.
+ */
+static unsigned int
+cpi(struct z80 *z80, int dir, unsigned int n)
+{
+	unsigned int i, k = 0, len;
+	const byte *p;
+	byte v, r;
+
+	while (k < n - 1) {
+		len = n - 1 - k;
+		if (dir > 0) {
+			if (len > 0x10000 - z80->hl)
+				len = 0x10000 - z80->hl;
+			p = memchr(&z80->ram[z80->hl], z80->a, len);
+			i = p != NULL ? p - &z80->ram[z80->hl] : len;
+			z80->hl += i;
+		} else {
+			if (len > z80->hl + 1U)
+				len = z80->hl + 1U;
+			for (i = 0; i < len; i++) {
+				if (z80->ram[z80->hl - i] == z80->a)
+					break;
+			}
+			z80->hl -= i;
+		}
+		k += i;
+		if (i < len)
+			break;
+	}
+	z80->bc -= k;
+
+	v = z80->ram[z80->hl];
+	r = z80->a - v;
+	z80->hl += dir;
+	z80->bc--;
+	setf(z80, (SZP(r) & (FS | FZ)) | ((z80->a ^ v ^ r) & FAC) | FN |
+	    (z80->bc != 0 ? FP : 0) | (z80->f & FCY));
+
+	return k + 1;
+}
+
+/*
+ * ini and ind, and outi and outd, a step of their repeating forms.
+ * Z tells whether b has reached zero; the other flags are left as dec
+ * b sets them.
+ */
+static void
+ini(struct z80 *z80, int dir)
+{
+
+	z80->ram[z80->hl] = portin(z80, z80->c);
+	z80->hl += dir;
+	z80->b = dcr(z80, z80->b);
+}
+
+static void
+outi(struct z80 *z80, int dir)
+{
+
+	z80->b = dcr(z80, z80->b);
+	z80->port = z80->c;
+	z80->inout[z80->port] = z80->ram[z80->hl];
+	z80->hl += dir;
+}
+
+/*
+ * 0xed: 16-bit arithmetic with carry, port I/O through c, the block
+ * instructions and the interrupt and refresh registers.  Opcodes with
+ * no instruction do nothing.
+ */
+static void
+execed(struct z80 *z80)
+{
+	byte op = z80->ram[z80->pc++], v;
+	word *rp, sb1;
+	unsigned int k, n;
+	int y = (op >> 3) & 0x7;
+
+	OPS(ED, op);
+	if (op >= 0x40 && op < 0x80) {
+		rp = pair(z80, y >> 1);
+		switch (op & 0x7) {
+		case 0:		/* in r, (c) */
+			v = portin(z80, z80->c);
+			if (y != 6)
+				put8(z80, y, v);
+			setf(z80, (z80->f & FCY) | SZP(v));
+			TICK(8);
+			break;
+		case 1:		/* out (c), r */
+			z80->port = z80->c;
+			z80->inout[z80->port] = y != 6 ? get8(z80, y) : 0;
+			TICK(8);
+			break;
+		case 2:		/* sbc hl, rr and adc hl, rr */
+			if (y & 0x1)
+				z80->hl = adc16(z80, z80->hl, *rp);
+			else
+				z80->hl = sbc16(z80, z80->hl, *rp);
+			TICK(11);
+			break;
+		case 3:		/* ld (i16), rr and ld rr, (i16) */
+			sb1 = z80->ram[z80->pc++];
+			sb1 |= z80->ram[z80->pc++] << 8;
+			if (y & 0x1) {
+				*rp = z80->ram[sb1++];
+				*rp |= z80->ram[sb1] << 8;
+			} else {
+				z80->ram[sb1++] = *rp & 0xff;
+				z80->ram[sb1] = *rp >> 8;
+			}
+			TICK(16);
+			break;
+		case 4:		/* neg */
+			z80->a = sub8(z80, 0, z80->a, 0);
+			TICK(4);
+			break;
+		case 5:		/* retn and reti */
+			ret(z80);
+			z80->inte = z80->iff2;
+			TICK(10);
+			break;
+		case 6:		/* im 0, 1 and 2 */
+			z80->im = (y & 0x3) == 0 ? 0 : (y & 0x3) - 1;
+			TICK(4);
+			break;
+		case 7:
+			switch (y) {
+			case 0:		/* ld i, a */
+				z80->i = z80->a;
+				TICK(5);
+				break;
+			case 1:		/* ld r, a */
+				z80->r = z80->a;
+				z80->rmark = z80->budget;
+				TICK(5);
+				break;
+			case 2:		/* ld a, i */
+			case 3:		/* ld a, r */
+				z80->a = y == 2 ? z80->i : rreg(z80);
+				setf(z80, (z80->f & FCY) |
+				    (SZP(z80->a) & (FS | FZ)) |
+				    (z80->iff2 ? FP : 0));
+				TICK(5);
+				break;
+			case 4:		/* rrd */
+				v = z80->ram[z80->hl];
+				z80->ram[z80->hl] = z80->a << 4 | v >> 4;
+				z80->a = (z80->a & 0xf0) | (v & 0xf);
+				setf(z80, (z80->f & FCY) | SZP(z80->a));
+				TICK(14);
+				break;
+			case 5:		/* rld */
+				v = z80->ram[z80->hl];
+				z80->ram[z80->hl] = v << 4 | (z80->a & 0xf);
+				z80->a = (z80->a & 0xf0) | v >> 4;
+				setf(z80, (z80->f & FCY) | SZP(z80->a));
+				TICK(14);
+				break;
+			default:
+				TICK(4);
+			}
+			break;
+		}
+		return;
+	}
+
+	switch (op) {
+	case 0xa0:	/* ldi */
+		ldi(z80, 1, 1);
+		break;
+	case 0xa1:	/* cpi */
+		cpi(z80, 1, 1);
+		break;
+	case 0xa2:	/* ini */
+		ini(z80, 1);
+		break;
+	case 0xa3:	/* outi */
+		outi(z80, 1);
+		break;
+	case 0xa8:	/* ldd */
+		ldi(z80, -1, 1);
+		break;
+	case 0xa9:	/* cpd */
+		cpi(z80, -1, 1);
+		break;
+	case 0xaa:	/* ind */
+		ini(z80, -1);
+		break;
+	case 0xab:	/* outd */
+		outi(z80, -1);
+		break;
+	case 0xb0:	/* ldir */
+	case 0xb8:	/* lddr */
+		n = steps(z80, z80->bc != 0 ? z80->bc : 0x10000);
+		n = nowrite(z80, n, z80->de, op == 0xb0 ? 1 : -1);
+		ldi(z80, op == 0xb0 ? 1 : -1, n);
+		repeat(z80, op, n, z80->bc != 0);
+		return;
+	case 0xb1:	/* cpir */
+	case 0xb9:	/* cpdr */
+		n = steps(z80, z80->bc != 0 ? z80->bc : 0x10000);
+		n = cpi(z80, op == 0xb1 ? 1 : -1, n);
+		repeat(z80, op, n, z80->bc != 0 && ZERO(z80) == 0);
+		return;
+	case 0xb2:	/* inir */
+	case 0xba:	/* indr */
+		n = steps(z80, z80->b != 0 ? z80->b : 0x100);
+		n = nowrite(z80, n, z80->hl, op == 0xb2 ? 1 : -1);
+		for (k = 0; k < n; k++)
+			ini(z80, op == 0xb2 ? 1 : -1);
+		repeat(z80, op, n, z80->b != 0);
+		return;
+	case 0xb3:	/* otir */
+	case 0xbb:	/* otdr */
+		/* Each byte goes to the out handler before the next step */
+		outi(z80, op == 0xb3 ? 1 : -1);
+		repeat(z80, op, 1, z80->b != 0);
+		return;
+	default:
+		TICK(4);
+		return;
+	}
+	TICK(12);
+}
+
+static int
+execute(struct z80 *z80, byte opcode)
+{
+	word carry = 0, sb1, sb2;
+
+	COUNT(opcode);
+	AT(z80->pc - 1);
+	switch (opcode) {
+	case 0x00:	/* nop */
+		break;
+	case 0x01:	/* lxi b, i16 */
+		z80->c = z80->ram[z80->pc++];
+		z80->b = z80->ram[z80->pc++];
+		break;
+	case 0x02:	/* stax b */
+		z80->ram[z80->bc] = z80->a;
+		break;
+	case 0x03:	/* inx b */
+		z80->bc++;
+		break;
+	case 0x04:	/* inr b */
+		z80->b = inr(z80, z80->b);
+		break;
+	case 0x05:	/* dcr b */
+		z80->b = dcr(z80, z80->b);
+		break;
+	case 0x06:	/* mvi b, i8 */
+		z80->b = z80->ram[z80->pc++];
+		break;
+	case 0x07:	/* rlc */
+		carry = (z80->a) << 1;
+		z80->f &= ~(FAC | FN);
+		if (carry > 0xff)
+			z80->f |= FCY;
+		else
+			z80->f &= ~FCY;
+		z80->a = carry & 0xff;
+		if (CARRY(z80) == 1)
+			z80->a++;
+		break;
+	case 0x08:	/* ex af, af' */
+		exafaf(z80);
+		break;
+	case 0x09:	/* dad b */
+		z80->hl = add16(z80, z80->hl, z80->bc);
+		break;
+	case 0x0a:	/* ldax b */
+		z80->a = z80->ram[z80->bc];
+		break;
+	case 0x0b:	/* dcx b */
+		z80->bc--;
+		break;
+	case 0x0c:	/* inr c */
+		z80->c = inr(z80, z80->c);
+		break;
+	case 0x0d:	/* dcr c */
+		z80->c = dcr(z80, z80->c);
+		break;
+	case 0x0e:	/* mvi c, i8 */
+		z80->c = z80->ram[z80->pc++];
+		break;
+	case 0x0f:	/* rrc */
+		carry = (z80->a) & 0x1;
+		z80->a = (z80->a) >> 1;
+		z80->f &= ~(FAC | FN);
+		if (carry) {
+			z80->a += 0x80;
+			z80->f |= FCY;
+		} else {
+			z80->f &= ~FCY;
+		}
+		break;
+	case 0x10:	/* djnz e */
+		jr(z80, --z80->b != 0);
+		break;
+	case 0x11:	/* lxi d, i16 */
+		z80->e = z80->ram[z80->pc++];
+		z80->d = z80->ram[z80->pc++];
+		break;
+	case 0x12:	/* stax d */
+		z80->ram[z80->de] = z80->a;
+		break;
+	case 0x13:	/* inx d */
+		z80->de++;
+		break;
+	case 0x14:	/* inr d */
+		z80->d = inr(z80, z80->d);
+		break;
+	case 0x15:	/* dcr d */
+		z80->d = dcr(z80, z80->d);
+		break;
+	case 0x16:	/* mvi d, i8 */
+		z80->d = z80->ram[z80->pc++];
+		break;
+	case 0x17:	/* ral */
+		carry = (z80->a) << 1;
+		z80->a = carry & 0xff;
+		if (CARRY(z80) == 1)
+			z80->a++;
+		z80->f &= ~(FAC | FN);
+
+		if (carry > 0xff)
+			z80->f |= FCY;
+		else
+			z80->f &= ~FCY;
+		break;
+	case 0x18:	/* jr e */
+		jr(z80, 1);
+		break;
+	case 0x19:	/* dad d */
+		z80->hl = add16(z80, z80->hl, z80->de);
+		break;
+	case 0x1a:	/* ldax d */
+		z80->a = z80->ram[z80->de];
+		break;
+	case 0x1b:	/* dcx d */
+		z80->de--;
+		break;
+	case 0x1c:	/* inr e */
+		z80->e = inr(z80, z80->e);
+		break;
+	case 0x1d:	/* dcr e */
+		z80->e = dcr(z80, z80->e);
+		break;
+	case 0x1e:	/* mvi e, i8 */
+		z80->e = z80->ram[z80->pc++];
+		break;
+	case 0x1f:	/* rar */
+		carry = (z80->a) & 0x1;
+		z80->a = (z80->a) >> 1;
+		if (CARRY(z80) == 1)
+			z80->a += 0x80;
+		z80->f &= ~(FAC | FN);
+
+		if (carry)
+			z80->f |= FCY;
+		else
+			z80->f &= ~FCY;
+		break;
+	case 0x20:	/* jr nz, e */
+		jr(z80, ZERO(z80) == 0);
+		break;
+	case 0x21:	/* lxi h, i16 */
+		z80->l = z80->ram[z80->pc++];
+		z80->h = z80->ram[z80->pc++];
+		break;
+	case 0x22:	/* shld i16 */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		z80->ram[sb1++] = z80->l;
+		z80->ram[sb1] = z80->h;
+		break;
+	case 0x23:	/* inx h */
+		z80->hl++;
+		break;
+	case 0x24:	/* inr h */
+		z80->h = inr(z80, z80->h);
+		break;
+	case 0x25:	/* dcr h */
+		z80->h = dcr(z80, z80->h);
+		break;
+	case 0x26:	/* mvi h, i8 */
+		z80->h = z80->ram[z80->pc++];
+		break;
+	case 0x27:	/* daa */
+		daa(z80);
+		break;
+	case 0x28:	/* jr z, e */
+		jr(z80, ZERO(z80) == 1);
+		break;
+	case 0x29:	/* dad h */
+		z80->hl = add16(z80, z80->hl, z80->hl);
+		break;
+	case 0x2a:	/* lhld i16 */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		z80->l = z80->ram[sb1++];
+		z80->h = z80->ram[sb1];
+		break;
+	case 0x2b:	/* dcx h */
+		z80->hl--;
+		break;
+	case 0x2c:	/* inr l */
+		z80->l = inr(z80, z80->l);
+		break;
+	case 0x2d:	/* dcr l */
+		z80->l = dcr(z80, z80->l);
+		break;
+	case 0x2e:	/* mvi l, i8 */
+		z80->l = z80->ram[z80->pc++];
+		break;
+	case 0x2f:	/* cma */
+		z80->a = ~(z80->a);
+		z80->f |= FAC | FN;
+		break;
+	case 0x30:	/* jr nc, e */
+		jr(z80, CARRY(z80) == 0);
+		break;
+	case 0x31:	/* lxi sp, i16 */
+		z80->sp = z80->ram[z80->pc++];
+		z80->sp |= z80->ram[z80->pc++] << 8;
+		break;
+	case 0x32:	/* sta i16 */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		z80->ram[sb1] = z80->a;
+		break;
+	case 0x33:	/* inx sp */
+		++z80->sp;
+		break;
+	case 0x34:	/* inr m */
+		z80->ram[z80->hl] = inr(z80, z80->ram[z80->hl]);
+		break;
+	case 0x35:	/* dcr m */
+		z80->ram[z80->hl] = dcr(z80, z80->ram[z80->hl]);
+		break;
+	case 0x36:	/* mvi m, i8 */
+		z80->ram[z80->hl] = z80->ram[z80->pc++];
+		break;
+	case 0x37:	/* stc */
+		z80->f = (z80->f & ~(FAC | FN)) | FCY;
+		break;
+	case 0x38:	/* jr c, e */
+		jr(z80, CARRY(z80) == 1);
+		break;
+	case 0x39:	/* dad sp */
+		z80->hl = add16(z80, z80->hl, z80->sp);
+		break;
+	case 0x3a:	/* lda i16 */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		z80->a = z80->ram[sb1];
+		break;
+	case 0x3b:	/* dcx sp */
+		--z80->sp;
+		break;
+	case 0x3c:	/* inr a */
+		z80->a = inr(z80, z80->a);
+		break;
+	case 0x3d:	/* dcr a */
+		z80->a = dcr(z80, z80->a);
+		break;
+	case 0x3e:	/* mvi a, i8 */
+		z80->a = z80->ram[z80->pc++];
+		break;
+	case 0x3f:	/* cmc */
+		z80->f = ((z80->f & ~(FAC | FN)) | (z80->f & FCY) << 4) ^ FCY;
+		break;
+	case 0x40:	/* mov b, b */
+		/* cheat, do nothing */
+		break;
+	case 0x41:	/* mov b, c */
+		z80->b = z80->c;
+		break;
+	case 0x42:	/* mov b, d */
+		z80->b = z80->d;
+		break;
+	case 0x43:	/* mov b, e */
+		z80->b = z80->e;
+		break;
+	case 0x44:	/* mov b, h */
+		z80->b = z80->h;
+		break;
+	case 0x45:	/* mov b, l */
+		z80->b = z80->l;
+		break;
+	case 0x46:	/* mov b, m */
+		z80->b = z80->ram[z80->hl];
+		break;
+	case 0x47:	/* mov b, a */
+		z80->b = z80->a;
+		break;
+	case 0x48:	/* mov c, b */
+		z80->c = z80->b;
+		break;
+	case 0x49:	/* mov c, c */
+		/* cheat, do nothing */
+		break;
+	case 0x4a:	/* mov c, d */
+		z80->c = z80->d;
+		break;
+	case 0x4b:	/* mov c, e */
+		z80->c = z80->e;
+		break;
+	case 0x4c:	/* mov c, h */
+		z80->c = z80->h;
+		break;
+	case 0x4d:	/* mov c, l */
+		z80->c = z80->l;
+		break;
+	case 0x4e:	/* mov c, m */
+		z80->c = z80->ram[z80->hl];
+		break;
+	case 0x4f:	/* mov c, a */
+		z80->c = z80->a;
+		break;
+	case 0x50:	/* mov d, b */
+		z80->d = z80->b;
+		break;
+	case 0x51:	/* mov d, c */
+		z80->d = z80->c;
+		break;
+	case 0x52:	/* mov d, d */
+		/* cheat, do nothing */
+		break;
+	case 0x53:	/* mov d, e */
+		z80->d = z80->e;
+		break;
+	case 0x54:	/* mov d, h */
+		z80->d = z80->h;
+		break;
+	case 0x55:	/* mov d, l */
+		z80->d = z80->l;
+		break;
+	case 0x56:	/* mov d, m */
+		z80->d = z80->ram[z80->hl];
+		break;
+	case 0x57:	/* mov d, a */
+		z80->d = z80->a;
+		break;
+	case 0x58:	/* mov e, b */
+		z80->e = z80->b;
+		break;
+	case 0x59:	/* mov e, c */
+		z80->e = z80->c;
+		break;
+	case 0x5a:	/* mov e, d */
+		z80->e = z80->d;
+		break;
+	case 0x5b:	/* mov e, e */
+		/* cheat, do nothing */
+		break;
+	case 0x5c:	/* mov e, h */
+		z80->e = z80->h;
+		break;
+	case 0x5d:	/* mov e, l */
+		z80->e = z80->l;
+		break;
+	case 0x5e:	/* mov e, m */
+		z80->e = z80->ram[z80->hl];
+		break;
+	case 0x5f:	/* mov e, a */
+		z80->e = z80->a;
+		break;
+	case 0x60:	/* mov h, b */
+		z80->h = z80->b;
+		break;
+	case 0x61:	/* mov h, c */
+		z80->h = z80->c;
+		break;
+	case 0x62:	/* mov h, d */
+		z80->h = z80->d;
+		break;
+	case 0x63:	/* mov h, e */
+		z80->h = z80->e;
+		break;
+	case 0x64:	/* mov h, h */
+		/* cheat, do nothing */
+		break;
+	case 0x65:	/* mov h, l */
+		z80->h = z80->l;
+		break;
+	case 0x66:	/* mov h, m */
+		z80->h = z80->ram[z80->hl];
+		break;
+	case 0x67:	/* mov h, a */
+		z80->h = z80->a;
+		break;
+	case 0x68:	/* mov l, b */
+		z80->l = z80->b;
+		break;
+	case 0x69:	/* mov l, c */
+		z80->l = z80->c;
+		break;
+	case 0x6a:	/* mov l, d */
+		z80->l = z80->d;
+		break;
+	case 0x6b:	/* mov l, e */
+		z80->l = z80->e;
+		break;
+	case 0x6c:	/* mov l, h */
+		z80->l = z80->h;
+		break;
+	case 0x6d:	/* mov l, l */
+		/* cheat, do nothing */
+		break;
+	case 0x6e:	/* mov l, m */
+		z80->l = z80->ram[z80->hl];
+		break;
+	case 0x6f:	/* mov l, a */
+		z80->l = z80->a;
+		break;
+	case 0x70:	/* mov m, b */
+		z80->ram[z80->hl] = z80->b;
+		break;
+	case 0x71:	/* mov m, c */
+		z80->ram[z80->hl] = z80->c;
+		break;
+	case 0x72:	/* mov m, d */
+		z80->ram[z80->hl] = z80->d;
+		break;
+	case 0x73:	/* mov m, e */
+		z80->ram[z80->hl] = z80->e;
+		break;
+	case 0x74:	/* mov m, h */
+		z80->ram[z80->hl] = z80->h;
+		break;
+	case 0x75:	/* mov m, l */
+		z80->ram[z80->hl] = z80->l;
+		break;
+	case 0x76:	/* hlt */
+		return 0;
+	case 0x77:	/* mov m, a */
+		z80->ram[z80->hl] = z80->a;
+		break;
+	case 0x78:	/* mov a, b */
+		z80->a = z80->b;
+		break;
+	case 0x79:	/* mov a, c */
+		z80->a = z80->c;
+		break;
+	case 0x7a:	/* mov a, d */
+		z80->a = z80->d;
+		break;
+	case 0x7b:	/* mov a, e */
+		z80->a = z80->e;
+		break;
+	case 0x7c:	/* mov a, h */
+		z80->a = z80->h;
+		break;
+	case 0x7d:	/* mov a, l */
+		z80->a = z80->l;
+		break;
+	case 0x7e:	/* mov a, m */
+		z80->a = z80->ram[z80->hl];
+		break;
+	case 0x7f:	/* mov a, a */
+		/* cheat, do nothing */
+		break;
+	case 0x80:	/* add b */
+		z80->a = add8(z80, z80->a, z80->b, 0);
+		break;
+	case 0x81:	/* add c */
+		z80->a = add8(z80, z80->a, z80->c, 0);
+		break;
+	case 0x82:	/* add d */
+		z80->a = add8(z80, z80->a, z80->d, 0);
+		break;
+	case 0x83:	/* add e */
+		z80->a = add8(z80, z80->a, z80->e, 0);
+		break;
+	case 0x84:	/* add h */
+		z80->a = add8(z80, z80->a, z80->h, 0);
+		break;
+	case 0x85:	/* add l */
+		z80->a = add8(z80, z80->a, z80->l, 0);
+		break;
+	case 0x86:	/* add m */
+		z80->a = add8(z80, z80->a, z80->ram[z80->hl], 0);
+		break;
+	case 0x87:	/* add a */
+		z80->a = add8(z80, z80->a, z80->a, 0);
+		break;
+	case 0x88:	/* adc b */
+		z80->a = add8(z80, z80->a, z80->b, CARRY(z80));
+		break;
+	case 0x89:	/* adc c */
+		z80->a = add8(z80, z80->a, z80->c, CARRY(z80));
+		break;
+	case 0x8a:	/* adc d */
+		z80->a = add8(z80, z80->a, z80->d, CARRY(z80));
+		break;
+	case 0x8b:	/* adc e */
+		z80->a = add8(z80, z80->a, z80->e, CARRY(z80));
+		break;
+	case 0x8c:	/* adc h */
+		z80->a = add8(z80, z80->a, z80->h, CARRY(z80));
+		break;
+	case 0x8d:	/* adc l */
+		z80->a = add8(z80, z80->a, z80->l, CARRY(z80));
+		break;
+	case 0x8e:	/* adc m */
+		z80->a = add8(z80, z80->a, z80->ram[z80->hl], CARRY(z80));
+		break;
+	case 0x8f:	/* adc a */
+		z80->a = add8(z80, z80->a, z80->a, CARRY(z80));
+		break;
+	case 0x90:	/* sub b */
+		z80->a = sub8(z80, z80->a, z80->b, 0);
+		break;
+	case 0x91:	/* sub c */
+		z80->a = sub8(z80, z80->a, z80->c, 0);
+		break;
+	case 0x92:	/* sub d */
+		z80->a = sub8(z80, z80->a, z80->d, 0);
+		break;
+	case 0x93:	/* sub e */
+		z80->a = sub8(z80, z80->a, z80->e, 0);
+		break;
+	case 0x94:	/* sub h */
+		z80->a = sub8(z80, z80->a, z80->h, 0);
+		break;
+	case 0x95:	/* sub l */
+		z80->a = sub8(z80, z80->a, z80->l, 0);
+		break;
+	case 0x96:	/* sub m */
+		z80->a = sub8(z80, z80->a, z80->ram[z80->hl], 0);
+		break;
+	case 0x97:	/* sub a */
+		z80->a = sub8(z80, z80->a, z80->a, 0);
+		break;
+	case 0x98:	/* sbb b */
+		z80->a = sub8(z80, z80->a, z80->b, CARRY(z80));
+		break;
+	case 0x99:	/* sbb c */
+		z80->a = sub8(z80, z80->a, z80->c, CARRY(z80));
+		break;
+	case 0x9a:	/* sbb d */
+		z80->a = sub8(z80, z80->a, z80->d, CARRY(z80));
+		break;
+	case 0x9b:	/* sbb e */
+		z80->a = sub8(z80, z80->a, z80->e, CARRY(z80));
+		break;
+	case 0x9c:	/* sbb h */
+		z80->a = sub8(z80, z80->a, z80->h, CARRY(z80));
+		break;
+	case 0x9d:	/* sbb l */
+		z80->a = sub8(z80, z80->a, z80->l, CARRY(z80));
+		break;
+	case 0x9e:	/* sbb m */
+		z80->a = sub8(z80, z80->a, z80->ram[z80->hl], CARRY(z80));
+		break;
+	case 0x9f:	/* sbb a */
+		z80->a = sub8(z80, z80->a, z80->a, CARRY(z80));
+		break;
+	case 0xa0:	/* ana b */
+		z80->a &= z80->b;
+		logic(z80, FAC);
+		break;
+	case 0xa1:	/* ana c */
+		z80->a &= z80->c;
+		logic(z80, FAC);
+		break;
+	case 0xa2:	/* ana d */
+		z80->a &= z80->d;
+		logic(z80, FAC);
+		break;
+	case 0xa3:	/* ana e */
+		z80->a &= z80->e;
+		logic(z80, FAC);
+		break;
+	case 0xa4:	/* ana h */
+		z80->a &= z80->h;
+		logic(z80, FAC);
+		break;
+	case 0xa5:	/* ana l */
+		z80->a &= z80->l;
+		logic(z80, FAC);
+		break;
+	case 0xa6:	/* ana m */
+		z80->a &= z80->ram[z80->hl];
+		logic(z80, FAC);
+		break;
+	case 0xa7:	/* ana a */
+		z80->a &= z80->a;
+		logic(z80, FAC);
+		break;
+	case 0xa8:	/* xra b */
+		z80->a ^= z80->b;
+		logic(z80, 0);
+		break;
+	case 0xa9:	/* xra c */
+		z80->a ^= z80->c;
+		logic(z80, 0);
+		break;
+	case 0xaa:	/* xra d */
+		z80->a ^= z80->d;
+		logic(z80, 0);
+		break;
+	case 0xab:	/* xra e */
+		z80->a ^= z80->e;
+		logic(z80, 0);
+		break;
+	case 0xac:	/* xra h */
+		z80->a ^= z80->h;
+		logic(z80, 0);
+		break;
+	case 0xad:	/* xra l */
+		z80->a ^= z80->l;
+		logic(z80, 0);
+		break;
+	case 0xae:	/* xra m */
+		z80->a ^= z80->ram[z80->hl];
+		logic(z80, 0);
+		break;
+	case 0xaf:	/* xra a */
+		z80->a ^= z80->a;
+		logic(z80, 0);
+		break;
+	case 0xb0:	/* ora b */
+		z80->a |= z80->b;
+		logic(z80, 0);
+		break;
+	case 0xb1:	/* ora c */
+		z80->a |= z80->c;
+		logic(z80, 0);
+		break;
+	case 0xb2:	/* ora d */
+		z80->a |= z80->d;
+		logic(z80, 0);
+		break;
+	case 0xb3:	/* ora e */
+		z80->a |= z80->e;
+		logic(z80, 0);
+		break;
+	case 0xb4:	/* ora h */
+		z80->a |= z80->h;
+		logic(z80, 0);
+		break;
+	case 0xb5:	/* ora l */
+		z80->a |= z80->l;
+		logic(z80, 0);
+		break;
+	case 0xb6:	/* ora m */
+		z80->a |= z80->ram[z80->hl];
+		logic(z80, 0);
+		break;
+	case 0xb7:	/* ora a */
+		z80->a |= z80->a;
+		logic(z80, 0);
+		break;
+	case 0xb8:	/* cmp b */
+		sub8(z80, z80->a, z80->b, 0);
+		break;
+	case 0xb9:	/* cmp c */
+		sub8(z80, z80->a, z80->c, 0);
+		break;
+	case 0xba:	/* cmp d */
+		sub8(z80, z80->a, z80->d, 0);
+		break;
+	case 0xbb:	/* cmp e */
+		sub8(z80, z80->a, z80->e, 0);
+		break;
+	case 0xbc:	/* cmp h */
+		sub8(z80, z80->a, z80->h, 0);
+		break;
+	case 0xbd:	/* cmp l */
+		sub8(z80, z80->a, z80->l, 0);
+		break;
+	case 0xbe:	/* cmp m */
+		sub8(z80, z80->a, z80->ram[z80->hl], 0);
+		break;
+	case 0xbf:	/* cmp a */
+		sub8(z80, z80->a, z80->a, 0);
+		break;
+	case 0xc0:	/* rnz */
+		if (ZERO(z80) == 0) {
+			ret(z80);
+			TICK(6);
+		}
+		break;
+	case 0xc1:	/* pop b */
+		z80->c = z80->ram[z80->sp++];
+		z80->b = z80->ram[z80->sp++];
+		break;
+	case 0xc2:	/* jnz i16 */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		if (ZERO(z80) == 0)
+			z80->pc = sb1;
+		break;
+	case 0xc3:	/* jmp i16 */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		z80->pc = sb1;
+		break;
+	case 0xc4:	/* cnz i16 */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		if (ZERO(z80) == 0) {
+			call(z80, sb1);
+			TICK(7);
+		}
+		break;
+	case 0xc5:	/* push b */
+		z80->ram[--z80->sp] = z80->b;
+		z80->ram[--z80->sp] = z80->c;
+		break;
+	case 0xc6:	/* adi i8 */
+		z80->a = add8(z80, z80->a, z80->ram[z80->pc++], 0);
+		break;
+	case 0xc7:	/* rst 0 */
+		call(z80, 0x00);
+		break;
+	case 0xc8:	/* rz */
+		if (ZERO(z80) == 1) {
+			ret(z80);
+			TICK(6);
+		}
+		break;
+	case 0xc9:	/* ret */
+		ret(z80);
+		break;
+	case 0xca:	/* jz i16 */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		if (ZERO(z80) == 1)
+			z80->pc = sb1;
+		break;
+	case 0xcb:
+		execcb(z80);
+		break;
+	case 0xcc:	/* cz i16 */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		if (ZERO(z80) == 1) {
+			call(z80, sb1);
+			TICK(7);
+		}
+		break;
+	case 0xcd:	/* call i16 */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		call(z80, sb1);
+		break;
+	case 0xce:	/* aci i8 */
+		z80->a = add8(z80, z80->a, z80->ram[z80->pc++], CARRY(z80));
+		break;
+	case 0xcf:	/* rst 1 */
+		call(z80, 0x08);
+		break;
+	case 0xd0:	/* rnc */
+		if (CARRY(z80) == 0) {
+			ret(z80);
+			TICK(6);
+		}
+		break;
+	case 0xd1:	/* pop d */
+		z80->e = z80->ram[z80->sp++];
+		z80->d = z80->ram[z80->sp++];
+		break;
+	case 0xd2:	/* jnc i16 */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		if (CARRY(z80) == 0)
+			z80->pc = sb1;
+		break;
+	case 0xd3:	/* out i8 */
+		z80->port = z80->ram[z80->pc++];
+		z80->inout[z80->port] = z80->a;
+		break;
+	case 0xd4:	/* cnc i16 */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		if (CARRY(z80) == 0) {
+			call(z80, sb1);
+			TICK(7);
+		}
+		break;
+	case 0xd5:	/* push d */
+		z80->ram[--z80->sp] = z80->d;
+		z80->ram[--z80->sp] = z80->e;
+		break;
+	case 0xd6:	/* sui i8 */
+		z80->a = sub8(z80, z80->a, z80->ram[z80->pc++], 0);
+		break;
+	case 0xd7:	/* rst 2 */
+		call(z80, 0x10);
+		break;
+	case 0xd8:	/* rc */
+		if (CARRY(z80) == 1) {
+			ret(z80);
+			TICK(6);
+		}
+		break;
+	case 0xd9:	/* exx */
+		exx(z80);
+		break;
+	case 0xda:	/* jc i16 */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		if (CARRY(z80) == 1)
+			z80->pc = sb1;
+		break;
+	case 0xdb:	/* in i8 */
+		sb1 = z80->ram[z80->pc++];
+		if (z80->in != NULL)
+			z80->a = z80->in(z80, sb1, z80->arg);
+		else
+			z80->a = z80->inout[sb1];
+		break;
+	case 0xdc:	/* cc i16 */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		if (CARRY(z80) == 1) {
+			call(z80, sb1);
+			TICK(7);
+		}
+		break;
+	case 0xdd:
+		execxy(z80, &z80->ix);
+		break;
+	case 0xde:	/* sbi i8 */
+		z80->a = sub8(z80, z80->a, z80->ram[z80->pc++], CARRY(z80));
+		break;
+	case 0xdf:	/* rst 3 */
+		call(z80, 0x18);
+		break;
+	case 0xe0:	/* rpo */
+		if (PARITY(z80) == 0) {
+			ret(z80);
+			TICK(6);
+		}
+		break;
+	case 0xe1:	/* pop h */
+		z80->l = z80->ram[z80->sp++];
+		z80->h = z80->ram[z80->sp++];
+		break;
+	case 0xe2:	/* jpo i16 */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		if (PARITY(z80) == 0)
+			z80->pc = sb1;
+		break;
+	case 0xe3:	/* xthl */
+		sb1 = z80->hl;
+		sb2 = z80->sp + 1;
+		z80->l = z80->ram[z80->sp];
+		z80->h = z80->ram[sb2];
+		z80->ram[z80->sp] = sb1 & 0xff;
+		z80->ram[sb2] = sb1 >> 8;
+		break;
+	case 0xe4:	/* cpo i16 */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		if (PARITY(z80) == 0) {
+			call(z80, sb1);
+			TICK(7);
+		}
+		break;
+	case 0xe5:	/* push h */
+		z80->ram[--z80->sp] = z80->h;
+		z80->ram[--z80->sp] = z80->l;
+		break;
+	case 0xe6:	/* ani i8 */
+		z80->a &= z80->ram[z80->pc++];
+		logic(z80, FAC);
+		break;
+	case 0xe7:	/* rst 4 */
+		call(z80, 0x20);
+		break;
+	case 0xe8:	/* rpe */
+		if (PARITY(z80) == 1) {
+			ret(z80);
+			TICK(6);
+		}
+		break;
+	case 0xe9:	/* pchl */
+		z80->pc = z80->hl;
+		break;
+	case 0xea:	/* jpe i16 */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		if (PARITY(z80) == 1)
+			z80->pc = sb1;
+		break;
+	case 0xeb:	/* xchg */
+		sb1 = z80->de;
+		z80->de = z80->hl;
+		z80->hl = sb1;
+		break;
+	case 0xec:	/* cpe i16 */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		if (PARITY(z80) == 1) {
+			call(z80, sb1);
+			TICK(7);
+		}
+		break;
+	case 0xed:
+		execed(z80);
+		break;
+	case 0xee:	/* xri i8 */
+		z80->a ^= z80->ram[z80->pc++];
+		logic(z80, 0);
+		break;
+	case 0xef:	/* rst 5 */
+		call(z80, 0x28);
+		break;
+	case 0xf0:	/* rp */
+		if (SIGN(z80) == 0) {
+			ret(z80);
+			TICK(6);
+		}
+		break;
+	case 0xf1:	/* pop psw */
+		setf(z80, z80->ram[z80->sp++]);
+		z80->a = z80->ram[z80->sp++];
+		break;
+	case 0xf2:	/* jp i16 */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		if (SIGN(z80) == 0)
+			z80->pc = sb1;
+		break;
+	case 0xf3:	/* di */
+		z80->inte = z80->iff2 = 0;
+		break;
+	case 0xf4:	/* cp i16 */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		if (SIGN(z80) == 0) {
+			call(z80, sb1);
+			TICK(7);
+		}
+		break;
+	case 0xf5:	/* push psw */
+		flagsync(z80);
+		z80->ram[--z80->sp] = z80->a;
+		z80->ram[--z80->sp] = z80->f;
+		break;
+	case 0xf6:	/* ori i8 */
+		z80->a |= z80->ram[z80->pc++];
+		logic(z80, 0);
+		break;
+	case 0xf7:	/* rst 6 */
+		call(z80, 0x30);
+		break;
+	case 0xf8:	/* rm */
+		if (SIGN(z80) == 1) {
+			ret(z80);
+			TICK(6);
+		}
+		break;
+	case 0xf9:	/* sphl */
+		z80->sp = z80->hl;
+		break;
+	case 0xfa:	/* jm i16 */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		if (SIGN(z80) == 1)
+			z80->pc = sb1;
+		break;
+	case 0xfb:	/* ei */
+		z80->inte = z80->iff2 = 1;
+		break;
+	case 0xfc:	/* cm i16 */
+		sb1 = z80->ram[z80->pc++];
+		sb1 |= z80->ram[z80->pc++] << 8;
+		if (SIGN(z80) == 1) {
+			call(z80, sb1);
+			TICK(7);
+		}
+		break;
+	case 0xfd:
+		execxy(z80, &z80->iy);
+		break;
+	case 0xfe:	/* cpi i8 */
+		sub8(z80, z80->a, z80->ram[z80->pc++], 0);
+		break;
+	case 0xff:	/* rst 7 */
+		call(z80, 0x38);
+		break;
+	}
+
+	return 1;
+}
+
+struct z80 *
+z80new(void)
+{
+	struct z80 *z80;
+
+	if ((z80 = calloc(1, sizeof(*z80))) == NULL)
+		return NULL;
+	z80reset(z80);
+
+	return z80;
+}
+
+void
+z80free(struct z80 *z80)
+{
+
+#ifdef PROFILE
+	callsclear(&z80->calls);
+#endif
+	free(z80);
+}
+
+/*
+ * Reset the registers and the counters.  Memory and ports are left
+ * alone.
+ */
+void
+z80reset(struct z80 *z80)
+{
+
+	z80->a = 0;
+	z80->ap = 0;
+	z80->b = 0;
+	z80->bp = 0;
+	z80->c = 0;
+	z80->cp = 0;
+	z80->d = 0;
+	z80->dp = 0;
+	z80->e = 0;
+	z80->ep = 0;
+	z80->h = 0;
+	z80->hp = 0;
+	z80->l = 0;
+	z80->lp = 0;
+
+	z80->f = FZ | FP;
+	z80->fp = FZ | FP;
+
+	z80->ix = 0;
+	z80->iy = 0;
+	z80->pc = 0;
+	z80->sp = 0;
+
+	z80->i = 0;
+	z80->r = 0;
+	z80->rmark = z80->budget;
+	z80->inte = 0;
+	z80->iff2 = 0;
+	z80->im = 0;
+
+#ifdef CYCLES
+	z80->cycles = 0;
+	z80->instrs = 0;
+#endif
+
+#ifdef STATS
+	memset(z80->ops, 0, sizeof(z80->ops));
+#endif
+
+#ifdef LAZYFLAGS
+	z80->lazy = 0;
+#endif
+
+#ifdef PROFILE
+	callsclear(&z80->calls);
+#endif
+
+	z80->port = -1;
+}
+
+unsigned char *
+z80ram(struct z80 *z80)
+{
+
+	return z80->ram;
+}
+
+/*
+ * The last byte written to each port, which in reads back when there
+ * is no in handler.
+ */
+unsigned char *
+z80ports(struct z80 *z80)
+{
+
+	return z80->inout;
+}
+
+/*
+ * Nothing is cached from memory yet, so there is nothing to retire.
+ */
+void
+z80touch(struct z80 *z80, unsigned int addr, unsigned int len)
+{
+}
+
+/*
+ * Make dst a copy of src: registers, counters, memory and ports.  dst
+ * keeps its handlers.
+ */
+void
+z80copy(struct z80 *dst, const struct z80 *src)
+{
+
+	/* The registers and counters lead struct z80 */
+	memcpy(dst, src, offsetof(struct z80, budget));
+	memcpy(dst->ram, src->ram, sizeof(dst->ram));
+	memcpy(dst->inout, src->inout, sizeof(dst->inout));
+	dst->r = rreg(src);
+	dst->rmark = dst->budget;
+	dst->port = -1;
+}
+
+unsigned int
+z80get(struct z80 *z80, int reg)
+{
+
+	switch (reg) {
+	case Z80_A:
+		return z80->a;
+	case Z80_F:
+		flagsync(z80);
+		return z80->f;
+	case Z80_B:
+		return z80->b;
+	case Z80_C:
+		return z80->c;
+	case Z80_D:
+		return z80->d;
+	case Z80_E:
+		return z80->e;
+	case Z80_H:
+		return z80->h;
+	case Z80_L:
+		return z80->l;
+	case Z80_BC:
+		return z80->bc;
+	case Z80_DE:
+		return z80->de;
+	case Z80_HL:
+		return z80->hl;
+	case Z80_SP:
+		return z80->sp;
+	case Z80_PC:
+		return z80->pc;
+	case Z80_INTE:
+		return z80->inte;
+	case Z80_AFP:
+		return z80->ap << 8 | z80->fp;
+	case Z80_BCP:
+		return z80->bcp;
+	case Z80_DEP:
+		return z80->dep;
+	case Z80_HLP:
+		return z80->hlp;
+	case Z80_IX:
+		return z80->ix;
+	case Z80_IY:
+		return z80->iy;
+	case Z80_I:
+		return z80->i;
+	case Z80_R:
+		return rreg(z80);
+	case Z80_IM:
+		return z80->im;
+	}
+
+	return 0;
+}
+
+void
+z80set(struct z80 *z80, int reg, unsigned int v)
+{
+
+	switch (reg) {
+	case Z80_A:
+		z80->a = v;
+		break;
+	case Z80_F:
+		setf(z80, v);
+		break;
+	case Z80_B:
+		z80->b = v;
+		break;
+	case Z80_C:
+		z80->c = v;
+		break;
+	case Z80_D:
+		z80->d = v;
+		break;
+	case Z80_E:
+		z80->e = v;
+		break;
+	case Z80_H:
+		z80->h = v;
+		break;
+	case Z80_L:
+		z80->l = v;
+		break;
+	case Z80_BC:
+		z80->bc = v;
+		break;
+	case Z80_DE:
+		z80->de = v;
+		break;
+	case Z80_HL:
+		z80->hl = v;
+		break;
+	case Z80_SP:
+		z80->sp = v;
+		break;
+	case Z80_PC:
+		z80->pc = v;
+		break;
+	case Z80_INTE:
+		z80->inte = z80->iff2 = v != 0;
+		break;
+	case Z80_AFP:
+		z80->ap = v >> 8;
+		z80->fp = v;
+		break;
+	case Z80_BCP:
+		z80->bcp = v;
+		break;
+	case Z80_DEP:
+		z80->dep = v;
+		break;
+	case Z80_HLP:
+		z80->hlp = v;
+		break;
+	case Z80_IX:
+		z80->ix = v;
+		break;
+	case Z80_IY:
+		z80->iy = v;
+		break;
+	case Z80_I:
+		z80->i = v;
+		break;
+	case Z80_R:
+		z80->r = v;
+		z80->rmark = z80->budget;
+		break;
+	case Z80_IM:
+		z80->im = v <= 2 ? v : 0;
+		break;
+	}
+}
+
+/*
+ * Install the port handlers.  in returns the byte read from a port;
+ * without it, in reads back the last byte written there.  out is
+ * called after every out instruction and returns non-zero to make
+ * z80run() stop.  arg is passed to both.
+ */
+void
+z80io(struct z80 *z80, int (*in)(struct z80 *, int, void *),
+    int (*out)(struct z80 *, int, int, void *), void *arg)
+{
+
+	z80->in = in;
+	z80->out = out;
+	z80->arg = arg;
+}
+
+/*
+ * Run n instructions.  Returns Z80_HALT after hlt, Z80_STOP if the
+ * out handler asked for it and Z80_BUDGET otherwise.
+ */
+int
+z80run(struct z80 *z80, long long n)
+{
+	int port, ret = Z80_BUDGET;
+
+	z80->r = rreg(z80);
+	z80->budget = n;
+	z80->rmark = n;
+	while (z80->budget-- > 0) {
+		if (!execute(z80, z80->ram[z80->pc++])) {
+			ret = Z80_HALT;
+			break;
+		}
+		if (z80->port != -1) {
+			port = z80->port;
+			z80->port = -1;
+			if (z80->out != NULL &&
+			    z80->out(z80, port, z80->inout[port], z80->arg)) {
+				ret = Z80_STOP;
+				break;
+			}
+		}
+	}
+	if (z80->budget < 0)
+		z80->budget = 0;	/* For rreg() */
+
+	return ret;
+}
+
+/*
+ * Instructions and T-states run since the last reset.  Returns -1 if
+ * the counters were not built in.
+ */
+int
+z80counters(struct z80 *z80, unsigned long long *instrs,
+    unsigned long long *cycles)
+{
+
+#ifdef CYCLES
+	*instrs = z80->instrs;
+	*cycles = z80->cycles;
+
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+/*
+ * The instructions run with each opcode after prefix since the last
+ * reset, or NULL if there are no such opcodes or the counts were not
+ * built in.  prefix is 0 for none, or 0xcb, 0xdd, 0xed or 0xfd; the
+ * 0xdd and 0xfd tables count 0xdd 0xcb and 0xfd 0xcb instructions at
+ * 0xcb.
+ */
+const unsigned long long *
+z80ops(struct z80 *z80, int prefix)
+{
+
+#ifdef STATS
+	switch (prefix) {
+	case 0:
+		return z80->ops[MAIN];
+	case 0xcb:
+		return z80->ops[CB];
+	case 0xdd:
+		return z80->ops[DD];
+	case 0xed:
+		return z80->ops[ED];
+	case 0xfd:
+		return z80->ops[FD];
+	}
+#endif
+
+	return NULL;
+}
+
+/*
+ * The instructions run at each address since the last reset, or NULL
+ * if the profile was not built in.
+ */
+const unsigned long long *
+z80hits(struct z80 *z80)
+{
+
+#ifdef PROFILE
+	return z80->calls.hits;
+#else
+	return NULL;
+#endif
+}
+
+/*
+ * Call fn for every call path that ran instructions since the last
+ * reset, with the addresses called from the outermost in, how many
+ * there are and the instructions run at the end of the path itself.
+ * The path is empty for code run outside of any call.  Returns -1 if
+ * the profile was not built in.
+ */
+int
+z80calls(struct z80 *z80,
+    void (*fn)(const unsigned short *, int, unsigned long long, void *),
+    void *arg)
+{
+#ifdef PROFILE
+	uint16_t path[CALLDEPTH] = { 0 };
+
+	callswalk(&z80->calls.root, path, 0, fn, arg);
+
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+/*
+ * Start a trace of the instructions run from here on, in the format
+ * described in trace.h, handing it to fn a piece at a time.  With fn
+ * NULL, end the trace and hand over the rest.  Returns -1 if tracing
+ * was not built in.
+ */
+int
+z80trace(struct z80 *z80,
+    void (*fn)(void *, const unsigned char *, size_t), void *arg)
+{
+#ifdef TRACE
+	uint16_t regs[TRACE_NREGS];
+
+	traceregs(z80, regs);
+	if (fn != NULL)
+		recordstart(&z80->rec, "Z80T", regs, TRACE_NREGS, z80->pc,
+		    fn, arg);
+	else if (z80->rec.fn != NULL)
+		recordend(&z80->rec, regs);
+
+	return 0;
+#else
+	return -1;
+#endif
+}
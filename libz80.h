@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * libz80: a Z80 with 64K of memory and 256 ports.  Machines share
+ * nothing, so any number can live in one process, one thread at a time
+ * each.  Whoever writes to z80ram() directly must call z80touch() for
+ * the bytes written.
+ */
+
+struct z80;
+
+/* Registers for z80get() and z80set() */
+#define Z80_A		0
+#define Z80_F		1
+#define Z80_B		2
+#define Z80_C		3
+#define Z80_D		4
+#define Z80_E		5
+#define Z80_H		6
+#define Z80_L		7
+#define Z80_BC		8
+#define Z80_DE		9
+#define Z80_HL		10
+#define Z80_SP		11
+#define Z80_PC		12
+#define Z80_INTE	13
+#define Z80_AFP		14	/* The primed set */
+#define Z80_BCP		15
+#define Z80_DEP		16
+#define Z80_HLP		17
+#define Z80_IX		18
+#define Z80_IY		19
+#define Z80_I		20
+#define Z80_R		21
+#define Z80_IM		22	/* Interrupt mode */
+
+/* Why z80run() returned */
+#define Z80_HALT	0	/* hlt */
+#define Z80_STOP	1	/* The out handler asked to stop */
+#define Z80_BUDGET	2	/* The instructions asked for have run */
+
+struct z80	*z80new(void);
+void		 z80free(struct z80 *);
+void		 z80reset(struct z80 *);
+void		 z80copy(struct z80 *, const struct z80 *);
+unsigned char	*z80ram(struct z80 *);
+unsigned char	*z80ports(struct z80 *);
+void		 z80touch(struct z80 *, unsigned int, unsigned int);
+unsigned int	 z80get(struct z80 *, int);
+void		 z80set(struct z80 *, int, unsigned int);
+void		 z80io(struct z80 *, int (*)(struct z80 *, int, void *),
+		    int (*)(struct z80 *, int, int, void *), void *);
+int		 z80run(struct z80 *, long long);
+int		 z80counters(struct z80 *, unsigned long long *,
+		    unsigned long long *);
+const unsigned long long *z80ops(struct z80 *, int);
+const unsigned long long *z80hits(struct z80 *);
+int		 z80calls(struct z80 *, void (*)(const unsigned short *, int,
+		    unsigned long long, void *), void *);
+int		 z80trace(struct z80 *, void (*)(void *, const unsigned char *,
+		    size_t), void *);
@@ -0,0 +1,388 @@
+/*
+ * Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Reports from the execution profile the cores keep with -DPROFILE:
+ * the addresses and the runs of instructions that ran the most, and
+ * the call paths folded one to a line for flame graph tools:
+ *
+ *	PROG.COM;main;print 1234
+ *
+ * Names come from a symbol file, either a .SYM file of address and
+ * name pairs as written by LINK-80, L80 and ZSID:
+ *
+ *	0100 START   0103 LOOP
+ *
+ * or a .PRN listing, where a line that starts with an address and has
+ * a label ending in a colon after the object bytes names that address.
+ * Addresses without a name are given in hex, or as the nearest name
+ * below and an offset.
+ */
+
+#include <ctype.h>
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "profile.h"
+
+#define NTOP		25	/* Lines in each table of the report */
+#define MAXLEN		4	/* The longest instruction, in bytes */
+
+struct sym {
+	unsigned int	 addr;
+	char		*name;
+};
+
+/* A run of instructions that all ran the same number of times */
+struct run {
+	unsigned int		start, end;
+	unsigned int		insns;
+	unsigned long long	count;
+};
+
+struct profile {
+	char		*top;		/* Name for code outside any call */
+	struct sym	*syms;		/* By address */
+	size_t		 nsyms, size;
+	char		 name[64];	/* The last name looked up */
+};
+
+struct profile *
+profnew(const char *top)
+{
+	struct profile *p;
+
+	if ((p = calloc(1, sizeof(*p))) == NULL)
+		return NULL;
+	if ((p->top = strdup(top)) == NULL) {
+		free(p);
+		return NULL;
+	}
+
+	return p;
+}
+
+void
+proffree(struct profile *p)
+{
+	size_t i;
+
+	for (i = 0; i < p->nsyms; i++)
+		free(p->syms[i].name);
+	free(p->syms);
+	free(p->top);
+	free(p);
+}
+
+/*
+ * Whether s is a 16-bit address in hex, after dropping the marks M80
+ * puts after relocatable and external values.
+ */
+static int
+ishex(char *s, unsigned int *addr)
+{
+	size_t len;
+
+	len = strlen(s);
+	while (len > 0 && strchr("'\"*", s[len - 1]) != NULL)
+		s[--len] = '\0';
+	if (len == 0 || len > 4 || strspn(s, "0123456789ABCDEFabcdef") != len)
+		return 0;
+	if (addr != NULL)
+		*addr = strtoul(s, NULL, 16);
+
+	return 1;
+}
+
+static int
+isname(const char *s, size_t len)
+{
+	size_t i;
+
+	if (len == 0 || !(isalpha((unsigned char) s[0]) ||
+	    strchr("?@_.$", s[0]) != NULL))
+		return 0;
+	for (i = 1; i < len; i++) {
+		if (!isalnum((unsigned char) s[i]) &&
+		    strchr("?@_.$", s[i]) == NULL)
+			return 0;
+	}
+
+	return 1;
+}
+
+static int
+addsym(struct profile *p, unsigned int addr, const char *name, size_t len)
+{
+	struct sym *syms;
+	size_t size;
+
+	if (p->nsyms == p->size) {
+		size = p->size == 0 ? 256 : p->size * 2;
+		if ((syms = reallocarray(p->syms, size,
+		    sizeof(*syms))) == NULL)
+			return -1;
+		p->syms = syms;
+		p->size = size;
+	}
+	if ((p->syms[p->nsyms].name = strndup(name, len)) == NULL)
+		return -1;
+	p->syms[p->nsyms++].addr = addr;
+
+	return 0;
+}
+
+/*
+ * The label on a line of a listing: the first word after the address
+ * and the object bytes, if it ends in a colon.
+ */
+static int
+prnline(struct profile *p, char *line)
+{
+	unsigned int addr;
+	char *s, *colon;
+
+	if ((s = strtok(line, " \t\r\n\f\032")) == NULL || !ishex(s, &addr))
+		return 0;
+	while ((s = strtok(NULL, " \t\r\n\f\032")) != NULL) {
+		if (strcmp(s, "=") == 0)
+			return 0;	/* An equate, not code */
+		if (!ishex(s, NULL))
+			break;
+	}
+	if (s == NULL || (colon = strchr(s, ':')) == NULL ||
+	    !isname(s, colon - s))
+		return 0;
+
+	return addsym(p, addr, s, colon - s);
+}
+
+static int
+symline(struct profile *p, char *line)
+{
+	unsigned int addr;
+	char *s;
+
+	s = strtok(line, " \t\r\n\f\032");
+	while (s != NULL) {
+		if (!ishex(s, &addr)) {
+			s = strtok(NULL, " \t\r\n\f\032");
+			continue;
+		}
+		if ((s = strtok(NULL, " \t\r\n\f\032")) == NULL)
+			break;
+		if (isname(s, strlen(s)) && addsym(p, addr, s, strlen(s)) == -1)
+			return -1;
+		s = strtok(NULL, " \t\r\n\f\032");
+	}
+
+	return 0;
+}
+
+static int
+symcmp(const void *a, const void *b)
+{
+	const struct sym *x = a, *y = b;
+
+	if (x->addr != y->addr)
+		return x->addr < y->addr ? -1 : 1;
+
+	return strcmp(x->name, y->name);
+}
+
+/*
+ * Load the names in a .SYM file, or a listing if the name ends in .PRN.
+ */
+int
+profsyms(struct profile *p, const char *path)
+{
+	FILE *fp;
+	char *line = NULL;
+	size_t len, size = 0;
+	int prn, ret = 0;
+
+	if ((fp = fopen(path, "r")) == NULL) {
+		warn("%s", path);
+		return -1;
+	}
+	len = strlen(path);
+	prn = len >= 4 && strcasecmp(path + len - 4, ".prn") == 0;
+	while (ret == 0 && getline(&line, &size, fp) != -1) {
+		ret = prn ? prnline(p, line) : symline(p, line);
+		if (ret == -1)
+			warn(NULL);
+	}
+	if (ret == 0 && ferror(fp)) {
+		warn("%s", path);
+		ret = -1;
+	}
+	free(line);
+	fclose(fp);
+	qsort(p->syms, p->nsyms, sizeof(*p->syms), symcmp);
+
+	return ret;
+}
+
+/*
+ * The name of addr: the nearest symbol at or below it, plus the
+ * distance if any, or the address in hex.
+ */
+static const char *
+symname(struct profile *p, unsigned int addr)
+{
+	size_t lo = 0, hi = p->nsyms, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (p->syms[mid].addr <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == 0)
+		snprintf(p->name, sizeof(p->name), "0x%04x", addr);
+	else if (p->syms[lo - 1].addr == addr)
+		snprintf(p->name, sizeof(p->name), "%s", p->syms[lo - 1].name);
+	else
+		snprintf(p->name, sizeof(p->name), "%s+0x%x",
+		    p->syms[lo - 1].name, addr - p->syms[lo - 1].addr);
+
+	return p->name;
+}
+
+static const unsigned long long *sorthits;
+
+static int
+hitcmp(const void *a, const void *b)
+{
+	unsigned int x = *(const unsigned int *) a;
+	unsigned int y = *(const unsigned int *) b;
+
+	if (sorthits[x] != sorthits[y])
+		return sorthits[x] > sorthits[y] ? -1 : 1;
+
+	return x < y ? -1 : 1;
+}
+
+static int
+runcmp(const void *a, const void *b)
+{
+	const struct run *x = a, *y = b;
+	unsigned long long wx = x->count * x->insns, wy = y->count * y->insns;
+
+	if (wx != wy)
+		return wx > wy ? -1 : 1;
+
+	return x->start < y->start ? -1 : 1;
+}
+
+/*
+ * Write the report to path: the addresses that ran the most
+ * instructions, then the runs of them.  A run is a stretch of code
+ * whose instructions all ran the same number of times, with no more
+ * than operand bytes between them, which is a basic block or a few
+ * that always run together.
+ */
+int
+profreport(struct profile *p, const char *path,
+    const unsigned long long *hits)
+{
+	unsigned long long total = 0;
+	unsigned int *addrs, addr, i, n = 0, nruns = 0;
+	struct run *runs, *r = NULL;
+	FILE *fp;
+	int ret = 0;
+
+	if ((addrs = calloc(0x10000, sizeof(*addrs))) == NULL ||
+	    (runs = calloc(0x10000, sizeof(*runs))) == NULL) {
+		free(addrs);
+		warn(NULL);
+		return -1;
+	}
+	for (addr = 0; addr < 0x10000; addr++) {
+		if (hits[addr] == 0)
+			continue;
+		total += hits[addr];
+		addrs[n++] = addr;
+		if (r == NULL || hits[addr] != r->count ||
+		    addr - r->end > MAXLEN) {
+			r = &runs[nruns++];
+			r->start = addr;
+			r->count = hits[addr];
+		}
+		r->end = addr;
+		r->insns++;
+	}
+	sorthits = hits;
+	qsort(addrs, n, sizeof(*addrs), hitcmp);
+	qsort(runs, nruns, sizeof(*runs), runcmp);
+
+	if ((fp = fopen(path, "w")) == NULL) {
+		warn("%s", path);
+		ret = -1;
+		goto done;
+	}
+	fprintf(fp, "%llu instructions\n\n", total);
+
+	fprintf(fp, "Hot addresses\n%14s %7s  %-9s  %s\n",
+	    "count", "%", "address", "name");
+	for (i = 0; i < n && i < NTOP; i++) {
+		fprintf(fp, "%14llu %7.2f  %04x       %s\n", hits[addrs[i]],
+		    100.0 * hits[addrs[i]] / total, addrs[i],
+		    symname(p, addrs[i]));
+	}
+
+	fprintf(fp, "\nHot blocks\n%14s %7s %6s  %-9s  %s\n",
+	    "runs", "%", "insns", "addresses", "name");
+	for (i = 0; i < nruns && i < NTOP; i++) {
+		fprintf(fp, "%14llu %7.2f %6u  %04x-%04x  %s\n",
+		    runs[i].count,
+		    100.0 * runs[i].count * runs[i].insns / total,
+		    runs[i].insns, runs[i].start, runs[i].end,
+		    symname(p, runs[i].start));
+	}
+
+	if (ferror(fp))
+		ret = -1;
+	if (fclose(fp) == EOF)
+		ret = -1;
+	if (ret == -1)
+		warn("%s", path);
+done:
+	free(addrs);
+	free(runs);
+
+	return ret;
+}
+
+/*
+ * Write one call path with the instructions run at its end, as a line
+ * of folded stacks.
+ */
+void
+proffold(struct profile *p, FILE *fp, const unsigned short *path, int depth,
+    unsigned long long count)
+{
+	int i;
+
+	fputs(p->top, fp);
+	for (i = 0; i < depth; i++)
+		fprintf(fp, ";%s", symname(p, path[i]));
+	fprintf(fp, " %llu\n", count);
+}
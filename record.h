@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Trace recording shared by the i80 and z80 cores for -DTRACE, in the
+ * format described in trace.h.  Records are put together in buf and
+ * handed to fn whenever it is nearly full, so recording an instruction
+ * costs a few compares and stores.
+ */
+
+#define RECORDSIZE	65536	/* Bytes handed over at a time */
+#define RECORDMAX	64	/* The longest record */
+
+struct record {
+	void		 (*fn)(void *, const unsigned char *, size_t);
+	void		  *arg;		/* Recording while fn is set */
+	int		   nregs;
+	uint16_t	   pc;		/* As last recorded */
+	uint16_t	   regs[TRACE_NREGS];
+	unsigned char	   code[0x10000];	/* Memory as shown so far */
+	size_t		   len;
+	unsigned char	   buf[RECORDSIZE];
+};
+
+static unsigned char *
+putvarint(unsigned char *p, unsigned int v)
+{
+
+	while (v >= 0x80) {
+		*p++ = v | 0x80;
+		v >>= 7;
+	}
+	*p++ = v;
+
+	return p;
+}
+
+static unsigned int
+zigzag(int v)
+{
+
+	return v >= 0 ? (unsigned int) v * 2 : (unsigned int) -v * 2 - 1;
+}
+
+static void
+recordflush(struct record *r)
+{
+
+	if (r->len > 0)
+		r->fn(r->arg, r->buf, r->len);
+	r->len = 0;
+}
+
+/*
+ * Start the trace with its header.
+ */
+static void
+recordstart(struct record *r, const char *magic, const uint16_t *regs,
+    int nregs, uint16_t pc, void (*fn)(void *, const unsigned char *,
+    size_t), void *arg)
+{
+	unsigned char *p = r->buf;
+	int i;
+
+	r->fn = fn;
+	r->arg = arg;
+	r->nregs = nregs;
+	r->pc = pc;
+	memcpy(r->regs, regs, nregs * sizeof(*regs));
+	memset(r->code, 0, sizeof(r->code));
+
+	memcpy(p, magic, 4);
+	p[4] = TRACE_VERSION;
+	p[5] = nregs;
+	p += 6;
+	for (i = 0; i < nregs; i++) {
+		*p++ = regs[i] & 0xff;
+		*p++ = regs[i] >> 8;
+	}
+	*p++ = pc & 0xff;
+	*p++ = pc >> 8;
+	r->len = p - r->buf;
+}
+
+/*
+ * The head of a record, then the registers that changed since the last.
+ */
+static unsigned char *
+recordregs(struct record *r, unsigned char *p, unsigned int flags,
+    const uint16_t *regs, unsigned int *mask)
+{
+	int i;
+
+	*mask = 0;
+	for (i = 0; i < r->nregs; i++) {
+		if (regs[i] != r->regs[i])
+			*mask |= 1 << i;
+	}
+	return putvarint(p, *mask << 2 | flags);
+}
+
+static unsigned char *
+recordvals(struct record *r, unsigned char *p, const uint16_t *regs,
+    unsigned int mask)
+{
+	int i;
+
+	for (i = 0; mask != 0; i++, mask >>= 1) {
+		if ((mask & 1) == 0)
+			continue;
+		if (i == TRACE_A || i == TRACE_F)
+			*p++ = regs[i];
+		else
+			p = putvarint(p,
+			    zigzag((int16_t) (regs[i] - r->regs[i])));
+		r->regs[i] = regs[i];
+	}
+
+	return p;
+}
+
+/*
+ * The instruction at pc is about to run, with the registers at regs.
+ */
+static void
+recordinsn(struct record *r, uint16_t pc, const unsigned char *ram,
+    const uint16_t *regs)
+{
+	unsigned char *p = r->buf + r->len;
+	unsigned int flags = 0, i, mask;
+
+	if (pc <= 0x10000 - 4) {
+		if (memcmp(&r->code[pc], &ram[pc], 4) != 0)
+			flags = TRACE_CODE;
+	} else {
+		for (i = 0; i < 4; i++) {
+			if (r->code[(uint16_t) (pc + i)] !=
+			    ram[(uint16_t) (pc + i)])
+				flags = TRACE_CODE;
+		}
+	}
+
+	p = recordregs(r, p, flags, regs, &mask);
+	p = putvarint(p, zigzag((int16_t) (pc - r->pc)));
+	r->pc = pc;
+	if (flags & TRACE_CODE) {
+		for (i = 0; i < 4; i++) {
+			*p++ = r->code[(uint16_t) (pc + i)] =
+			    ram[(uint16_t) (pc + i)];
+		}
+	}
+	p = recordvals(r, p, regs, mask);
+
+	r->len = p - r->buf;
+	if (r->len > RECORDSIZE - RECORDMAX)
+		recordflush(r);
+}
+
+/*
+ * End the trace with the last changes, and hand over the rest.
+ */
+static void
+recordend(struct record *r, const uint16_t *regs)
+{
+	unsigned char *p = r->buf + r->len;
+	unsigned int mask;
+
+	p = recordregs(r, p, TRACE_END, regs, &mask);
+	p = recordvals(r, p, regs, mask);
+	r->len = p - r->buf;
+	recordflush(r);
+	r->fn = NULL;
+}
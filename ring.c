@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ring.h"
+
+/*
+ * One thread puts bytes in at head and the writer takes them out at
+ * tail.  Both only ever grow, and the bytes between them are waiting
+ * to be written, so the writer owns [tail, head) and the one putting
+ * owns the rest without holding the lock while copying.
+ */
+struct ring {
+	unsigned char	*buf;
+	size_t		 size;
+	size_t		 head;
+	size_t		 tail;
+	int		 fd;
+	int		 done;		/* Nothing more will be put */
+	int		 error;		/* errno of the first failed write */
+	pthread_mutex_t	 lock;
+	pthread_cond_t	 more;		/* For the writer */
+	pthread_cond_t	 room;		/* For the one putting */
+	pthread_t	 thread;
+};
+
+static void *
+writer(void *arg)
+{
+	struct ring *r = arg;
+	const unsigned char *p;
+	size_t left, n;
+	ssize_t w;
+
+	pthread_mutex_lock(&r->lock);
+	for (;;) {
+		while (r->head == r->tail && !r->done)
+			pthread_cond_wait(&r->more, &r->lock);
+		if (r->head == r->tail)
+			break;
+		p = r->buf + r->tail % r->size;
+		n = r->head - r->tail;
+		if (n > (size_t) (r->buf + r->size - p))
+			n = r->buf + r->size - p;
+		pthread_mutex_unlock(&r->lock);
+
+		/* After a failed write, the rest is thrown away */
+		for (left = n; left > 0 && r->error == 0; ) {
+			if ((w = write(r->fd, p, left)) == -1) {
+				if (errno != EINTR)
+					r->error = errno;
+				continue;
+			}
+			p += w;
+			left -= w;
+		}
+
+		pthread_mutex_lock(&r->lock);
+		r->tail += n;
+		pthread_cond_signal(&r->room);
+	}
+	pthread_mutex_unlock(&r->lock);
+
+	return NULL;
+}
+
+/*
+ * A ring of size bytes writing to a new file at path.  Returns NULL
+ * with errno set on failure.
+ */
+struct ring *
+ringnew(const char *path, size_t size)
+{
+	struct ring *r;
+	int e;
+
+	if ((r = calloc(1, sizeof(*r))) == NULL)
+		return NULL;
+	if ((r->buf = malloc(size)) == NULL)
+		goto fail;
+	r->size = size;
+	if ((r->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666)) == -1)
+		goto fail;
+	pthread_mutex_init(&r->lock, NULL);
+	pthread_cond_init(&r->more, NULL);
+	pthread_cond_init(&r->room, NULL);
+	if ((e = pthread_create(&r->thread, NULL, writer, r)) != 0) {
+		close(r->fd);
+		errno = e;
+		goto fail;
+	}
+
+	return r;
+
+fail:
+	e = errno;
+	free(r->buf);
+	free(r);
+	errno = e;
+	return NULL;
+}
+
+/*
+ * Add len bytes to the ring, waiting for room as needed.  Takes the
+ * ring as a void * to serve as the callback for i80trace().
+ */
+void
+ringput(void *arg, const unsigned char *p, size_t len)
+{
+	struct ring *r = arg;
+	size_t avail, head, n, off;
+
+	while (len > 0) {
+		pthread_mutex_lock(&r->lock);
+		while ((avail = r->size - (r->head - r->tail)) == 0)
+			pthread_cond_wait(&r->room, &r->lock);
+		head = r->head;
+		pthread_mutex_unlock(&r->lock);
+
+		off = head % r->size;
+		n = len < avail ? len : avail;
+		if (n > r->size - off)
+			n = r->size - off;
+		memcpy(r->buf + off, p, n);
+		p += n;
+		len -= n;
+
+		pthread_mutex_lock(&r->lock);
+		r->head += n;
+		pthread_cond_signal(&r->more);
+		pthread_mutex_unlock(&r->lock);
+	}
+}
+
+/*
+ * Write out what is left and close the file.  Returns -1 with errno
+ * set if anything could not be written.
+ */
+int
+ringclose(struct ring *r)
+{
+	int e;
+
+	pthread_mutex_lock(&r->lock);
+	r->done = 1;
+	pthread_cond_signal(&r->more);
+	pthread_mutex_unlock(&r->lock);
+	pthread_join(r->thread, NULL);
+
+	e = r->error;
+	if (close(r->fd) == -1 && e == 0)
+		e = errno;
+	pthread_mutex_destroy(&r->lock);
+	pthread_cond_destroy(&r->more);
+	pthread_cond_destroy(&r->room);
+	free(r->buf);
+	free(r);
+
+	if (e != 0) {
+		errno = e;
+		return -1;
+	}
+	return 0;
+}
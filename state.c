@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Saved machine state.  A state file is a header and a list of chunks:
+ *
+ *	magic[4] version[1] flags[1]
+ *	tag[4] length[4] data[length]
+ *	...
+ *
+ * Numbers are little-endian.  The magic names the CPU, so one emulator
+ * never loads the other's state.  Readers skip chunks they do not know
+ * and fail on versions newer than their own, so chunks can be added
+ * without a version change while changing one needs a new version.
+ *
+ * Memory is kept in the "MEM " chunk as 256-byte pages, each run of
+ * pages behind a count byte: 0x00-0x7f stands for that many plus one
+ * pages of zeros, 0x80-0xff for that many less 0x7f literal pages that
+ * follow.  A program in a mostly empty 64K then costs little more than
+ * its own size.
+ *
+ * Files are written under a temporary name and renamed into place, so
+ * an interrupted save leaves the old state intact.
+ */
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "state.h"
+
+#define PAGE		256
+#define NPAGES		(0x10000 / PAGE)
+#define MAXRUN		128
+
+struct state {
+	FILE		*fp;
+	char		*path;
+	char		*tmp;
+	unsigned char	*buf;		/* The whole file, when reading */
+	size_t		 len;
+};
+
+static void
+put32(unsigned char *p, size_t v)
+{
+
+	p[0] = v & 0xff;
+	p[1] = (v >> 8) & 0xff;
+	p[2] = (v >> 16) & 0xff;
+	p[3] = (v >> 24) & 0xff;
+}
+
+static size_t
+get32(const unsigned char *p)
+{
+
+	return p[0] | p[1] << 8 | p[2] << 16 | (size_t) p[3] << 24;
+}
+
+/*
+ * Start writing the state file path for the CPU named by magic.
+ */
+struct state *
+statecreate(const char *path, const char *magic, int flags)
+{
+	unsigned char head[6];
+	struct state *st;
+	size_t len = strlen(path) + sizeof(".XXXXXXXXXX");
+	int fd;
+
+	if ((st = calloc(1, sizeof(*st))) == NULL ||
+	    (st->path = strdup(path)) == NULL ||
+	    (st->tmp = malloc(len)) == NULL)
+		err(1, NULL);
+	snprintf(st->tmp, len, "%s.XXXXXXXXXX", path);
+	if ((fd = mkstemp(st->tmp)) == -1) {
+		warn("%s", st->tmp);
+		statefree(st);
+		return NULL;
+	}
+	if ((st->fp = fdopen(fd, "w")) == NULL)
+		err(1, NULL);
+
+	memcpy(head, magic, 4);
+	head[4] = STATE_VERSION;
+	head[5] = flags;
+	fwrite(head, 1, sizeof(head), st->fp);
+
+	return st;
+}
+
+void
+stateput(struct state *st, const char *tag, const void *data, size_t len)
+{
+	unsigned char head[8];
+
+	memcpy(head, tag, 4);
+	put32(&head[4], len);
+	fwrite(head, 1, sizeof(head), st->fp);
+	fwrite(data, 1, len, st->fp);
+}
+
+static int
+zeropage(const unsigned char *p)
+{
+	int i;
+
+	for (i = 0; i < PAGE; i++) {
+		if (p[i] != 0)
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Write the 64K memory image ram as the "MEM " chunk.
+ */
+void
+stateputmem(struct state *st, const unsigned char *ram)
+{
+	unsigned char *buf, *p;
+	int n, page, zero;
+
+	/* At worst, every page literal with a count byte of its own */
+	if ((p = buf = malloc(0x10000 + NPAGES)) == NULL)
+		err(1, NULL);
+	for (page = 0; page < NPAGES; page += n) {
+		zero = zeropage(&ram[page * PAGE]);
+		for (n = 1; page + n < NPAGES && n < MAXRUN; n++) {
+			if (zeropage(&ram[(page + n) * PAGE]) != zero)
+				break;
+		}
+		if (zero)
+			*p++ = n - 1;
+		else {
+			*p++ = 0x7f + n;
+			memcpy(p, &ram[page * PAGE], n * PAGE);
+			p += n * PAGE;
+		}
+	}
+	stateput(st, "MEM ", buf, p - buf);
+	free(buf);
+}
+
+/*
+ * Finish writing and move the file into place.  Returns -1 on failure,
+ * leaving any earlier file at the path alone.
+ */
+int
+stateclose(struct state *st)
+{
+	int ret = 0;
+
+	if (fflush(st->fp) == EOF || ferror(st->fp) ||
+	    fsync(fileno(st->fp)) == -1) {
+		warn("%s", st->tmp);
+		ret = -1;
+	}
+	if (fclose(st->fp) == EOF && ret == 0) {
+		warn("%s", st->tmp);
+		ret = -1;
+	}
+	st->fp = NULL;
+	if (ret == 0 && rename(st->tmp, st->path) == -1) {
+		warn("%s", st->path);
+		ret = -1;
+	}
+	if (ret == -1)
+		unlink(st->tmp);
+	statefree(st);
+
+	return ret;
+}
+
+/*
+ * Read the state file at path, which must be for the CPU named by
+ * magic, and put its header flags in flags.
+ */
+struct state *
+stateopen(const char *path, const char *magic, int *flags)
+{
+	struct state *st;
+	size_t n, size = 0;
+	FILE *fp;
+
+	if ((fp = fopen(path, "r")) == NULL) {
+		warn("%s", path);
+		return NULL;
+	}
+	if ((st = calloc(1, sizeof(*st))) == NULL)
+		err(1, NULL);
+	do {
+		if (st->len == size) {
+			size = size ? size * 2 : 0x12000;
+			if ((st->buf = realloc(st->buf, size)) == NULL)
+				err(1, NULL);
+		}
+		n = fread(&st->buf[st->len], 1, size - st->len, fp);
+		st->len += n;
+	} while (n > 0);
+	if (ferror(fp)) {
+		warn("%s", path);
+		goto bad;
+	}
+	fclose(fp);
+	fp = NULL;
+
+	if (st->len < 6 || memcmp(st->buf, magic, 4) != 0) {
+		warnx("%s: not a state file for this CPU", path);
+		goto bad;
+	}
+	if (st->buf[4] > STATE_VERSION) {
+		warnx("%s: state version %d is newer than %d", path,
+		    st->buf[4], STATE_VERSION);
+		goto bad;
+	}
+	*flags = st->buf[5];
+
+	return st;
+
+bad:
+	if (fp != NULL)
+		fclose(fp);
+	statefree(st);
+
+	return NULL;
+}
+
+/*
+ * Find the chunk tag and put its length in len.  Returns NULL if there
+ * is none.
+ */
+const void *
+stateget(struct state *st, const char *tag, size_t *len)
+{
+	size_t n, off = 6;
+
+	while (off + 8 <= st->len) {
+		n = get32(&st->buf[off + 4]);
+		if (n > st->len - off - 8)
+			break;
+		if (memcmp(&st->buf[off], tag, 4) == 0) {
+			*len = n;
+			return &st->buf[off + 8];
+		}
+		off += 8 + n;
+	}
+
+	return NULL;
+}
+
+/*
+ * Fill ram from the "MEM " chunk.  Returns -1 if it is missing or bad.
+ */
+int
+stategetmem(struct state *st, unsigned char *ram)
+{
+	const unsigned char *p, *end;
+	size_t len;
+	int n, page;
+
+	if ((p = stateget(st, "MEM ", &len)) == NULL)
+		return -1;
+	end = p + len;
+	for (page = 0; page < NPAGES; page += n) {
+		if (p == end)
+			return -1;
+		if (*p < 0x80) {
+			n = *p++ + 1;
+			if (page + n > NPAGES)
+				return -1;
+			memset(&ram[page * PAGE], 0, n * PAGE);
+		} else {
+			n = *p++ - 0x7f;
+			if (page + n > NPAGES || end - p < n * PAGE)
+				return -1;
+			memcpy(&ram[page * PAGE], p, n * PAGE);
+			p += n * PAGE;
+		}
+	}
+
+	return p == end ? 0 : -1;
+}
+
+void
+statefree(struct state *st)
+{
+
+	if (st->fp != NULL) {
+		fclose(st->fp);
+		unlink(st->tmp);
+	}
+	free(st->path);
+	free(st->tmp);
+	free(st->buf);
+	free(st);
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define STATE_VERSION	1
+
+/* Header flags */
+#define STATE_INCALL	0x1	/* Stopped inside a CP/M call */
+
+struct state;
+
+struct state	*statecreate(const char *, const char *, int);
+void		 stateput(struct state *, const char *, const void *, size_t);
+void		 stateputmem(struct state *, const unsigned char *);
+int		 stateclose(struct state *);
+struct state	*stateopen(const char *, const char *, int *);
+const void	*stateget(struct state *, const char *, size_t *);
+int		 stategetmem(struct state *, unsigned char *);
+void		 statefree(struct state *);
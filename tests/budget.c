@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Check that i80run() runs the instructions it is asked to, whichever
+ * engine libi80.c was built with, and that z80run() does, when built
+ * with -DZ80.  Needs -DCYCLES for the instruction counter.  Where the
+ * translator works, also check that i80free() hands it on.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef Z80
+#include "libz80.h"
+#define i80		z80
+#define i80new		z80new
+#define i80free		z80free
+#define i80ram		z80ram
+#define i80touch	z80touch
+#define i80io		z80io
+#define i80run		z80run
+#define i80counters	z80counters
+#define i80get		z80get
+#define I80_HALT	Z80_HALT
+#define I80_BUDGET	Z80_BUDGET
+static const int regs[] = {
+	Z80_A, Z80_F, Z80_BC, Z80_DE, Z80_HL, Z80_SP, Z80_PC
+};
+#else
+#include "libi80.h"
+static const int regs[] = {
+	I80_A, I80_F, I80_BC, I80_DE, I80_HL, I80_SP, I80_PC
+};
+#endif
+#define NREGS	(sizeof(regs) / sizeof(regs[0]))
+
+#ifdef BLOCKS
+#define SLACK	32	/* A block is run to its end */
+#else
+#define SLACK	0
+#endif
+
+static int failed;
+
+static int
+out(struct i80 *m, int port, int val, void *arg)
+{
+
+	return 0;
+}
+
+static struct i80 *
+load(const unsigned char *code, size_t len)
+{
+	struct i80 *m;
+
+	if ((m = i80new()) == NULL) {
+		perror(NULL);
+		exit(1);
+	}
+	memcpy(i80ram(m), code, len);
+	i80touch(m, 0, len);
+	i80io(m, NULL, out, NULL);
+
+	return m;
+}
+
+static unsigned long long
+instrs(struct i80 *m)
+{
+	unsigned long long n, cycles;
+
+	if (i80counters(m, &n, &cycles) == -1) {
+		fprintf(stderr, "needs a build with -DCYCLES\n");
+		exit(1);
+	}
+
+	return n;
+}
+
+/*
+ * out 0; jmp 0 goes back to i80run() every other instruction, and every
+ * instruction counts against the budget.
+ */
+static void
+outloop(void)
+{
+	static const unsigned char code[] = { 0xd3, 0x00, 0xc3, 0x00, 0x00 };
+	struct i80 *m;
+	unsigned long long n;
+	long long budget;
+
+	for (budget = 1; budget <= 1000; budget++) {
+		m = load(code, sizeof(code));
+		i80run(m, budget);
+		if ((n = instrs(m)) != (unsigned long long) budget) {
+			printf("out loop: %lld asked, %llu run\n", budget, n);
+			failed = 1;
+		}
+		i80free(m);
+	}
+}
+
+/*
+ * A copy loop that i80 runs in bulk, stopped at every point along the
+ * way: the bulk passes have to stay within the budget and leave the
+ * machine as running it a pass at a time does.
+ */
+static void
+copyloop(void)
+{
+	static const unsigned char code[] = {
+		0x21, 0x00, 0x10,	/* lxi h,1000h */
+		0x11, 0x00, 0x20,	/* lxi d,2000h */
+		0x01, 0x00, 0x01,	/* lxi b,0100h */
+		0x7e,			/* mov a,m */
+		0x12,			/* stax d */
+		0x23,			/* inx h */
+		0x13,			/* inx d */
+		0x0b,			/* dcx b */
+		0x78,			/* mov a,b */
+		0xb1,			/* ora c */
+		0xc2, 0x09, 0x00,	/* jnz 0009h */
+		0x76			/* hlt */
+	};
+	struct i80 *m, *ref;
+	unsigned long long n;
+	long long budget;
+	size_t i;
+	int ret;
+
+	for (budget = 1; budget <= 2100; budget++) {
+		m = load(code, sizeof(code));
+		ref = load(code, sizeof(code));
+		for (i = 0; i < 0x100; i++)
+			i80ram(m)[0x1000 + i] = i80ram(ref)[0x1000 + i] = i;
+		i80touch(m, 0x1000, 0x100);
+		i80touch(ref, 0x1000, 0x100);
+
+		ret = i80run(m, budget);
+		n = instrs(m);
+		if (ret == I80_BUDGET ? n < (unsigned long long) budget ||
+		    n > (unsigned long long) budget + SLACK :
+		    n > (unsigned long long) budget + SLACK) {
+			printf("copy loop: %lld asked, %llu run\n", budget, n);
+			failed = 1;
+		}
+
+		/* A budget of 1 is too small for any bulk passes */
+		while (instrs(ref) < n && i80run(ref, 1) == I80_BUDGET)
+			;
+		for (i = 0; i < NREGS; i++) {
+			if (i80get(m, regs[i]) != i80get(ref, regs[i]))
+				break;
+		}
+		if (instrs(ref) != n || i < NREGS ||
+		    memcmp(i80ram(m), i80ram(ref), 0x10000) != 0) {
+			printf("copy loop: %lld asked, differs from one pass "
+			    "at a time\n", budget);
+			failed = 1;
+		}
+		i80free(m);
+		i80free(ref);
+	}
+}
+
+/*
+ * Once the machine that has the translator is freed, another can take
+ * it and run a different loop at the same address, which must not find
+ * the blocks translated for the first.
+ */
+static void
+jitclaim(void)
+{
+#ifndef Z80
+	static unsigned char code[] = {
+		0x21, 0x00, 0x10,	/* lxi h,1000h */
+		0x11, 0x00, 0x20,	/* lxi d,2000h */
+		0x01, 0x00, 0x10,	/* lxi b,1000h */
+		0x7e,			/* mov a,m */
+		0x00,			/* nop, then cma */
+		0x12,			/* stax d */
+		0x23,			/* inx h */
+		0x13,			/* inx d */
+		0x0b,			/* dcx b */
+		0x78,			/* mov a,b */
+		0xb1,			/* ora c */
+		0xc2, 0x09, 0x00,	/* jnz 0009h */
+		0x76			/* hlt */
+	};
+	struct i80 *m, *ref;
+	size_t i;
+	int pass;
+
+	for (pass = 0; pass < 2; pass++) {
+		code[10] = pass == 0 ? 0x00 : 0x2f;
+		m = load(code, sizeof(code));
+		ref = load(code, sizeof(code));
+		if (i80jit(m, 1) == -1) {
+			if (pass == 1) {
+				printf("jit: not free after i80free()\n");
+				failed = 1;
+			}
+			i80free(m);
+			i80free(ref);
+			return;
+		}
+		for (i = 0; i < 0x1000; i++)
+			i80ram(m)[0x1000 + i] = i80ram(ref)[0x1000 + i] =
+			    i * (pass + 1);
+		i80touch(m, 0x1000, 0x1000);
+		i80touch(ref, 0x1000, 0x1000);
+
+		i80run(m, 1 << 20);
+		i80run(ref, 1 << 20);
+		if (memcmp(i80ram(m), i80ram(ref), 0x10000) != 0) {
+			printf("jit: pass %d differs from the interpreter\n",
+			    pass);
+			failed = 1;
+		}
+		i80free(m);
+		i80free(ref);
+	}
+#endif
+}
+
+int
+main(void)
+{
+
+	outloop();
+	copyloop();
+	jitclaim();
+
+	return failed;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * The trace written by i80 -T and z80 -T and read by tracedump:
+ *
+ *	magic[4] version[1] nregs[1] regs[nregs][2] pc[2]
+ *	record ...
+ *
+ * The magic is "I80T" or "Z80T".  The header holds the registers, in
+ * the order below, and pc as tracing started.  Each record stands for
+ * an instruction about to run, and carries what the one before it
+ * changed:
+ *
+ *	head	TRACE_CODE and TRACE_END, and a bit per register changed
+ *		from bit 2 up
+ *	pc	the distance from the last pc, as a signed number
+ *	code	the 4 bytes at pc, with TRACE_CODE
+ *	regs	the registers changed, in order: the new value of a and
+ *		f, and the difference from the old one for the pairs,
+ *		as a signed number
+ *
+ * Numbers are varints, groups of 7 bits from the lowest up, with the
+ * top bit set on all but the last, and signed ones are zigzag coded
+ * first: 0, -1, 1, -2... as 0, 1, 2, 3...  Both ends keep an image of
+ * memory as the trace has shown it, zeroed at the start, and code is
+ * only sent when it differs from the image, so a loop sends its code
+ * once.  A record with TRACE_END has no pc or code.  It carries the
+ * changes made by the last instruction and ends the trace.
+ */
+
+#define TRACE_VERSION	1
+
+#define TRACE_CODE	0x1
+#define TRACE_END	0x2
+
+/* The registers, by their bit in a record's head less 2 */
+#define TRACE_A		0
+#define TRACE_F		1
+#define TRACE_BC	2
+#define TRACE_DE	3
+#define TRACE_HL	4
+#define TRACE_SP	5
+#define TRACE_IX	6	/* The Z80 only from here on */
+#define TRACE_IY	7
+#define TRACE_AFP	8
+#define TRACE_BCP	9
+#define TRACE_DEP	10
+#define TRACE_HLP	11
+#define TRACE_NREGS	12
@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2026 Brian Callahan <bcallah@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * tracedump: print a trace from i80 -T or z80 -T as disassembly, one
+ * instruction per line with the registers it changed.
+ */
+
+#include <err.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dis.h"
+#include "trace.h"
+
+static const char *const names[TRACE_NREGS] = {
+	"a", "f", "bc", "de", "hl", "sp", "ix", "iy", "af'", "bc'", "de'",
+	"hl'"
+};
+
+static const char *path;
+static FILE *fp;
+
+static unsigned int
+byte(void)
+{
+	int ch;
+
+	if ((ch = getc(fp)) == EOF) {
+		if (ferror(fp))
+			err(1, "%s", path);
+		errx(1, "%s: truncated", path);
+	}
+
+	return ch;
+}
+
+static unsigned int
+varint(void)
+{
+	unsigned int ch, shift, v = 0;
+
+	for (shift = 0; shift < 32; shift += 7) {
+		ch = byte();
+		v |= (ch & 0x7f) << shift;
+		if ((ch & 0x80) == 0)
+			return v;
+	}
+	errx(1, "%s: bad number", path);
+}
+
+static int
+zigzag(void)
+{
+	unsigned int v = varint();
+
+	return v & 1 ? -(int) (v >> 1) - 1 : (int) (v >> 1);
+}
+
+/*
+ * Put the registers named by mask into s, as they are in regs.
+ */
+static void
+changes(char *s, size_t size, unsigned int mask, const uint16_t *regs)
+{
+	size_t n = 0;
+	int i;
+
+	s[0] = '\0';
+	for (i = 0; mask != 0 && n < size; i++, mask >>= 1) {
+		if ((mask & 1) == 0)
+			continue;
+		n += snprintf(s + n, size - n, "%s%s=%0*x", n > 0 ? " " : "",
+		    names[i], i <= TRACE_F ? 2 : 4, regs[i]);
+	}
+}
+
+static void
+usage(void)
+{
+
+	fprintf(stderr, "usage: tracedump [-n count] [-s skip] trace\n");
+	exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	static unsigned char code[0x10000];
+	int (*dis)(const unsigned char *, unsigned int, char *, size_t);
+	unsigned long long count = 0, skip = 0, insn;
+	unsigned char hdr[6], last[DISMAX];
+	unsigned int head, i, lastpc, mask;
+	uint16_t pc, regs[TRACE_NREGS];
+	char *ep, bytes[3 * DISMAX], regbuf[128], text[32];
+	int ch, len, n, nregs;
+
+	while ((ch = getopt(argc, argv, "n:s:")) != -1) {
+		switch (ch) {
+		case 'n':
+			count = strtoull(optarg, &ep, 10);
+			if (*optarg == '\0' || *ep != '\0' || count == 0)
+				errx(1, "invalid count: %s", optarg);
+			break;
+		case 's':
+			skip = strtoull(optarg, &ep, 10);
+			if (*optarg == '\0' || *ep != '\0')
+				errx(1, "invalid skip: %s", optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 1)
+		usage();
+
+	path = argv[0];
+	if ((fp = fopen(path, "r")) == NULL)
+		err(1, "%s", path);
+	for (i = 0; i < sizeof(hdr); i++)
+		hdr[i] = byte();
+	if (memcmp(hdr, "I80T", 4) == 0)
+		dis = dis8080;
+	else if (memcmp(hdr, "Z80T", 4) == 0)
+		dis = disz80;
+	else
+		errx(1, "%s: not a trace", path);
+	if (hdr[4] != TRACE_VERSION)
+		errx(1, "%s: version %d, not %d", path, hdr[4], TRACE_VERSION);
+	if ((nregs = hdr[5]) > TRACE_NREGS)
+		errx(1, "%s: %d registers", path, nregs);
+	for (i = 0; i < (unsigned int) nregs; i++) {
+		regs[i] = byte();
+		regs[i] |= byte() << 8;
+	}
+	pc = byte();
+	pc |= byte() << 8;
+
+	if (skip == 0) {
+		changes(regbuf, sizeof(regbuf), (1 << nregs) - 1, regs);
+		printf("; %s\n", regbuf);
+	}
+
+	/*
+	 * Each record gives the changes made by the instruction before
+	 * it, so an instruction is printed once the next one is read.
+	 */
+	lastpc = 0;
+	for (insn = 0;; insn++) {
+		head = varint();
+		if ((mask = head >> 2) >= 1U << nregs)
+			errx(1, "%s: bad record", path);
+		if ((head & TRACE_END) == 0) {
+			pc += zigzag();
+			if (head & TRACE_CODE) {
+				for (i = 0; i < DISMAX; i++)
+					code[(uint16_t) (pc + i)] = byte();
+			}
+		}
+		for (i = 0; i < (unsigned int) nregs; i++) {
+			if ((mask & 1 << i) == 0)
+				continue;
+			if (i <= TRACE_F)
+				regs[i] = byte();
+			else
+				regs[i] += zigzag();
+		}
+
+		if (insn > skip) {
+			len = dis(last, lastpc, text, sizeof(text));
+			for (i = 0, n = 0; i < (unsigned int) len; i++)
+				n += snprintf(bytes + n, sizeof(bytes) - n,
+				    "%s%02x", i > 0 ? " " : "", last[i]);
+			changes(regbuf, sizeof(regbuf), mask, regs);
+			printf("%10llu  %04x  %-11s  ", insn - 1, lastpc,
+			    bytes);
+			if (regbuf[0] != '\0')
+				printf("%-20s %s\n", text, regbuf);
+			else
+				printf("%s\n", text);
+			if (count > 0 && insn - skip == count)
+				break;
+		}
+		if (head & TRACE_END)
+			break;
+		lastpc = pc;
+		for (i = 0; i < DISMAX; i++)
+			last[i] = code[(uint16_t) (pc + i)];
+	}
+
+	if (ferror(stdout) || fflush(stdout) == EOF)
+		err(1, "stdout");
+
+	return 0;
+}